@@ -26,6 +26,10 @@ SOURCES += \
         src/movie.cpp \
         src/netcam.cpp \
         src/picture.cpp \
+        src/pic_writer.cpp \
+        src/precap.cpp \
+        src/extpipe.cpp \
+        src/trace.cpp \
         src/rotate.cpp \
         src/sound.cpp \
         src/util.cpp \
@@ -55,6 +59,10 @@ HEADERS += \
     src/movie.hpp \
     src/netcam.hpp \
     src/picture.hpp \
+    src/pic_writer.hpp \
+    src/precap.hpp \
+    src/extpipe.hpp \
+    src/trace.hpp \
     src/rotate.hpp \
     src/sound.hpp \
     src/util.hpp \
@@ -22,6 +22,7 @@
 //#include "alg.hpp"
 //#include "draw.hpp"
 #include "logger.hpp"
+#include "trace.hpp"
 
 #define MAX2(x, y) ((x) > (y) ? (x) : (y))
 #define MAX3(x, y, z) ((x) > (y) ? ((x) > (z) ? (x) : (z)) : ((y) > (z) ? (y) : (z)))
@@ -900,6 +901,7 @@ static void alg_lightswitch(ctx_dev *cam)
             }
             cam->current_image->diffs = 0;
             cam->alg_update_reference_frame(RESET_REF_FRAME);
+            trace_flag(cam, TRACE_FLAG_LIGHTSWITCH);
         }
     }
 }
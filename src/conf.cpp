@@ -19,10 +19,12 @@
 
 #include <dirent.h>
 #include <string>
+#include <unordered_map>
 #include "motionplus.hpp"
 #include "util.hpp"
 #include "logger.hpp"
 #include "conf.hpp"
+#include "trace.hpp"
 
 /*Configuration parameters */
 ctx_parm config_parms[] = {
@@ -95,6 +97,7 @@ ctx_parm config_parms[] = {
     {"static_object_time",        PARM_TYP_INT,    PARM_CAT_07, WEBUI_LEVEL_LIMITED },
     {"event_gap",                 PARM_TYP_INT,    PARM_CAT_07, WEBUI_LEVEL_LIMITED },
     {"pre_capture",               PARM_TYP_INT,    PARM_CAT_07, WEBUI_LEVEL_LIMITED },
+    {"pre_capture_compress",      PARM_TYP_INT,    PARM_CAT_07, WEBUI_LEVEL_ADVANCED },
     {"post_capture",              PARM_TYP_INT,    PARM_CAT_07, WEBUI_LEVEL_LIMITED },
 
     {"on_event_start",            PARM_TYP_STRING, PARM_CAT_08, WEBUI_LEVEL_RESTRICTED },
@@ -116,12 +119,15 @@ ctx_parm config_parms[] = {
     {"picture_quality",           PARM_TYP_INT,    PARM_CAT_09, WEBUI_LEVEL_LIMITED },
     {"picture_exif",              PARM_TYP_STRING, PARM_CAT_09, WEBUI_LEVEL_LIMITED },
     {"picture_filename",          PARM_TYP_STRING, PARM_CAT_09, WEBUI_LEVEL_LIMITED },
+    {"picture_writer_threads",    PARM_TYP_INT,    PARM_CAT_09, WEBUI_LEVEL_ADVANCED },
+    {"picture_writer_queue",      PARM_TYP_INT,    PARM_CAT_09, WEBUI_LEVEL_ADVANCED },
     {"snapshot_interval",         PARM_TYP_INT,    PARM_CAT_09, WEBUI_LEVEL_LIMITED },
     {"snapshot_filename",         PARM_TYP_STRING, PARM_CAT_09, WEBUI_LEVEL_LIMITED },
 
     {"movie_output",              PARM_TYP_BOOL,   PARM_CAT_10, WEBUI_LEVEL_LIMITED },
     {"movie_output_motion",       PARM_TYP_BOOL,   PARM_CAT_10, WEBUI_LEVEL_LIMITED },
     {"movie_max_time",            PARM_TYP_INT,    PARM_CAT_10, WEBUI_LEVEL_LIMITED },
+    {"movie_segment",             PARM_TYP_INT,    PARM_CAT_10, WEBUI_LEVEL_LIMITED },
     {"movie_bps",                 PARM_TYP_INT,    PARM_CAT_10, WEBUI_LEVEL_LIMITED },
     {"movie_quality",             PARM_TYP_INT,    PARM_CAT_10, WEBUI_LEVEL_LIMITED },
     {"movie_container",           PARM_TYP_STRING, PARM_CAT_10, WEBUI_LEVEL_LIMITED },
@@ -130,12 +136,14 @@ ctx_parm config_parms[] = {
     {"movie_retain",              PARM_TYP_LIST,   PARM_CAT_10, WEBUI_LEVEL_LIMITED },
     {"movie_extpipe_use",         PARM_TYP_BOOL,   PARM_CAT_10, WEBUI_LEVEL_RESTRICTED },
     {"movie_extpipe",             PARM_TYP_STRING, PARM_CAT_10, WEBUI_LEVEL_RESTRICTED },
+    {"movie_extpipe_drop",        PARM_TYP_LIST,   PARM_CAT_10, WEBUI_LEVEL_ADVANCED },
 
     {"timelapse_interval",        PARM_TYP_INT,    PARM_CAT_11, WEBUI_LEVEL_LIMITED },
     {"timelapse_mode",            PARM_TYP_LIST,   PARM_CAT_11, WEBUI_LEVEL_LIMITED },
     {"timelapse_fps",             PARM_TYP_INT,    PARM_CAT_11, WEBUI_LEVEL_LIMITED },
     {"timelapse_container",       PARM_TYP_LIST,   PARM_CAT_11, WEBUI_LEVEL_LIMITED },
     {"timelapse_filename",        PARM_TYP_STRING, PARM_CAT_11, WEBUI_LEVEL_LIMITED },
+    {"timelapse_sync_interval",   PARM_TYP_INT,    PARM_CAT_11, WEBUI_LEVEL_ADVANCED },
 
     {"video_pipe",                PARM_TYP_STRING, PARM_CAT_12, WEBUI_LEVEL_LIMITED },
     {"video_pipe_motion",         PARM_TYP_STRING, PARM_CAT_12, WEBUI_LEVEL_LIMITED },
@@ -156,6 +164,7 @@ ctx_parm config_parms[] = {
     {"webcontrol_actions",        PARM_TYP_STRING, PARM_CAT_13, WEBUI_LEVEL_RESTRICTED },
     {"webcontrol_lock_minutes",   PARM_TYP_INT,    PARM_CAT_13, WEBUI_LEVEL_ADVANCED },
     {"webcontrol_lock_attempts",  PARM_TYP_INT,    PARM_CAT_13, WEBUI_LEVEL_ADVANCED },
+    {"webcontrol_threads",        PARM_TYP_INT,    PARM_CAT_13, WEBUI_LEVEL_ADVANCED },
 
     {"stream_preview_scale",      PARM_TYP_INT,    PARM_CAT_14, WEBUI_LEVEL_LIMITED },
     {"stream_preview_newline",    PARM_TYP_BOOL,   PARM_CAT_14, WEBUI_LEVEL_LIMITED },
@@ -167,6 +176,7 @@ ctx_parm config_parms[] = {
     {"stream_maxrate",            PARM_TYP_INT,    PARM_CAT_14, WEBUI_LEVEL_LIMITED },
     {"stream_scan_time",          PARM_TYP_INT,    PARM_CAT_14, WEBUI_LEVEL_LIMITED },
     {"stream_scan_scale",         PARM_TYP_INT,    PARM_CAT_14, WEBUI_LEVEL_LIMITED },
+    {"stream_thumbnail_scale",    PARM_TYP_INT,    PARM_CAT_14, WEBUI_LEVEL_LIMITED },
 
     {"database_type",             PARM_TYP_LIST,   PARM_CAT_15, WEBUI_LEVEL_ADVANCED },
     {"database_dbname",           PARM_TYP_STRING, PARM_CAT_15, WEBUI_LEVEL_ADVANCED },
@@ -175,6 +185,7 @@ ctx_parm config_parms[] = {
     {"database_user",             PARM_TYP_STRING, PARM_CAT_15, WEBUI_LEVEL_RESTRICTED },
     {"database_password",         PARM_TYP_STRING, PARM_CAT_15, WEBUI_LEVEL_RESTRICTED },
     {"database_busy_timeout",     PARM_TYP_INT,    PARM_CAT_15, WEBUI_LEVEL_ADVANCED },
+    {"database_queue",            PARM_TYP_INT,    PARM_CAT_15, WEBUI_LEVEL_ADVANCED },
 
     {"sql_event_start",           PARM_TYP_STRING, PARM_CAT_16, WEBUI_LEVEL_ADVANCED },
     {"sql_event_end",             PARM_TYP_STRING, PARM_CAT_16, WEBUI_LEVEL_ADVANCED },
@@ -470,7 +481,7 @@ static void conf_edit_daemon(ctx_config *conf, std::string &parm, enum PARM_ACT
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","daemon",_("daemon"));
 }
 
-static void conf_edit_setup_mode(ctx_config *conf, std::string &parm, int pact)
+static void conf_edit_setup_mode(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     if (pact == PARM_ACT_DFLT) {
         conf->setup_mode = false;
@@ -496,7 +507,7 @@ static void conf_edit_conf_filename(ctx_config *conf, std::string &parm, enum PA
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","log_file",_("log_file"));
 }
 
-static void conf_edit_pid_file(ctx_config *conf, std::string &parm, int pact)
+static void conf_edit_pid_file(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     if (pact == PARM_ACT_DFLT) {
         conf->pid_file = "";
@@ -658,7 +669,7 @@ static void conf_edit_device_tmo(ctx_config *conf, std::string &parm, enum PARM_
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","device_tmo",_("device_tmo"));
 }
 
-static void conf_edit_pause(ctx_config *conf, std::string &parm, int pact)
+static void conf_edit_pause(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     if (pact == PARM_ACT_DFLT) {
         conf->pause = false;
@@ -1508,6 +1519,25 @@ static void conf_edit_pre_capture(ctx_config *conf, std::string &parm, enum PARM
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","pre_capture",_("pre_capture"));
 }
 
+static void conf_edit_pre_capture_compress(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    int parm_in;
+    if (pact == PARM_ACT_DFLT) {
+        conf->pre_capture_compress = 0;
+    } else if (pact == PARM_ACT_SET) {
+        parm_in = atoi(parm.c_str());
+        if ((parm_in < 0) || (parm_in > 100)) {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid pre_capture_compress %d"),parm_in);
+        } else {
+            conf->pre_capture_compress = parm_in;
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = std::to_string(conf->pre_capture_compress);
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","pre_capture_compress",_("pre_capture_compress"));
+}
+
 static void conf_edit_post_capture(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     int parm_in;
@@ -1798,6 +1828,44 @@ static void conf_edit_picture_filename(ctx_config *conf, std::string &parm, enum
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","picture_filename",_("picture_filename"));
 }
 
+static void conf_edit_picture_writer_threads(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    int parm_in;
+    if (pact == PARM_ACT_DFLT) {
+        conf->picture_writer_threads = 2;
+    } else if (pact == PARM_ACT_SET) {
+        parm_in = atoi(parm.c_str());
+        if ((parm_in < 0) || (parm_in > 32)) {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid picture_writer_threads %d"),parm_in);
+        } else {
+            conf->picture_writer_threads = parm_in;
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = std::to_string(conf->picture_writer_threads);
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","picture_writer_threads",_("picture_writer_threads"));
+}
+
+static void conf_edit_picture_writer_queue(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    int parm_in;
+    if (pact == PARM_ACT_DFLT) {
+        conf->picture_writer_queue = 32;
+    } else if (pact == PARM_ACT_SET) {
+        parm_in = atoi(parm.c_str());
+        if ((parm_in < 1) || (parm_in > 1000)) {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid picture_writer_queue %d"),parm_in);
+        } else {
+            conf->picture_writer_queue = parm_in;
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = std::to_string(conf->picture_writer_queue);
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","picture_writer_queue",_("picture_writer_queue"));
+}
+
 static void conf_edit_snapshot_interval(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     int parm_in;
@@ -1875,6 +1943,25 @@ static void conf_edit_movie_max_time(ctx_config *conf, std::string &parm, enum P
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","movie_max_time",_("movie_max_time"));
 }
 
+static void conf_edit_movie_segment(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    int parm_in;
+    if (pact == PARM_ACT_DFLT) {
+        conf->movie_segment = 0;
+    } else if (pact == PARM_ACT_SET) {
+        parm_in = atoi(parm.c_str());
+        if ((parm_in < 0) || (parm_in > 86400)) {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid movie_segment %d"),parm_in);
+        } else {
+            conf->movie_segment = parm_in;
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = std::to_string(conf->movie_segment);
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","movie_segment",_("movie_segment"));
+}
+
 static void conf_edit_movie_bps(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     int parm_in;
@@ -2001,6 +2088,29 @@ static void conf_edit_movie_extpipe(ctx_config *conf, std::string &parm, enum PA
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","movie_extpipe",_("movie_extpipe"));
 }
 
+static void conf_edit_movie_extpipe_drop(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    if (pact == PARM_ACT_DFLT) {
+        conf->movie_extpipe_drop = "none";
+    } else if (pact == PARM_ACT_SET) {
+        if ((parm == "none") || (parm == "newest") || (parm == "oldest"))  {
+            conf->movie_extpipe_drop = parm;
+        } else if (parm == "") {
+            conf->movie_extpipe_drop = "none";
+        } else {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid movie_extpipe_drop %s"), parm.c_str());
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = conf->movie_extpipe_drop;
+    } else if (pact == PARM_ACT_LIST) {
+        parm = "[";
+        parm = parm +  "\"none\",\"newest\",\"oldest\"";
+        parm = parm + "]";
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","movie_extpipe_drop",_("movie_extpipe_drop"));
+}
+
 static void conf_edit_timelapse_interval(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     int parm_in;
@@ -2101,6 +2211,25 @@ static void conf_edit_timelapse_filename(ctx_config *conf, std::string &parm, en
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","timelapse_filename",_("timelapse_filename"));
 }
 
+static void conf_edit_timelapse_sync_interval(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    int parm_in;
+    if (pact == PARM_ACT_DFLT) {
+        conf->timelapse_sync_interval = 60;
+    } else if (pact == PARM_ACT_SET) {
+        parm_in = atoi(parm.c_str());
+        if ((parm_in < 0) || (parm_in > 3600)) {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid timelapse_sync_interval %d"),parm_in);
+        } else {
+            conf->timelapse_sync_interval = parm_in;
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = std::to_string(conf->timelapse_sync_interval);
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","timelapse_sync_interval",_("timelapse_sync_interval"));
+}
+
 static void conf_edit_video_pipe(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     if (pact == PARM_ACT_DFLT) {
@@ -2397,6 +2526,25 @@ static void conf_edit_webcontrol_lock_attempts(ctx_config *conf, std::string &pa
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","webcontrol_lock_attempts",_("webcontrol_lock_attempts"));
 }
 
+static void conf_edit_webcontrol_threads(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    int parm_in;
+    if (pact == PARM_ACT_DFLT) {
+        conf->webcontrol_threads = 0;
+    } else if (pact == PARM_ACT_SET) {
+        parm_in = atoi(parm.c_str());
+        if ((parm_in < 0) || (parm_in > 256)) {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid webcontrol_threads %d"),parm_in);
+        } else {
+            conf->webcontrol_threads = parm_in;
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = std::to_string(conf->webcontrol_threads);
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","webcontrol_threads",_("webcontrol_threads"));
+}
+
 static void conf_edit_stream_preview_scale(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     int parm_in;
@@ -2567,6 +2715,25 @@ static void conf_edit_stream_scan_scale(ctx_config *conf, std::string &parm, enu
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","stream_scan_scale",_("stream_scan_scale"));
 }
 
+static void conf_edit_stream_thumbnail_scale(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    int parm_in;
+    if (pact == PARM_ACT_DFLT) {
+        conf->stream_thumbnail_scale = 4;
+    } else if (pact == PARM_ACT_SET) {
+        parm_in = atoi(parm.c_str());
+        if ((parm_in != 4) && (parm_in != 8) && (parm_in != 16)) {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid stream_thumbnail_scale %d"),parm_in);
+        } else {
+            conf->stream_thumbnail_scale = parm_in;
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = std::to_string(conf->stream_thumbnail_scale);
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","stream_thumbnail_scale",_("stream_thumbnail_scale"));
+}
+
 static void conf_edit_database_type(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     if (pact == PARM_ACT_DFLT) {
@@ -2679,6 +2846,25 @@ static void conf_edit_database_busy_timeout(ctx_config *conf, std::string &parm,
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","database_busy_timeout",_("database_busy_timeout"));
 }
 
+static void conf_edit_database_queue(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
+{
+    int parm_in;
+    if (pact == PARM_ACT_DFLT) {
+        conf->database_queue = 256;
+    } else if (pact == PARM_ACT_SET) {
+        parm_in = atoi(parm.c_str());
+        if ((parm_in < 0) || (parm_in > 10000)) {
+            MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Invalid database_queue %d"),parm_in);
+        } else {
+            conf->database_queue = parm_in;
+        }
+    } else if (pact == PARM_ACT_GET) {
+        parm = std::to_string(conf->database_queue);
+    }
+    return;
+    MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","database_queue",_("database_queue"));
+}
+
 static void conf_edit_sql_event_start(ctx_config *conf, std::string &parm, enum PARM_ACT pact)
 {
     if (pact == PARM_ACT_DFLT) {
@@ -2972,290 +3158,247 @@ static void conf_edit_snd_show(ctx_config *conf, std::string &parm, enum PARM_AC
     MOTPLS_LOG(DBG, TYPE_ALL, NO_ERRNO,"%s:%s","snd_show",_("snd_show"));
 }
 
-/* Application level parameters */
-static void conf_edit_cat00(ctx_config *conf, std::string cmd
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (cmd == "daemon") {                         conf_edit_daemon(conf, parm_val, pact);
-    } else if (cmd == "conf_filename") {           conf_edit_conf_filename(conf, parm_val, pact);
-    } else if (cmd == "setup_mode") {              conf_edit_setup_mode(conf, parm_val, pact);
-    } else if (cmd == "pid_file") {                conf_edit_pid_file(conf, parm_val, pact);
-    } else if (cmd == "log_file") {                conf_edit_log_file(conf, parm_val, pact);
-    } else if (cmd == "log_level") {               conf_edit_log_level(conf, parm_val, pact);
-    } else if (cmd == "log_type") {                conf_edit_log_type(conf, parm_val, pact);
-    } else if (cmd == "native_language") {         conf_edit_native_language(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat01(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "config_dir") {                   conf_edit_config_dir(conf, parm_val, pact);
-    } else if (parm_nm == "camera") {                conf_edit_camera(conf, parm_val, pact);
-    } else if (parm_nm == "device_name") {           conf_edit_device_name(conf, parm_val, pact);
-    } else if (parm_nm == "device_id") {             conf_edit_device_id(conf, parm_val, pact);
-    } else if (parm_nm == "device_tmo") {            conf_edit_device_tmo(conf, parm_val, pact);
-    } else if (parm_nm == "pause") {                 conf_edit_pause(conf, parm_val, pact);
-    } else if (parm_nm == "target_dir") {            conf_edit_target_dir(conf, parm_val, pact);
-    } else if (parm_nm == "watchdog_tmo") {          conf_edit_watchdog_tmo(conf, parm_val, pact);
-    } else if (parm_nm == "watchdog_kill") {         conf_edit_watchdog_kill(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat02(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-
-    if (parm_nm == "v4l2_device") {                  conf_edit_v4l2_device(conf, parm_val, pact);
-    } else if (parm_nm == "v4l2_params") {           conf_edit_v4l2_params(conf, parm_val, pact);
-    } else if (parm_nm == "netcam_url") {            conf_edit_netcam_url(conf, parm_val, pact);
-    } else if (parm_nm == "netcam_params") {         conf_edit_netcam_params(conf, parm_val, pact);
-    } else if (parm_nm == "netcam_high_url") {       conf_edit_netcam_high_url(conf, parm_val, pact);
-    } else if (parm_nm == "netcam_high_params") {    conf_edit_netcam_high_params(conf, parm_val, pact);
-    } else if (parm_nm == "netcam_userpass") {       conf_edit_netcam_userpass(conf, parm_val, pact);
-    } else if (parm_nm == "libcam_device") {         conf_edit_libcam_device(conf, parm_val, pact);
-    } else if (parm_nm == "libcam_params") {         conf_edit_libcam_params(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat03(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "width") {                          conf_edit_width(conf, parm_val, pact);
-    } else if (parm_nm == "height") {                  conf_edit_height(conf, parm_val, pact);
-    } else if (parm_nm == "framerate") {               conf_edit_framerate(conf, parm_val, pact);
-    } else if (parm_nm == "rotate") {                  conf_edit_rotate(conf, parm_val, pact);
-    } else if (parm_nm == "flip_axis") {               conf_edit_flip_axis(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat04(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "locate_motion_mode") {             conf_edit_locate_motion_mode(conf, parm_val, pact);
-    } else if (parm_nm == "locate_motion_style") {     conf_edit_locate_motion_style(conf, parm_val, pact);
-    } else if (parm_nm == "text_left") {               conf_edit_text_left(conf, parm_val, pact);
-    } else if (parm_nm == "text_right") {              conf_edit_text_right(conf, parm_val, pact);
-    } else if (parm_nm == "text_changes") {            conf_edit_text_changes(conf, parm_val, pact);
-    } else if (parm_nm == "text_scale") {              conf_edit_text_scale(conf, parm_val, pact);
-    } else if (parm_nm == "text_event") {              conf_edit_text_event(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat05(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "emulate_motion") {                 conf_edit_emulate_motion(conf, parm_val, pact);
-    } else if (parm_nm == "threshold") {               conf_edit_threshold(conf, parm_val, pact);
-    } else if (parm_nm == "threshold_maximum") {       conf_edit_threshold_maximum(conf, parm_val, pact);
-    } else if (parm_nm == "threshold_sdevx") {         conf_edit_threshold_sdevx(conf, parm_val, pact);
-    } else if (parm_nm == "threshold_sdevy") {         conf_edit_threshold_sdevy(conf, parm_val, pact);
-    } else if (parm_nm == "threshold_sdevxy") {        conf_edit_threshold_sdevxy(conf, parm_val, pact);
-    } else if (parm_nm == "threshold_ratio") {         conf_edit_threshold_ratio(conf, parm_val, pact);
-    } else if (parm_nm == "threshold_ratio_change") {  conf_edit_threshold_ratio_change(conf, parm_val, pact);
-    } else if (parm_nm == "threshold_tune") {          conf_edit_threshold_tune(conf, parm_val, pact);
-    } else if (parm_nm == "secondary_method") {        conf_edit_secondary_method(conf, parm_val, pact);
-    } else if (parm_nm == "secondary_params") {        conf_edit_secondary_params(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat06(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "noise_level") {                    conf_edit_noise_level(conf, parm_val, pact);
-    } else if (parm_nm == "noise_tune") {              conf_edit_noise_tune(conf, parm_val, pact);
-    } else if (parm_nm == "despeckle_filter") {        conf_edit_despeckle_filter(conf, parm_val, pact);
-    } else if (parm_nm == "area_detect") {             conf_edit_area_detect(conf, parm_val, pact);
-    } else if (parm_nm == "mask_file") {               conf_edit_mask_file(conf, parm_val, pact);
-    } else if (parm_nm == "mask_privacy") {            conf_edit_mask_privacy(conf, parm_val, pact);
-    } else if (parm_nm == "smart_mask_speed") {        conf_edit_smart_mask_speed(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat07(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "lightswitch_percent") {            conf_edit_lightswitch_percent(conf, parm_val, pact);
-    } else if (parm_nm == "lightswitch_frames") {      conf_edit_lightswitch_frames(conf, parm_val, pact);
-    } else if (parm_nm == "minimum_motion_frames") {   conf_edit_minimum_motion_frames(conf, parm_val, pact);
-    } else if (parm_nm == "static_object_time") {      conf_edit_static_object_time(conf, parm_val, pact);
-    } else if (parm_nm == "event_gap") {               conf_edit_event_gap(conf, parm_val, pact);
-    } else if (parm_nm == "pre_capture") {             conf_edit_pre_capture(conf, parm_val, pact);
-    } else if (parm_nm == "post_capture") {            conf_edit_post_capture(conf, parm_val, pact);
-    }
+typedef void (*conf_edit_fn)(ctx_config *conf, std::string &parm, enum PARM_ACT pact);
 
-}
-
-static void conf_edit_cat08(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "on_event_start") {                 conf_edit_on_event_start(conf, parm_val, pact);
-    } else if (parm_nm == "on_event_end") {            conf_edit_on_event_end(conf, parm_val, pact);
-    } else if (parm_nm == "on_picture_save") {         conf_edit_on_picture_save(conf, parm_val, pact);
-    } else if (parm_nm == "on_area_detected") {        conf_edit_on_area_detected(conf, parm_val, pact);
-    } else if (parm_nm == "on_motion_detected") {      conf_edit_on_motion_detected(conf, parm_val, pact);
-    } else if (parm_nm == "on_movie_start") {          conf_edit_on_movie_start(conf, parm_val, pact);
-    } else if (parm_nm == "on_movie_end") {            conf_edit_on_movie_end(conf, parm_val, pact);
-    } else if (parm_nm == "on_camera_lost") {          conf_edit_on_camera_lost(conf, parm_val, pact);
-    } else if (parm_nm == "on_camera_found") {         conf_edit_on_camera_found(conf, parm_val, pact);
-    } else if (parm_nm == "on_secondary_detect") {     conf_edit_on_secondary_detect(conf, parm_val, pact);
-    } else if (parm_nm == "on_action_user") {          conf_edit_on_action_user(conf, parm_val, pact);
-    } else if (parm_nm == "on_sound_alert") {          conf_edit_on_sound_alert(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat09(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "picture_output") {                 conf_edit_picture_output(conf, parm_val, pact);
-    } else if (parm_nm == "picture_output_motion") {   conf_edit_picture_output_motion(conf, parm_val, pact);
-    } else if (parm_nm == "picture_type") {            conf_edit_picture_type(conf, parm_val, pact);
-    } else if (parm_nm == "picture_quality") {         conf_edit_picture_quality(conf, parm_val, pact);
-    } else if (parm_nm == "picture_exif") {            conf_edit_picture_exif(conf, parm_val, pact);
-    } else if (parm_nm == "picture_filename") {        conf_edit_picture_filename(conf, parm_val, pact);
-    } else if (parm_nm == "snapshot_interval") {       conf_edit_snapshot_interval(conf, parm_val, pact);
-    } else if (parm_nm == "snapshot_filename") {       conf_edit_snapshot_filename(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat10(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "movie_output") {                   conf_edit_movie_output(conf, parm_val, pact);
-    } else if (parm_nm == "movie_output_motion") {     conf_edit_movie_output_motion(conf, parm_val, pact);
-    } else if (parm_nm == "movie_max_time") {          conf_edit_movie_max_time(conf, parm_val, pact);
-    } else if (parm_nm == "movie_bps") {               conf_edit_movie_bps(conf, parm_val, pact);
-    } else if (parm_nm == "movie_quality") {           conf_edit_movie_quality(conf, parm_val, pact);
-    } else if (parm_nm == "movie_container") {         conf_edit_movie_container(conf, parm_val, pact);
-    } else if (parm_nm == "movie_passthrough") {       conf_edit_movie_passthrough(conf, parm_val, pact);
-    } else if (parm_nm == "movie_filename") {          conf_edit_movie_filename(conf, parm_val, pact);
-    } else if (parm_nm == "movie_retain") {            conf_edit_movie_retain(conf, parm_val, pact);
-    } else if (parm_nm == "movie_extpipe_use") {       conf_edit_movie_extpipe_use(conf, parm_val, pact);
-    } else if (parm_nm == "movie_extpipe") {           conf_edit_movie_extpipe(conf, parm_val, pact);
-    }
-
-}
-
-static void conf_edit_cat11(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "timelapse_interval") {             conf_edit_timelapse_interval(conf, parm_val, pact);
-    } else if (parm_nm == "timelapse_mode") {          conf_edit_timelapse_mode(conf, parm_val, pact);
-    } else if (parm_nm == "timelapse_fps") {           conf_edit_timelapse_fps(conf, parm_val, pact);
-    } else if (parm_nm == "timelapse_container") {     conf_edit_timelapse_container(conf, parm_val, pact);
-    } else if (parm_nm == "timelapse_filename") {      conf_edit_timelapse_filename(conf, parm_val, pact);
-    }
-
-}
+struct ctx_parm_edit {
+    const char      *parm_name;
+    conf_edit_fn    edit_fn;
+};
 
-static void conf_edit_cat12(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "video_pipe") {                     conf_edit_video_pipe(conf, parm_val, pact);
-    } else if (parm_nm == "video_pipe_motion") {       conf_edit_video_pipe_motion(conf, parm_val, pact);
-    }
+struct ctx_parm_item {
+    int             parm_indx;      /* Index of the parameter in config_parms */
+    conf_edit_fn    edit_fn;
+};
 
-}
+/* Edit function of each parameter */
+static ctx_parm_edit parm_edits[] = {
+    {"daemon",                     conf_edit_daemon},
+    {"setup_mode",                 conf_edit_setup_mode},
+    {"conf_filename",              conf_edit_conf_filename},
+    {"pid_file",                   conf_edit_pid_file},
+    {"log_file",                   conf_edit_log_file},
+    {"log_level",                  conf_edit_log_level},
+    {"log_type",                   conf_edit_log_type},
+    {"native_language",            conf_edit_native_language},
+
+    {"device_name",                conf_edit_device_name},
+    {"device_id",                  conf_edit_device_id},
+    {"device_tmo",                 conf_edit_device_tmo},
+    {"pause",                      conf_edit_pause},
+    {"target_dir",                 conf_edit_target_dir},
+    {"watchdog_tmo",               conf_edit_watchdog_tmo},
+    {"watchdog_kill",              conf_edit_watchdog_kill},
+    {"config_dir",                 conf_edit_config_dir},
+    {"camera",                     conf_edit_camera},
+
+    {"v4l2_device",                conf_edit_v4l2_device},
+    {"v4l2_params",                conf_edit_v4l2_params},
+    {"netcam_url",                 conf_edit_netcam_url},
+    {"netcam_params",              conf_edit_netcam_params},
+    {"netcam_high_url",            conf_edit_netcam_high_url},
+    {"netcam_high_params",         conf_edit_netcam_high_params},
+    {"netcam_userpass",            conf_edit_netcam_userpass},
+    {"libcam_device",              conf_edit_libcam_device},
+    {"libcam_params",              conf_edit_libcam_params},
+
+    {"width",                      conf_edit_width},
+    {"height",                     conf_edit_height},
+    {"framerate",                  conf_edit_framerate},
+    {"rotate",                     conf_edit_rotate},
+    {"flip_axis",                  conf_edit_flip_axis},
+
+    {"locate_motion_mode",         conf_edit_locate_motion_mode},
+    {"locate_motion_style",        conf_edit_locate_motion_style},
+    {"text_left",                  conf_edit_text_left},
+    {"text_right",                 conf_edit_text_right},
+    {"text_changes",               conf_edit_text_changes},
+    {"text_scale",                 conf_edit_text_scale},
+    {"text_event",                 conf_edit_text_event},
+
+    {"emulate_motion",             conf_edit_emulate_motion},
+    {"threshold",                  conf_edit_threshold},
+    {"threshold_maximum",          conf_edit_threshold_maximum},
+    {"threshold_sdevx",            conf_edit_threshold_sdevx},
+    {"threshold_sdevy",            conf_edit_threshold_sdevy},
+    {"threshold_sdevxy",           conf_edit_threshold_sdevxy},
+    {"threshold_ratio",            conf_edit_threshold_ratio},
+    {"threshold_ratio_change",     conf_edit_threshold_ratio_change},
+    {"threshold_tune",             conf_edit_threshold_tune},
+    {"secondary_method",           conf_edit_secondary_method},
+    {"secondary_params",           conf_edit_secondary_params},
+
+    {"noise_level",                conf_edit_noise_level},
+    {"noise_tune",                 conf_edit_noise_tune},
+    {"despeckle_filter",           conf_edit_despeckle_filter},
+    {"area_detect",                conf_edit_area_detect},
+    {"mask_file",                  conf_edit_mask_file},
+    {"mask_privacy",               conf_edit_mask_privacy},
+    {"smart_mask_speed",           conf_edit_smart_mask_speed},
+
+    {"lightswitch_percent",        conf_edit_lightswitch_percent},
+    {"lightswitch_frames",         conf_edit_lightswitch_frames},
+    {"minimum_motion_frames",      conf_edit_minimum_motion_frames},
+    {"static_object_time",         conf_edit_static_object_time},
+    {"event_gap",                  conf_edit_event_gap},
+    {"pre_capture",                conf_edit_pre_capture},
+    {"pre_capture_compress",       conf_edit_pre_capture_compress},
+    {"post_capture",               conf_edit_post_capture},
+
+    {"on_event_start",             conf_edit_on_event_start},
+    {"on_event_end",               conf_edit_on_event_end},
+    {"on_picture_save",            conf_edit_on_picture_save},
+    {"on_area_detected",           conf_edit_on_area_detected},
+    {"on_motion_detected",         conf_edit_on_motion_detected},
+    {"on_movie_start",             conf_edit_on_movie_start},
+    {"on_movie_end",               conf_edit_on_movie_end},
+    {"on_camera_lost",             conf_edit_on_camera_lost},
+    {"on_camera_found",            conf_edit_on_camera_found},
+    {"on_secondary_detect",        conf_edit_on_secondary_detect},
+    {"on_action_user",             conf_edit_on_action_user},
+    {"on_sound_alert",             conf_edit_on_sound_alert},
+
+    {"picture_output",             conf_edit_picture_output},
+    {"picture_output_motion",      conf_edit_picture_output_motion},
+    {"picture_type",               conf_edit_picture_type},
+    {"picture_quality",            conf_edit_picture_quality},
+    {"picture_exif",               conf_edit_picture_exif},
+    {"picture_filename",           conf_edit_picture_filename},
+    {"picture_writer_threads",     conf_edit_picture_writer_threads},
+    {"picture_writer_queue",       conf_edit_picture_writer_queue},
+    {"snapshot_interval",          conf_edit_snapshot_interval},
+    {"snapshot_filename",          conf_edit_snapshot_filename},
+
+    {"movie_output",               conf_edit_movie_output},
+    {"movie_output_motion",        conf_edit_movie_output_motion},
+    {"movie_max_time",             conf_edit_movie_max_time},
+    {"movie_segment",              conf_edit_movie_segment},
+    {"movie_bps",                  conf_edit_movie_bps},
+    {"movie_quality",              conf_edit_movie_quality},
+    {"movie_container",            conf_edit_movie_container},
+    {"movie_passthrough",          conf_edit_movie_passthrough},
+    {"movie_filename",             conf_edit_movie_filename},
+    {"movie_retain",               conf_edit_movie_retain},
+    {"movie_extpipe_use",          conf_edit_movie_extpipe_use},
+    {"movie_extpipe",              conf_edit_movie_extpipe},
+    {"movie_extpipe_drop",         conf_edit_movie_extpipe_drop},
+
+    {"timelapse_interval",         conf_edit_timelapse_interval},
+    {"timelapse_mode",             conf_edit_timelapse_mode},
+    {"timelapse_fps",              conf_edit_timelapse_fps},
+    {"timelapse_container",        conf_edit_timelapse_container},
+    {"timelapse_filename",         conf_edit_timelapse_filename},
+    {"timelapse_sync_interval",    conf_edit_timelapse_sync_interval},
+
+    {"video_pipe",                 conf_edit_video_pipe},
+    {"video_pipe_motion",          conf_edit_video_pipe_motion},
+
+    {"webcontrol_port",            conf_edit_webcontrol_port},
+    {"webcontrol_base_path",       conf_edit_webcontrol_base_path},
+    {"webcontrol_ipv6",            conf_edit_webcontrol_ipv6},
+    {"webcontrol_localhost",       conf_edit_webcontrol_localhost},
+    {"webcontrol_parms",           conf_edit_webcontrol_parms},
+    {"webcontrol_interface",       conf_edit_webcontrol_interface},
+    {"webcontrol_auth_method",     conf_edit_webcontrol_auth_method},
+    {"webcontrol_authentication",  conf_edit_webcontrol_authentication},
+    {"webcontrol_tls",             conf_edit_webcontrol_tls},
+    {"webcontrol_cert",            conf_edit_webcontrol_cert},
+    {"webcontrol_key",             conf_edit_webcontrol_key},
+    {"webcontrol_headers",         conf_edit_webcontrol_headers},
+    {"webcontrol_html",            conf_edit_webcontrol_html},
+    {"webcontrol_actions",         conf_edit_webcontrol_actions},
+    {"webcontrol_lock_minutes",    conf_edit_webcontrol_lock_minutes},
+    {"webcontrol_lock_attempts",   conf_edit_webcontrol_lock_attempts},
+    {"webcontrol_threads",         conf_edit_webcontrol_threads},
+
+    {"stream_preview_scale",       conf_edit_stream_preview_scale},
+    {"stream_preview_newline",     conf_edit_stream_preview_newline},
+    {"stream_preview_method",      conf_edit_stream_preview_method},
+    {"stream_preview_ptz",         conf_edit_stream_preview_ptz},
+    {"stream_quality",             conf_edit_stream_quality},
+    {"stream_grey",                conf_edit_stream_grey},
+    {"stream_motion",              conf_edit_stream_motion},
+    {"stream_maxrate",             conf_edit_stream_maxrate},
+    {"stream_scan_time",           conf_edit_stream_scan_time},
+    {"stream_scan_scale",          conf_edit_stream_scan_scale},
+    {"stream_thumbnail_scale",     conf_edit_stream_thumbnail_scale},
+
+    {"database_type",              conf_edit_database_type},
+    {"database_dbname",            conf_edit_database_dbname},
+    {"database_host",              conf_edit_database_host},
+    {"database_port",              conf_edit_database_port},
+    {"database_user",              conf_edit_database_user},
+    {"database_password",          conf_edit_database_password},
+    {"database_busy_timeout",      conf_edit_database_busy_timeout},
+    {"database_queue",             conf_edit_database_queue},
+
+    {"sql_event_start",            conf_edit_sql_event_start},
+    {"sql_event_end",              conf_edit_sql_event_end},
+    {"sql_movie_start",            conf_edit_sql_movie_start},
+    {"sql_movie_end",              conf_edit_sql_movie_end},
+    {"sql_pic_save",               conf_edit_sql_pic_save},
+
+    {"ptz_auto_track",             conf_edit_ptz_auto_track},
+    {"ptz_wait",                   conf_edit_ptz_wait},
+    {"ptz_move_track",             conf_edit_ptz_move_track},
+    {"ptz_pan_left",               conf_edit_ptz_pan_left},
+    {"ptz_pan_right",              conf_edit_ptz_pan_right},
+    {"ptz_tilt_up",                conf_edit_ptz_tilt_up},
+    {"ptz_tilt_down",              conf_edit_ptz_tilt_down},
+    {"ptz_zoom_in",                conf_edit_ptz_zoom_in},
+    {"ptz_zoom_out",               conf_edit_ptz_zoom_out},
+
+    {"snd_device",                 conf_edit_snd_device},
+    {"snd_params",                 conf_edit_snd_params},
+    {"snd_alerts",                 conf_edit_snd_alerts},
+    {"snd_window",                 conf_edit_snd_window},
+    {"snd_show",                   conf_edit_snd_show},
+
+    { NULL, NULL }
+};
 
-static void conf_edit_cat13(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "webcontrol_port") {                    conf_edit_webcontrol_port(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_base_path") {        conf_edit_webcontrol_base_path(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_ipv6") {             conf_edit_webcontrol_ipv6(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_localhost") {        conf_edit_webcontrol_localhost(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_parms") {            conf_edit_webcontrol_parms(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_interface") {        conf_edit_webcontrol_interface(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_auth_method") {      conf_edit_webcontrol_auth_method(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_authentication") {   conf_edit_webcontrol_authentication(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_tls") {              conf_edit_webcontrol_tls(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_cert") {             conf_edit_webcontrol_cert(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_key") {              conf_edit_webcontrol_key(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_headers") {          conf_edit_webcontrol_headers(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_html") {             conf_edit_webcontrol_html(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_actions") {          conf_edit_webcontrol_actions(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_lock_minutes") {     conf_edit_webcontrol_lock_minutes(conf, parm_val, pact);
-    } else if (parm_nm == "webcontrol_lock_attempts") {    conf_edit_webcontrol_lock_attempts(conf, parm_val, pact);
-    }
+/* Parameters by name.  Built before any thread is started */
+static std::unordered_map<std::string, ctx_parm_item> parm_map;
 
-}
-
-static void conf_edit_cat14(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
+static void conf_edit_map_init(void)
 {
-    if (parm_nm == "stream_preview_scale") {               conf_edit_stream_preview_scale(conf, parm_val, pact);
-    } else if (parm_nm == "stream_preview_newline") {      conf_edit_stream_preview_newline(conf, parm_val, pact);
-    } else if (parm_nm == "stream_preview_method") {       conf_edit_stream_preview_method(conf, parm_val, pact);
-    } else if (parm_nm == "stream_preview_ptz") {          conf_edit_stream_preview_ptz(conf, parm_val, pact);
-    } else if (parm_nm == "stream_quality") {              conf_edit_stream_quality(conf, parm_val, pact);
-    } else if (parm_nm == "stream_grey") {                 conf_edit_stream_grey(conf, parm_val, pact);
-    } else if (parm_nm == "stream_motion") {               conf_edit_stream_motion(conf, parm_val, pact);
-    } else if (parm_nm == "stream_maxrate") {              conf_edit_stream_maxrate(conf, parm_val, pact);
-    } else if (parm_nm == "stream_scan_time") {            conf_edit_stream_scan_time(conf, parm_val, pact);
-    } else if (parm_nm == "stream_scan_scale") {           conf_edit_stream_scan_scale(conf, parm_val, pact);
-    }
-
-}
+    int indx;
+    ctx_parm_item item;
+    std::unordered_map<std::string, ctx_parm_item>::iterator it;
 
-static void conf_edit_cat15(ctx_config *conf, std::string parm_nm, std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "database_type") {                 conf_edit_database_type(conf, parm_val, pact);
-    } else if (parm_nm == "database_dbname") {        conf_edit_database_dbname(conf, parm_val, pact);
-    } else if (parm_nm == "database_host") {          conf_edit_database_host(conf, parm_val, pact);
-    } else if (parm_nm == "database_port") {          conf_edit_database_port(conf, parm_val, pact);
-    } else if (parm_nm == "database_user") {          conf_edit_database_user(conf, parm_val, pact);
-    } else if (parm_nm == "database_password") {      conf_edit_database_password(conf, parm_val, pact);
-    } else if (parm_nm == "database_busy_timeout") {  conf_edit_database_busy_timeout(conf, parm_val, pact);
+    if (parm_map.empty() == false) {
+        return;
     }
 
-}
-
-static void conf_edit_cat16(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "sql_event_start") {         conf_edit_sql_event_start(conf, parm_val, pact);
-    } else if (parm_nm == "sql_event_end") {    conf_edit_sql_event_end(conf, parm_val, pact);
-    } else if (parm_nm == "sql_movie_start") {  conf_edit_sql_movie_start(conf, parm_val, pact);
-    } else if (parm_nm == "sql_movie_end") {    conf_edit_sql_movie_end(conf, parm_val, pact);
-    } else if (parm_nm == "sql_pic_save") {     conf_edit_sql_pic_save(conf, parm_val, pact);
+    item.parm_indx = -1;
+    for (indx = 0; parm_edits[indx].parm_name != NULL; indx++) {
+        item.edit_fn = parm_edits[indx].edit_fn;
+        parm_map[parm_edits[indx].parm_name] = item;
     }
 
-}
-
-static void conf_edit_cat17(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
-{
-    if (parm_nm == "ptz_auto_track") {         conf_edit_ptz_auto_track(conf, parm_val, pact);
-    } else if (parm_nm == "ptz_wait") {        conf_edit_ptz_wait(conf, parm_val, pact);
-    } else if (parm_nm == "ptz_move_track") {  conf_edit_ptz_move_track(conf, parm_val, pact);
-    } else if (parm_nm == "ptz_pan_left") {    conf_edit_ptz_pan_left(conf, parm_val, pact);
-    } else if (parm_nm == "ptz_pan_right") {   conf_edit_ptz_pan_right(conf, parm_val, pact);
-    } else if (parm_nm == "ptz_tilt_up") {     conf_edit_ptz_tilt_up(conf, parm_val, pact);
-    } else if (parm_nm == "ptz_tilt_down") {   conf_edit_ptz_tilt_down(conf, parm_val, pact);
-    } else if (parm_nm == "ptz_zoom_in") {     conf_edit_ptz_zoom_in(conf, parm_val, pact);
-    } else if (parm_nm == "ptz_zoom_out") {    conf_edit_ptz_zoom_out(conf, parm_val, pact);
+    indx = 0;
+    while (config_parms[indx].parm_name != "") {
+        it = parm_map.find(config_parms[indx].parm_name);
+        if (it == parm_map.end()) {
+            MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
+                , _("No edit function for config option \"%s\"")
+                , config_parms[indx].parm_name.c_str());
+        } else {
+            it->second.parm_indx = indx;
+        }
+        indx++;
     }
 }
 
-static void conf_edit_cat18(ctx_config *conf, std::string parm_nm
-        , std::string &parm_val, enum PARM_ACT pact)
+/* Locate the parameter.  NULL when it is not a current parameter */
+static ctx_parm_item *conf_edit_find(std::string &parm_nm)
 {
-    if (parm_nm == "snd_device") {          conf_edit_snd_device(conf, parm_val, pact);
-    } else if (parm_nm == "snd_params") {   conf_edit_snd_params(conf, parm_val, pact);
-    } else if (parm_nm == "snd_window") {   conf_edit_snd_window(conf, parm_val, pact);
-    } else if (parm_nm == "snd_alerts") {   conf_edit_snd_alerts(conf, parm_val, pact);
-    } else if (parm_nm == "snd_show") {     conf_edit_snd_show(conf, parm_val, pact);
+    std::unordered_map<std::string, ctx_parm_item>::iterator it;
 
+    it = parm_map.find(parm_nm);
+    if ((it == parm_map.end()) || (it->second.parm_indx == -1)) {
+        return NULL;
     }
+    return &it->second;
 }
 
 static void conf_edit_cat18(ctx_config *conf, std::string parm_nm
@@ -3276,27 +3419,13 @@ static void conf_edit_cat(ctx_config *conf, std::string parm_nm
 static void conf_edit_cat(ctx_config *conf, std::string parm_nm
         , std::string &parm_val, enum PARM_ACT pact, PARM_CAT pcat)
 {
-    if (pcat == PARM_CAT_00) {          conf_edit_cat00(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_01) {   conf_edit_cat01(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_02) {   conf_edit_cat02(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_03) {   conf_edit_cat03(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_04) {   conf_edit_cat04(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_05) {   conf_edit_cat05(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_06) {   conf_edit_cat06(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_07) {   conf_edit_cat07(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_08) {   conf_edit_cat08(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_09) {   conf_edit_cat09(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_10) {   conf_edit_cat10(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_11) {   conf_edit_cat11(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_12) {   conf_edit_cat12(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_13) {   conf_edit_cat13(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_14) {   conf_edit_cat14(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_15) {   conf_edit_cat15(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_16) {   conf_edit_cat16(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_17) {   conf_edit_cat17(conf, parm_nm, parm_val, pact);
-    } else if (pcat == PARM_CAT_18) {   conf_edit_cat18(conf, parm_nm, parm_val, pact);
-    }
+    ctx_parm_item *item;
 
+    item = conf_edit_find(parm_nm);
+    if ((item != NULL) &&
+        (config_parms[item->parm_indx].parm_cat == pcat)) {
+        item->edit_fn(conf, parm_val, pact);
+    }
 }
 
 static void conf_edit_dflt(ctx_config *conf)
@@ -3316,19 +3445,14 @@ static void conf_edit_dflt(ctx_config *conf)
 int conf_edit_set_active(ctx_config *conf
         , std::string parm_nm, std::string parm_val)
 {
-    int indx;
-    PARM_CAT pcat;
+    ctx_parm_item *item;
 
-    indx = 0;
-    while (config_parms[indx].parm_name != "") {
-        if (parm_nm ==  config_parms[indx].parm_name) {
-            pcat = config_parms[indx].parm_cat;
-            conf_edit_cat(conf, parm_nm, parm_val, PARM_ACT_SET, pcat);
-            return 0;
-        }
-        indx++;
+    item = conf_edit_find(parm_nm);
+    if (item == NULL) {
+        return -1;
     }
-    return -1;
+    item->edit_fn(conf, parm_val, PARM_ACT_SET);
+    return 0;
 
 }
 
@@ -3556,35 +3680,38 @@ static void conf_camera_filenm(ctx_motapp *motapp)
 
 }
 
-void conf_camera_add(ctx_motapp *motapp)
+/* Copy the already parsed application configuration as the base of a
+ * device so only the lines of the device file need to be processed.
+ */
+static ctx_config *conf_base_copy(ctx_motapp *motapp)
 {
-    int indx;
+    ctx_config *conf;
     std::string parm_val;
 
+    conf = new ctx_config(*motapp->conf);
+    conf->from_conf_dir = false;
+
+    /* The device_id is never inherited */
+    parm_val = "";
+    conf_edit_device_id(conf, parm_val, PARM_ACT_DFLT);
+
+    return conf;
+}
+
+void conf_camera_add(ctx_motapp *motapp)
+{
     motapp->cam_cnt++;
     motapp->cam_list = (ctx_dev **)myrealloc(
         motapp->cam_list, sizeof(ctx_dev *) * (motapp->cam_cnt + 1), "config_camera");
 
     motapp->cam_list[motapp->cam_cnt-1] = new ctx_dev;
     memset(motapp->cam_list[motapp->cam_cnt-1],0,sizeof(ctx_dev));
-    motapp->cam_list[motapp->cam_cnt-1]->conf = new ctx_config;
+    motapp->cam_list[motapp->cam_cnt-1]->conf = conf_base_copy(motapp);
+    pthread_mutex_init(&motapp->cam_list[motapp->cam_cnt-1]->parms_lock, NULL);
 
     motapp->cam_list[motapp->cam_cnt] = NULL;
     motapp->cam_list[motapp->cam_cnt-1]->motapp = motapp;
 
-    conf_edit_dflt(motapp->cam_list[motapp->cam_cnt-1]->conf);
-
-    indx = 0;
-    while (config_parms[indx].parm_name != "") {
-        if (mystrne(config_parms[indx].parm_name.c_str(),"device_id")) {
-            conf_edit_get(motapp->conf, config_parms[indx].parm_name
-                , parm_val, config_parms[indx].parm_cat);
-            conf_edit_set(motapp->cam_list[motapp->cam_cnt-1]->conf
-                , config_parms[indx].parm_name, parm_val);
-        }
-        indx++;
-    }
-
     conf_camera_filenm(motapp);
 
 }
@@ -3648,33 +3775,17 @@ static void conf_sound_filenm(ctx_motapp *motapp)
 
 void conf_sound_add(ctx_motapp *motapp)
 {
-    int indx;
-    std::string parm_val;
-
     motapp->snd_cnt++;
     motapp->snd_list = (ctx_dev **)myrealloc(
         motapp->snd_list, sizeof(ctx_dev *) * (motapp->snd_cnt + 1), "config_sound");
 
     motapp->snd_list[motapp->snd_cnt-1] = new ctx_dev;
     memset(motapp->snd_list[motapp->snd_cnt-1],0,sizeof(ctx_dev));
-    motapp->snd_list[motapp->snd_cnt-1]->conf = new ctx_config;
+    motapp->snd_list[motapp->snd_cnt-1]->conf = conf_base_copy(motapp);
 
     motapp->snd_list[motapp->snd_cnt] = NULL;
     motapp->snd_list[motapp->snd_cnt-1]->motapp = motapp;
 
-    conf_edit_dflt(motapp->snd_list[motapp->snd_cnt-1]->conf);
-
-    indx = 0;
-    while (config_parms[indx].parm_name != "") {
-        if (mystrne(config_parms[indx].parm_name.c_str(),"device_id")) {
-            conf_edit_get(motapp->conf, config_parms[indx].parm_name
-                , parm_val, config_parms[indx].parm_cat);
-            conf_edit_set(motapp->snd_list[motapp->snd_cnt-1]->conf
-                , config_parms[indx].parm_name, parm_val);
-        }
-        indx++;
-    }
-
     conf_sound_filenm(motapp);
 
 }
@@ -4021,19 +4132,21 @@ void conf_parms_write_cam(ctx_motapp *motapp)
     enum PARM_TYP parm_typ;
     char timestamp[32];
     FILE *conffile;
+    ctx_config *conf;
 
     time_t now = time(0);
     strftime(timestamp, 32, "%Y-%m-%dT%H:%M:%S", localtime(&now));
 
     for (indx=0; indx<motapp->cam_cnt; indx++) {
-        conffile = myfopen(motapp->cam_list[indx]->conf->conf_filename.c_str(), "we");
+        conf = conf_snapshot_latest(motapp->cam_list[indx]);
+        conffile = myfopen(conf->conf_filename.c_str(), "we");
         if (conffile == NULL) {
             MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO
                 , _("Failed to write configuration to %s")
-                , motapp->cam_list[indx]->conf->conf_filename.c_str());
+                , conf->conf_filename.c_str());
             return;
         }
-        fprintf(conffile, "; %s\n", motapp->cam_list[indx]->conf->conf_filename.c_str());
+        fprintf(conffile, "; %s\n", conf->conf_filename.c_str());
         fprintf(conffile, ";\n; This config file was generated by MotionPlus " VERSION "\n");
         fprintf(conffile, "; at %s\n", timestamp);
         fprintf(conffile, "\n\n");
@@ -4048,7 +4161,7 @@ void conf_parms_write_cam(ctx_motapp *motapp)
                 (parm_nm != "config_dir") && (parm_nm != "conf_filename") &&
                 (parm_typ != PARM_TYP_ARRAY) ) {
                 conf_edit_get(motapp->conf, parm_nm, parm_main, parm_ct);
-                conf_edit_get(motapp->cam_list[indx]->conf, parm_nm, parm_vl, parm_ct);
+                conf_edit_get(conf, parm_nm, parm_vl, parm_ct);
                 if (parm_main != parm_vl) {
                     conf_parms_write_parms(conffile, parm_nm, parm_vl, parm_ct, false);
                 }
@@ -4066,7 +4179,7 @@ void conf_parms_write_cam(ctx_motapp *motapp)
 
         MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO
             , _("Configuration written to %s")
-            , motapp->cam_list[indx]->conf->conf_filename.c_str());
+            , conf->conf_filename.c_str());
     }
 
 }
@@ -4146,6 +4259,8 @@ void conf_init(ctx_motapp *motapp)
     struct stat statbuf;
     int indx;
 
+    conf_edit_map_init();
+
     conf_edit_dflt(motapp->conf);
 
     conf_cmdline(motapp);
@@ -4210,6 +4325,8 @@ void conf_deinit(ctx_motapp *motapp)
     int indx;
 
     for (indx=0; indx<motapp->cam_cnt; indx++) {
+        trace_deinit(motapp->cam_list[indx]);
+        conf_snapshot_deinit(motapp->cam_list[indx]);
         delete motapp->cam_list[indx]->conf;
         delete motapp->cam_list[indx];
     }
@@ -4286,6 +4403,98 @@ std::string conf_cat_desc(PARM_CAT pcat, bool shrt)
     }
 }
 
+/* Configuration of the camera including any changes not yet taken by the loop.
+ * Called by the webcontrol with mutex_post held.
+ */
+ctx_config *conf_snapshot_latest(ctx_dev *cam)
+{
+    ctx_config *conf;
+
+    pthread_mutex_lock(&cam->parms_lock);
+        conf = cam->conf_next;
+        if (conf == NULL) {
+            conf = cam->conf;
+        }
+    pthread_mutex_unlock(&cam->parms_lock);
+
+    return conf;
+}
+
+/* Hand a complete copy of the configuration to the camera loop.
+ * Called by the webcontrol with mutex_post held.  A snapshot that
+ * the loop has not yet taken was never seen by any other thread.
+ */
+void conf_snapshot_publish(ctx_dev *cam, ctx_config *conf)
+{
+    ctx_config *conf_prev;
+
+    pthread_mutex_lock(&cam->parms_lock);
+        conf_prev = cam->conf_next;
+        cam->conf_next = conf;
+    pthread_mutex_unlock(&cam->parms_lock);
+
+    if (conf_prev != NULL) {
+        delete conf_prev;
+    }
+}
+
+/* Called by the camera loop at the start of a frame to take the newest
+ * snapshot.  The lock is only taken when there is one.  The replaced
+ * configuration is kept since other threads may still be reading it.
+ * Those threads read a field through cam->conf on each use and do not
+ * hold the pointer (the netcam handlers copy the values they need when
+ * they start), so only the last CONF_RETIRED_MAX are kept.
+ */
+bool conf_snapshot_load(ctx_dev *cam)
+{
+    ctx_config *conf;
+    int indx;
+
+    if (cam->conf_next == NULL) {
+        return false;
+    }
+
+    pthread_mutex_lock(&cam->parms_lock);
+        conf = cam->conf_next;
+        cam->conf_next = NULL;
+        if (conf != NULL) {
+            if (cam->conf_retired == NULL) {
+                cam->conf_retired = (ctx_config **)mymalloc(
+                    sizeof(ctx_config *) * CONF_RETIRED_MAX);
+                cam->conf_retired_cnt = 0;
+            }
+            if (cam->conf_retired_cnt == CONF_RETIRED_MAX) {
+                delete cam->conf_retired[0];
+                for (indx = 1; indx < CONF_RETIRED_MAX; indx++) {
+                    cam->conf_retired[indx - 1] = cam->conf_retired[indx];
+                }
+                cam->conf_retired_cnt--;
+            }
+            cam->conf_retired[cam->conf_retired_cnt] = cam->conf;
+            cam->conf_retired_cnt++;
+            cam->conf = conf;
+        }
+    pthread_mutex_unlock(&cam->parms_lock);
+
+    return (conf != NULL);
+}
+
+/* Free the snapshots once the camera is being removed */
+void conf_snapshot_deinit(ctx_dev *cam)
+{
+    int indx;
+
+    if (cam->conf_next != NULL) {
+        delete cam->conf_next;
+        cam->conf_next = NULL;
+    }
+    for (indx = 0; indx < cam->conf_retired_cnt; indx++) {
+        delete cam->conf_retired[indx];
+    }
+    myfree(&cam->conf_retired);
+    cam->conf_retired_cnt = 0;
+}
+
 void ctx_motapp::conf_init()
 {
     ::conf_init(this);
@@ -151,6 +151,7 @@ struct ctx_config {
     int             static_object_time;
     int             event_gap;
     int             pre_capture;
+    int             pre_capture_compress;
     int             post_capture;
 
     /* Script execution configuration parameters */
@@ -174,6 +175,8 @@ struct ctx_config {
     int             picture_quality;
     std::string     picture_exif;
     std::string     picture_filename;
+    int             picture_writer_threads;
+    int             picture_writer_queue;
 
     /* Snapshot configuration parameters */
     int             snapshot_interval;
@@ -183,6 +186,7 @@ struct ctx_config {
     bool            movie_output;
     bool            movie_output_motion;
     int             movie_max_time;
+    int             movie_segment;
     int             movie_bps;
     int             movie_quality;
     std::string     movie_container;
@@ -191,6 +195,7 @@ struct ctx_config {
     std::string     movie_retain;
     bool            movie_extpipe_use;
     std::string     movie_extpipe;
+    std::string     movie_extpipe_drop;
 
 
     /* Timelapse movie configuration parameters */
@@ -199,6 +204,7 @@ struct ctx_config {
     int             timelapse_fps;
     std::string     timelapse_container;
     std::string     timelapse_filename;
+    int             timelapse_sync_interval;
 
     /* Loopback device configuration parameters */
     std::string     video_pipe;
@@ -221,6 +227,7 @@ struct ctx_config {
     std::string     webcontrol_actions;
     int             webcontrol_lock_minutes;
     int             webcontrol_lock_attempts;
+    int             webcontrol_threads;
 
     /* Live stream configuration parameters */
     int             stream_preview_scale;
@@ -233,6 +240,7 @@ struct ctx_config {
     int             stream_maxrate;
     int             stream_scan_time;
     int             stream_scan_scale;
+    int             stream_thumbnail_scale;
 
     /* Database and SQL configuration parameters */
     std::string     database_type;
@@ -242,6 +250,7 @@ struct ctx_config {
     std::string     database_user;
     std::string     database_password;
     int             database_busy_timeout;
+    int             database_queue;
 
     std::string     sql_event_start;
     std::string     sql_event_end;
@@ -295,4 +304,11 @@ struct ctx_config {
     extern std::string conf_type_desc(PARM_TYP ptype);
     extern std::string conf_cat_desc(PARM_CAT pcat, bool shrt);
 
+    #define CONF_RETIRED_MAX  8     /* Replaced camera configurations kept for other threads */
+
+    ctx_config *conf_snapshot_latest(ctx_dev *cam);
+    void conf_snapshot_publish(ctx_dev *cam, ctx_config *conf);
+    bool conf_snapshot_load(ctx_dev *cam);
+    void conf_snapshot_deinit(ctx_dev *cam);
+
 #endif /* _INCLUDE_CONF_HPP_ */
@@ -28,6 +28,10 @@ namespace {
 
 /* Forward Declare */
 void dbse_close(ctx_motapp *motapp);
+static void dbse_writer_start(ctx_motapp *motapp);
+static bool dbse_writer_stop(ctx_motapp *motapp);
+static bool dbse_clean_step(ctx_motapp *motapp);
+static void dbse_exec_query(ctx_motapp *motapp, const char *sqlquery);
 
 static void dbse_edits(ctx_motapp *motapp)
 {
@@ -82,24 +86,64 @@ static void dbse_cols_free(ctx_motapp *motapp)
 
 }
 
-/* Free the movies lists*/
-static void dbse_movies_free(ctx_motapp *motapp)
+/* Free a list of movie records */
+static void dbse_recs_free(ctx_dbse_rec **movie_list, int movie_cnt)
 {
     int indx;
 
-    if (motapp->dbse->movie_list != NULL) {
-        for (indx=0; indx<motapp->dbse->movie_cnt; indx++) {
-            myfree(&motapp->dbse->movie_list[indx].movie_nm);
-            myfree(&motapp->dbse->movie_list[indx].movie_dir);
-            myfree(&motapp->dbse->movie_list[indx].full_nm);
-            myfree(&motapp->dbse->movie_list[indx].movie_tmc);
-            myfree(&motapp->dbse->movie_list[indx].movie_tml);
+    if (*movie_list != NULL) {
+        for (indx=0; indx<movie_cnt; indx++) {
+            myfree(&(*movie_list)[indx].movie_nm);
+            myfree(&(*movie_list)[indx].movie_dir);
+            myfree(&(*movie_list)[indx].full_nm);
+            myfree(&(*movie_list)[indx].movie_tmc);
+            myfree(&(*movie_list)[indx].movie_tml);
 
         }
-        myfree(&motapp->dbse->movie_list);
+        myfree(movie_list);
     }
+}
+
+/* Free the movies being read from the database*/
+static void dbse_movies_free(ctx_motapp *motapp)
+{
+    dbse_recs_free(&motapp->dbse->movie_list, motapp->dbse->movie_cnt);
     motapp->dbse->movie_cnt = 0;
+}
+
+/* Free the loaded movie lists of all the devices.  Caller holds the mutex */
+static void dbse_movies_drop(ctx_motapp *motapp)
+{
+    std::map<int, ctx_dbse_movies>::iterator it;
 
+    for (it = motapp->dbse->movies.begin(); it != motapp->dbse->movies.end(); it++) {
+        dbse_recs_free(&it->second.movie_list, it->second.movie_cnt);
+    }
+    motapp->dbse->movies.clear();
+}
+
+/* Keep the movies read from the database as the list of the device
+ * and index it by the movie name for the file requests
+*/
+static void dbse_movies_index(ctx_motapp *motapp, int device_id)
+{
+    ctx_dbse_movies *movies;
+    int indx;
+
+    movies = &motapp->dbse->movies[device_id];
+    dbse_recs_free(&movies->movie_list, movies->movie_cnt);
+    movies->movie_list = motapp->dbse->movie_list;
+    movies->movie_cnt = motapp->dbse->movie_cnt;
+    motapp->dbse->movie_list = NULL;
+    motapp->dbse->movie_cnt = 0;
+    movies->load_tm = time(NULL);
+
+    movies->movie_idx.clear();
+    for (indx=0; indx<movies->movie_cnt; indx++) {
+        if (movies->movie_list[indx].movie_nm != NULL) {
+            movies->movie_idx[movies->movie_list[indx].movie_nm] = indx;
+        }
+    }
 }
 
 #ifdef HAVE_DBSE
@@ -272,10 +316,103 @@ static void dbse_rec_assign(ctx_dbse_rec *rec, char *col_nm, char *col_val)
 
 }
 
+/* Assign a value returned by the cleanup queries */
+static void dbse_clean_assign(ctx_dbse *dbse, const char *col_nm, const char *col_val)
+{
+    if (col_val == NULL) {
+        return;
+    }
+    if (mystrceq(col_nm,"clean_cursor")) {
+        dbse->clean_cursor = atoll(col_val);
+    } else if (mystrceq(col_nm,"page_count")) {
+        dbse->page_cnt = atoll(col_val);
+    } else if (mystrceq(col_nm,"freelist_count")) {
+        dbse->free_cnt = atoll(col_val);
+    }
+}
+
+/* Add a new movie to the list at its place in the date and time order.
+ * The movie normally is the newest so it goes at the end.
+*/
+static void dbse_movies_append(ctx_motapp *motapp, ctx_dbse_mov &mov)
+{
+    std::map<int, ctx_dbse_movies>::iterator it;
+    ctx_dbse_movies *lst;
+    ctx_dbse_rec *rec;
+    int indx, pos;
+
+    it = motapp->dbse->movies.find(mov.device_id);
+    if (it == motapp->dbse->movies.end()) {
+        return;
+    }
+    lst = &it->second;
+
+    pos = lst->movie_cnt;
+    while (pos > 0) {
+        rec = &lst->movie_list[pos - 1];
+        if ((rec->movie_dtl < mov.movie_dtl) ||
+            ((rec->movie_dtl == mov.movie_dtl) &&
+             (strcmp(rec->movie_tml, mov.movie_tml.c_str()) <= 0))) {
+            break;
+        }
+        pos--;
+    }
+
+    lst->movie_list = (ctx_dbse_rec *)myrealloc(lst->movie_list
+        , sizeof(ctx_dbse_rec) * (lst->movie_cnt + 1), "dbse_movies_append");
+    if (pos < lst->movie_cnt) {
+        memmove(&lst->movie_list[pos + 1], &lst->movie_list[pos]
+            , sizeof(ctx_dbse_rec) * (lst->movie_cnt - pos));
+    }
+    lst->movie_cnt++;
+
+    rec = &lst->movie_list[pos];
+    dbse_rec_default(rec);
+    rec->device_id = mov.device_id;
+    dbse_rec_assign(rec, (char*)"movie_nm", (char*)mov.movie_nm.c_str());
+    dbse_rec_assign(rec, (char*)"movie_dir", (char*)mov.movie_dir.c_str());
+    dbse_rec_assign(rec, (char*)"full_nm", (char*)mov.full_nm.c_str());
+    dbse_rec_assign(rec, (char*)"movie_tmc", (char*)mov.movie_tmc.c_str());
+    dbse_rec_assign(rec, (char*)"movie_tml", (char*)mov.movie_tml.c_str());
+    rec->movie_sz = mov.movie_sz;
+    rec->movie_dtl = mov.movie_dtl;
+    rec->diff_avg = (int)mov.diff_avg;
+    rec->sdev_min = (int)mov.sdev_min;
+    rec->sdev_max = (int)mov.sdev_max;
+    rec->sdev_avg = (int)mov.sdev_avg;
+
+    if (pos == (lst->movie_cnt - 1)) {
+        lst->movie_idx[rec->movie_nm] = pos;
+    } else {
+        for (indx = pos; indx < lst->movie_cnt; indx++) {
+            lst->movie_idx[lst->movie_list[indx].movie_nm] = indx;
+        }
+    }
+}
+
+/* Check whether the file of a record still exists */
+static void dbse_clean_rec(ctx_dbse *dbse, const char *record_id, const char *full_nm)
+{
+    struct stat statbuf;
+    int64_t id;
+
+    if (record_id == NULL) {
+        return;
+    }
+    id = atoll(record_id);
+    dbse->clean_rows++;
+    if (id > dbse->clean_last) {
+        dbse->clean_last = id;
+    }
+    if ((full_nm == NULL) || (stat(full_nm, &statbuf) != 0)) {
+        dbse->clean_ids.push_back(id);
+    }
+}
+
 static void dbse_sql_motpls(ctx_dbse *dbse, std::string &sql)
 {
     std::string delimit;
-    int indx;
+    std::list<int64_t>::iterator it;
 
     sql = "";
 
@@ -309,26 +446,32 @@ static void dbse_sql_motpls(ctx_dbse *dbse, std::string &sql)
     } else if (dbse->dbse_action == DBSE_COLS_LIST) {
         sql = " select * from motionplus;";
 
-    } else if (dbse->dbse_action == DBSE_MOV_CLEAN) {
+    } else if (dbse->dbse_action == DBSE_CLN_CURSOR) {
+        sql = " select record_id as clean_cursor from motionplus_clean;";
+
+    } else if (dbse->dbse_action == DBSE_CLN_SELECT) {
+        sql  = " select record_id, full_nm ";
+        sql += " from motionplus ";
+        sql += " where ";
+        sql += "   record_id > " + std::to_string(dbse->clean_cursor);
+        sql += " order by ";
+        sql += "   record_id ";
+        sql += " limit " + std::to_string(DBSE_CLEAN_ROWS) + ";";
+
+    } else if (dbse->dbse_action == DBSE_CLN_DELETE) {
         sql = " delete from motionplus "
             " where record_id in (";
         delimit = " ";
-        for (indx=0; indx<dbse->movie_cnt; indx++) {
-            if (dbse->movie_list[indx].found == false) {
-                sql += delimit + std::to_string(
-                    dbse->movie_list[indx].record_id);
-                delimit = ",";
-            }
-            /* 5000 is arbitrary */
-            if (sql.length() > 5000) {
-                indx = dbse->movie_cnt;
-            }
+        for (it = dbse->clean_ids.begin(); it != dbse->clean_ids.end(); it++) {
+            sql += delimit + std::to_string(*it);
+            delimit = ",";
         }
         if (delimit == ",") {
             sql += ");";
         } else {
             sql = "";
         }
+
     }
 
 }
@@ -357,6 +500,28 @@ static void dbse_sql_motpls(ctx_dbse *dbse, std::string &sql, int device_id)
 
 }
 
+/* Insert of a new movie with the parameter markers of the database */
+static void dbse_sql_addrec(ctx_dbse *dbse, std::string &sql)
+{
+    int indx;
+
+    sql  = "insert into motionplus ";
+    sql += " (device_id, movie_nm, movie_dir, full_nm, movie_sz, movie_dtl";
+    sql += " , movie_tmc, movie_tml, diff_avg, sdev_min, sdev_max, sdev_avg)";
+    sql += " values (";
+    for (indx = 1; indx <= 12; indx++) {
+        if (indx > 1) {
+            sql += ",";
+        }
+        if (dbse->database_type == "postgresql") {
+            sql += "$" + std::to_string(indx);
+        } else {
+            sql += "?";
+        }
+    }
+    sql += ")";
+}
+
 static void dbse_sql_motpls(ctx_dbse *dbse, std::string &sql, char *col_nm, char *col_typ)
 {
     sql = "";
@@ -392,10 +557,61 @@ static void dbse_sqlite3_exec(ctx_motapp *motapp, const char *sqlquery)
         MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
             , _("SQLite error was %s"), errmsg);
         sqlite3_free(errmsg);
+        motapp->dbse->batch_err = true;
     }
     MOTPLS_LOG(DBG, TYPE_DB, NO_ERRNO, "Finished query");
 }
 
+/* Insert a movie record with the cached prepared statement */
+static void dbse_sqlite3_addrec(ctx_motapp *motapp, ctx_dbse_mov &mov)
+{
+    int retcd;
+    sqlite3_stmt *stmt;
+    std::string sql;
+
+    if (motapp->dbse->database_sqlite3 == NULL) {
+        return;
+    }
+
+    if (motapp->dbse->stmt_sqlite3_addrec == NULL) {
+        dbse_sql_addrec(motapp->dbse, sql);
+        retcd = sqlite3_prepare_v2(motapp->dbse->database_sqlite3
+            , sql.c_str(), -1, &motapp->dbse->stmt_sqlite3_addrec, NULL);
+        if (retcd != SQLITE_OK) {
+            MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+                , _("SQLite prepare error was %s")
+                , sqlite3_errmsg(motapp->dbse->database_sqlite3));
+            motapp->dbse->stmt_sqlite3_addrec = NULL;
+            motapp->dbse->batch_err = true;
+            return;
+        }
+    }
+    stmt = motapp->dbse->stmt_sqlite3_addrec;
+
+    sqlite3_bind_int(stmt, 1, mov.device_id);
+    sqlite3_bind_text(stmt, 2, mov.movie_nm.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, mov.movie_dir.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, mov.full_nm.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 5, mov.movie_sz);
+    sqlite3_bind_int(stmt, 6, mov.movie_dtl);
+    sqlite3_bind_text(stmt, 7, mov.movie_tmc.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 8, mov.movie_tml.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 9, mov.diff_avg);
+    sqlite3_bind_int64(stmt, 10, mov.sdev_min);
+    sqlite3_bind_int64(stmt, 11, mov.sdev_max);
+    sqlite3_bind_int64(stmt, 12, mov.sdev_avg);
+
+    retcd = sqlite3_step(stmt);
+    if (retcd != SQLITE_DONE) {
+        MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+            , _("SQLite error was %s")
+            , sqlite3_errmsg(motapp->dbse->database_sqlite3));
+        motapp->dbse->batch_err = true;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
 static int dbse_sqlite3_cb (
     void *ptr, int arg_nb, char **arg_val, char **col_nm)
 {
@@ -436,6 +652,15 @@ static int dbse_sqlite3_cb (
             }
         }
         motapp->dbse->rec_indx++;
+    } else if (motapp->dbse->dbse_action == DBSE_CLN_SELECT) {
+        if (arg_nb >= 2) {
+            dbse_clean_rec(motapp->dbse, arg_val[0], arg_val[1]);
+        }
+    } else if ((motapp->dbse->dbse_action == DBSE_CLN_CURSOR) ||
+               (motapp->dbse->dbse_action == DBSE_CLN_PAGES)) {
+        for (indx=0; indx < arg_nb; indx++) {
+            dbse_clean_assign(motapp->dbse, col_nm[indx], arg_val[indx]);
+        }
     }
 
     return 0;
@@ -482,6 +707,7 @@ static void dbse_sqlite3_init(ctx_motapp *motapp)
     std::string sql;
 
     motapp->dbse->database_sqlite3 = NULL;
+    motapp->dbse->stmt_sqlite3_addrec = NULL;
 
     if (motapp->dbse->database_type != "sqlite3") {
         return;
@@ -522,6 +748,24 @@ static void dbse_sqlite3_init(ctx_motapp *motapp)
             , _("database_busy_timeout failed %s"), err_open);
     }
 
+    /* Readers do not block the writer and commits do not wait on fsync of the db */
+    retcd = sqlite3_exec(motapp->dbse->database_sqlite3
+        , "PRAGMA journal_mode=WAL;", NULL, 0, &err_qry);
+    if (retcd != SQLITE_OK) {
+        MOTPLS_LOG(WRN, TYPE_DB, NO_ERRNO
+            , _("Unable to set WAL journal mode: %s"), err_qry);
+        sqlite3_free(err_qry);
+        err_qry = NULL;
+    }
+    retcd = sqlite3_exec(motapp->dbse->database_sqlite3
+        , "PRAGMA synchronous=NORMAL;", NULL, 0, &err_qry);
+    if (retcd != SQLITE_OK) {
+        MOTPLS_LOG(WRN, TYPE_DB, NO_ERRNO
+            , _("Unable to set synchronous mode: %s"), err_qry);
+        sqlite3_free(err_qry);
+        err_qry = NULL;
+    }
+
     motapp->dbse->table_ok = false;
     motapp->dbse->dbse_action = DBSE_TBL_CHECK;
     dbse_sql_motpls(motapp->dbse, sql);
@@ -587,13 +831,6 @@ static void dbse_sqlite3_movlst(ctx_motapp *motapp, int device_id)
             return;
         }
 
-        motapp->dbse->dbse_action = DBSE_MOV_CLEAN;
-        dbse_sql_motpls(motapp->dbse, sql, device_id);
-        dbse_sqlite3_exec(motapp, sql.c_str());
-
-        sql = " vacuum;";
-        dbse_sqlite3_exec(motapp, sql.c_str());
-
     }
     return;
 }
@@ -601,6 +838,10 @@ static void dbse_sqlite3_movlst(ctx_motapp *motapp, int device_id)
 static void dbse_sqlite3_close(ctx_motapp *motapp)
 {
     if (motapp->dbse->database_type == "sqlite3") {
+        if (motapp->dbse->stmt_sqlite3_addrec != NULL) {
+            sqlite3_finalize(motapp->dbse->stmt_sqlite3_addrec);
+            motapp->dbse->stmt_sqlite3_addrec = NULL;
+        }
         if (motapp->dbse->database_sqlite3 != NULL) {
             sqlite3_close(motapp->dbse->database_sqlite3);
             motapp->dbse->database_sqlite3 = NULL;
@@ -630,11 +871,16 @@ static void dbse_mariadb_exec (ctx_motapp *motapp, const char *sqlquery)
             , _("MariaDB query '%s' failed. %s error code %d")
             , sqlquery, mysql_error(motapp->dbse->database_mariadb)
             , retcd);
+        motapp->dbse->batch_err = true;
         if (retcd >= 2000) {
             dbse_close(motapp);
             return;
         }
     }
+    /* The transaction of a batch is committed once all the queries are done */
+    if (motapp->dbse->in_batch) {
+        return;
+    }
     retcd = mysql_query(motapp->dbse->database_mariadb, "commit;");
     if (retcd != 0) {
         retcd = mysql_errno(motapp->dbse->database_mariadb);
@@ -649,6 +895,98 @@ static void dbse_mariadb_exec (ctx_motapp *motapp, const char *sqlquery)
 
 }
 
+/* Insert a movie record with the cached prepared statement */
+static void dbse_mariadb_addrec(ctx_motapp *motapp, ctx_dbse_mov &mov)
+{
+    int retcd;
+    MYSQL_BIND bind[12];
+    std::string sql;
+    long long movie_sz, diff_avg, sdev_min, sdev_max, sdev_avg;
+
+    if (motapp->dbse->database_mariadb == NULL) {
+        return;
+    }
+
+    if (motapp->dbse->stmt_mariadb_addrec == NULL) {
+        motapp->dbse->stmt_mariadb_addrec = mysql_stmt_init(motapp->dbse->database_mariadb);
+        if (motapp->dbse->stmt_mariadb_addrec == NULL) {
+            MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+                , _("MariaDB statement init failed. %s")
+                , mysql_error(motapp->dbse->database_mariadb));
+            motapp->dbse->batch_err = true;
+            return;
+        }
+        dbse_sql_addrec(motapp->dbse, sql);
+        if (mysql_stmt_prepare(motapp->dbse->stmt_mariadb_addrec
+                , sql.c_str(), sql.length()) != 0) {
+            MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+                , _("MariaDB prepare failed. %s")
+                , mysql_stmt_error(motapp->dbse->stmt_mariadb_addrec));
+            mysql_stmt_close(motapp->dbse->stmt_mariadb_addrec);
+            motapp->dbse->stmt_mariadb_addrec = NULL;
+            motapp->dbse->batch_err = true;
+            return;
+        }
+    }
+
+    movie_sz = mov.movie_sz;
+    diff_avg = mov.diff_avg;
+    sdev_min = mov.sdev_min;
+    sdev_max = mov.sdev_max;
+    sdev_avg = mov.sdev_avg;
+
+    memset(bind, 0, sizeof(bind));
+    bind[0].buffer_type = MYSQL_TYPE_LONG;
+    bind[0].buffer = &mov.device_id;
+    bind[1].buffer_type = MYSQL_TYPE_STRING;
+    bind[1].buffer = (void *)mov.movie_nm.c_str();
+    bind[1].buffer_length = mov.movie_nm.length();
+    bind[2].buffer_type = MYSQL_TYPE_STRING;
+    bind[2].buffer = (void *)mov.movie_dir.c_str();
+    bind[2].buffer_length = mov.movie_dir.length();
+    bind[3].buffer_type = MYSQL_TYPE_STRING;
+    bind[3].buffer = (void *)mov.full_nm.c_str();
+    bind[3].buffer_length = mov.full_nm.length();
+    bind[4].buffer_type = MYSQL_TYPE_LONGLONG;
+    bind[4].buffer = &movie_sz;
+    bind[5].buffer_type = MYSQL_TYPE_LONG;
+    bind[5].buffer = &mov.movie_dtl;
+    bind[6].buffer_type = MYSQL_TYPE_STRING;
+    bind[6].buffer = (void *)mov.movie_tmc.c_str();
+    bind[6].buffer_length = mov.movie_tmc.length();
+    bind[7].buffer_type = MYSQL_TYPE_STRING;
+    bind[7].buffer = (void *)mov.movie_tml.c_str();
+    bind[7].buffer_length = mov.movie_tml.length();
+    bind[8].buffer_type = MYSQL_TYPE_LONGLONG;
+    bind[8].buffer = &diff_avg;
+    bind[9].buffer_type = MYSQL_TYPE_LONGLONG;
+    bind[9].buffer = &sdev_min;
+    bind[10].buffer_type = MYSQL_TYPE_LONGLONG;
+    bind[10].buffer = &sdev_max;
+    bind[11].buffer_type = MYSQL_TYPE_LONGLONG;
+    bind[11].buffer = &sdev_avg;
+
+    if ((mysql_stmt_bind_param(motapp->dbse->stmt_mariadb_addrec, bind) != 0) ||
+        (mysql_stmt_execute(motapp->dbse->stmt_mariadb_addrec) != 0)) {
+        retcd = mysql_stmt_errno(motapp->dbse->stmt_mariadb_addrec);
+        MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+            , _("MariaDB insert failed. %s error code %d")
+            , mysql_stmt_error(motapp->dbse->stmt_mariadb_addrec), retcd);
+        motapp->dbse->batch_err = true;
+        /* A reconnect discards the statement so prepare it again next time */
+        mysql_stmt_close(motapp->dbse->stmt_mariadb_addrec);
+        motapp->dbse->stmt_mariadb_addrec = NULL;
+        if (retcd >= 2000) {
+            dbse_close(motapp);
+        }
+        return;
+    }
+
+    if (motapp->dbse->in_batch == false) {
+        mysql_commit(motapp->dbse->database_mariadb);
+    }
+}
+
 static void dbse_mariadb_recs (ctx_motapp *motapp, const char *sqlquery)
 {
     int retcd, indx, indx2;
@@ -735,6 +1073,22 @@ static void dbse_mariadb_recs (ctx_motapp *motapp, const char *sqlquery)
             motapp->dbse->rec_indx++;
             qry_row = mysql_fetch_row(qry_result);
         }
+
+    } else if (motapp->dbse->dbse_action == DBSE_CLN_SELECT) {
+        while (qry_row != NULL) {
+            if (qry_fields >= 2) {
+                dbse_clean_rec(motapp->dbse, qry_row[0], qry_row[1]);
+            }
+            qry_row = mysql_fetch_row(qry_result);
+        }
+
+    } else if (motapp->dbse->dbse_action == DBSE_CLN_CURSOR) {
+        while (qry_row != NULL) {
+            for(indx = 0; indx < qry_fields; indx++) {
+                dbse_clean_assign(motapp->dbse, cols[indx].col_nm, qry_row[indx]);
+            }
+            qry_row = mysql_fetch_row(qry_result);
+        }
     }
     mysql_free_result(qry_result);
 
@@ -796,6 +1150,7 @@ static void dbse_mariadb_init(ctx_motapp *motapp)
     bool my_true = true;
 
     motapp->dbse->database_mariadb = NULL;
+    motapp->dbse->stmt_mariadb_addrec = NULL;
 
     if (motapp->dbse->database_type != "mariadb") {
         return;
@@ -845,6 +1200,10 @@ static void dbse_mariadb_init(ctx_motapp *motapp)
 static void dbse_mariadb_close(ctx_motapp *motapp)
 {
     if (motapp->dbse->database_type == "mariadb") {
+        if (motapp->dbse->stmt_mariadb_addrec != NULL) {
+            mysql_stmt_close(motapp->dbse->stmt_mariadb_addrec);
+            motapp->dbse->stmt_mariadb_addrec = NULL;
+        }
         mysql_library_end();
         if (motapp->dbse->database_mariadb != NULL) {
             mysql_close(motapp->dbse->database_mariadb);
@@ -870,10 +1229,6 @@ static void dbse_mariadb_movlst(ctx_motapp *motapp, int device_id )
         motapp->dbse->dbse_action = DBSE_MOV_SELECT;
         dbse_sql_motpls(motapp->dbse, sql, device_id);
         dbse_mariadb_recs(motapp, sql.c_str());
-
-        motapp->dbse->dbse_action = DBSE_MOV_CLEAN;
-        dbse_sql_motpls(motapp->dbse, sql);
-        dbse_mariadb_exec(motapp, sql.c_str());
     }
 }
 
@@ -881,6 +1236,29 @@ static void dbse_mariadb_movlst(ctx_motapp *motapp, int device_id )
 
 #ifdef HAVE_PGSQL
 
+/* Reconnect after the connection was lost.  The prepared statements are lost with it */
+static void dbse_pgsql_reset(ctx_motapp *motapp)
+{
+    MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+        , _("Connection to PostgreSQL database '%s' failed: %s")
+        , motapp->dbse->database_dbname.c_str()
+        , PQerrorMessage(motapp->dbse->database_pgsql));
+    motapp->dbse->batch_err = true;
+    motapp->dbse->pgsql_addrec_ok = false;
+    PQreset(motapp->dbse->database_pgsql);
+    if (PQstatus(motapp->dbse->database_pgsql) == CONNECTION_BAD) {
+        MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+            , _("Re-Connection to PostgreSQL database '%s' failed: %s")
+            , motapp->dbse->database_dbname.c_str()
+            , PQerrorMessage(motapp->dbse->database_pgsql));
+        dbse_close(motapp);
+    } else {
+        MOTPLS_LOG(INF, TYPE_DB, NO_ERRNO
+            , _("Re-Connection to PostgreSQL database '%s' Succeed")
+            , motapp->dbse->database_dbname.c_str());
+    }
+}
+
 static void dbse_pgsql_exec(ctx_motapp *motapp, const char *sqlquery)
 {
     PGresult    *res;
@@ -893,30 +1271,80 @@ static void dbse_pgsql_exec(ctx_motapp *motapp, const char *sqlquery)
     MOTPLS_LOG(DBG, TYPE_DB, NO_ERRNO, "Executing postgresql query");
     res = PQexec(motapp->dbse->database_pgsql, sqlquery);
     if (PQstatus(motapp->dbse->database_pgsql) == CONNECTION_BAD) {
-        MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
-            , _("Connection to PostgreSQL database '%s' failed: %s")
-            , motapp->dbse->database_dbname.c_str()
-            , PQerrorMessage(motapp->dbse->database_pgsql));
-        PQreset(motapp->dbse->database_pgsql);
-        if (PQstatus(motapp->dbse->database_pgsql) == CONNECTION_BAD) {
-            MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
-                , _("Re-Connection to PostgreSQL database '%s' failed: %s")
-                , motapp->dbse->database_dbname.c_str()
-                , PQerrorMessage(motapp->dbse->database_pgsql));
-            PQclear(res);
-            dbse_close(motapp);
-            return;
-        } else {
-            MOTPLS_LOG(INF, TYPE_DB, NO_ERRNO
-                , _("Re-Connection to PostgreSQL database '%s' Succeed")
-                , motapp->dbse->database_dbname.c_str());
-        }
+        PQclear(res);
+        dbse_pgsql_reset(motapp);
+        return;
     } else if (!(PQresultStatus(res) == PGRES_COMMAND_OK || PQresultStatus(res) == PGRES_TUPLES_OK)) {
         MOTPLS_LOG(ERR, TYPE_DB, SHOW_ERRNO
             , "PGSQL query failed: [%s]  %s %s"
             , sqlquery
             , PQresStatus(PQresultStatus(res))
             , PQresultErrorMessage(res));
+        motapp->dbse->batch_err = true;
+    }
+    PQclear(res);
+}
+
+/* Insert a movie record with the statement prepared on the connection */
+static void dbse_pgsql_addrec(ctx_motapp *motapp, ctx_dbse_mov &mov)
+{
+    PGresult    *res;
+    std::string sql, parms[12];
+    const char *vals[12];
+    int indx;
+
+    if (motapp->dbse->database_pgsql == NULL) {
+        return;
+    }
+
+    if (motapp->dbse->pgsql_addrec_ok == false) {
+        dbse_sql_addrec(motapp->dbse, sql);
+        res = PQprepare(motapp->dbse->database_pgsql
+            , "motpls_addrec", sql.c_str(), 12, NULL);
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+                , "PGSQL prepare failed: %s %s"
+                , PQresStatus(PQresultStatus(res))
+                , PQresultErrorMessage(res));
+            PQclear(res);
+            if (PQstatus(motapp->dbse->database_pgsql) == CONNECTION_BAD) {
+                dbse_pgsql_reset(motapp);
+            }
+            motapp->dbse->batch_err = true;
+            return;
+        }
+        PQclear(res);
+        motapp->dbse->pgsql_addrec_ok = true;
+    }
+
+    parms[0] = std::to_string(mov.device_id);
+    parms[1] = mov.movie_nm;
+    parms[2] = mov.movie_dir;
+    parms[3] = mov.full_nm;
+    parms[4] = std::to_string(mov.movie_sz);
+    parms[5] = std::to_string(mov.movie_dtl);
+    parms[6] = mov.movie_tmc;
+    parms[7] = mov.movie_tml;
+    parms[8] = std::to_string(mov.diff_avg);
+    parms[9] = std::to_string(mov.sdev_min);
+    parms[10] = std::to_string(mov.sdev_max);
+    parms[11] = std::to_string(mov.sdev_avg);
+    for (indx = 0; indx < 12; indx++) {
+        vals[indx] = parms[indx].c_str();
+    }
+
+    res = PQexecPrepared(motapp->dbse->database_pgsql
+        , "motpls_addrec", 12, vals, NULL, NULL, 0);
+    if (PQstatus(motapp->dbse->database_pgsql) == CONNECTION_BAD) {
+        PQclear(res);
+        dbse_pgsql_reset(motapp);
+        return;
+    } else if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+            , "PGSQL insert failed: %s %s"
+            , PQresStatus(PQresultStatus(res))
+            , PQresultErrorMessage(res));
+        motapp->dbse->batch_err = true;
     }
     PQclear(res);
 }
@@ -928,6 +1356,7 @@ static void dbse_pgsql_close(ctx_motapp *motapp)
             PQfinish(motapp->dbse->database_pgsql);
             motapp->dbse->database_pgsql = NULL;
         }
+        motapp->dbse->pgsql_addrec_ok = false;
         motapp->dbse->is_open = false;
     }
 }
@@ -1014,6 +1443,32 @@ static void dbse_pgsql_recs (ctx_motapp *motapp, const char *sqlquery)
             motapp->dbse->rec_indx++;
         }
         PQclear(res);
+
+    } else if (motapp->dbse->dbse_action == DBSE_CLN_SELECT) {
+        if ((PQresultStatus(res) == PGRES_TUPLES_OK) && (PQnfields(res) >= 2)) {
+            rows = PQntuples(res);
+            for(indx = 0; indx < rows; indx++) {
+                dbse_clean_rec(motapp->dbse
+                    , PQgetvalue(res, indx, 0), PQgetvalue(res, indx, 1));
+            }
+        }
+        PQclear(res);
+
+    } else if (motapp->dbse->dbse_action == DBSE_CLN_CURSOR) {
+        if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+            cols = PQnfields(res);
+            rows = PQntuples(res);
+            for(indx = 0; indx < rows; indx++) {
+                for (indx2 = 0; indx2 < cols; indx2++) {
+                    dbse_clean_assign(motapp->dbse
+                        , PQfname(res, indx2), PQgetvalue(res, indx, indx2));
+                }
+            }
+        }
+        PQclear(res);
+
+    } else {
+        PQclear(res);
     }
 
     return;
@@ -1069,6 +1524,7 @@ static void dbse_pgsql_init(ctx_motapp *motapp)
     std::string constr;
 
     motapp->dbse->database_pgsql = NULL;
+    motapp->dbse->pgsql_addrec_ok = false;
 
     if (motapp->dbse->database_type != "postgresql") {
         return;
@@ -1112,10 +1568,6 @@ static void dbse_pgsql_movlst(ctx_motapp *motapp, int device_id)
         motapp->dbse->dbse_action = DBSE_MOV_SELECT;
         dbse_sql_motpls(motapp->dbse, sql, device_id);
         dbse_pgsql_recs(motapp, sql.c_str());
-
-        motapp->dbse->dbse_action = DBSE_MOV_CLEAN;
-        dbse_sql_motpls(motapp->dbse, sql);
-        dbse_pgsql_exec(motapp, sql.c_str());
     }
     return;
 }
@@ -1153,6 +1605,13 @@ static bool dbse_open(ctx_motapp *motapp)
                 dbse_sqlite3_init(motapp);
             }
         #endif
+
+        /* Index for the movie lists of a device by date and time */
+        if (motapp->dbse->is_open) {
+            dbse_exec_query(motapp
+                , "create index if not exists motionplus_dev_dtl "
+                  " on motionplus (device_id, movie_dtl, movie_tml);");
+        }
     pthread_mutex_unlock(&motapp->dbse->mutex_dbse);
 
     return motapp->dbse->is_open;
@@ -1173,12 +1632,31 @@ void dbse_init(ctx_motapp *motapp)
     motapp->dbse->cols_cnt = 0;
     motapp->dbse->cols_list = NULL;
     motapp->dbse->is_open = false;
+    motapp->dbse->in_batch = false;
+    motapp->dbse->batch_err = false;
+    motapp->dbse->queue_max = motapp->conf->database_queue;
+    motapp->dbse->queue_peak = 0;
+    motapp->dbse->thread_running = false;
+    motapp->dbse->closing = false;
+    motapp->dbse->write_cnt = 0;
+    motapp->dbse->batch_cnt = 0;
+    motapp->dbse->drop_cnt = 0;
+    motapp->dbse->clean_cursor = -1;
+    motapp->dbse->clean_last = 0;
+    motapp->dbse->clean_rows = 0;
+    motapp->dbse->page_cnt = 0;
+    motapp->dbse->free_cnt = 0;
+    motapp->dbse->clean_cnt = 0;
 
     pthread_mutex_init(&motapp->dbse->mutex_dbse, NULL);
+    pthread_mutex_init(&motapp->dbse->mutex_queue, NULL);
+    pthread_cond_init(&motapp->dbse->cond_queue, NULL);
 
     dbse_edits(motapp);
 
     dbse_open(motapp);
+
+    dbse_writer_start(motapp);
 }
 
 /* Populate the list of the movies from the database*/
@@ -1189,9 +1667,8 @@ void dbse_movies_getlist(ctx_motapp *motapp, int device_id)
         return;
     }
 
-    dbse_movies_free(motapp);
-
     pthread_mutex_lock(&motapp->dbse->mutex_dbse);
+        dbse_movies_free(motapp);
         #ifdef HAVE_MARIADB
             if (motapp->dbse->database_type == "mariadb") {
                 dbse_mariadb_movlst(motapp, device_id);
@@ -1210,8 +1687,68 @@ void dbse_movies_getlist(ctx_motapp *motapp, int device_id)
         #ifndef HAVE_DBSE
             (void)device_id;
         #endif
+        dbse_movies_index(motapp, device_id);
     pthread_mutex_unlock(&motapp->dbse->mutex_dbse);
 
+    /* Without the database thread one step of the cleanup runs per list */
+    if (motapp->dbse->thread_running == false) {
+        dbse_clean_step(motapp);
+    }
+
+}
+
+/* Load the movie list of the device unless it is already loaded.
+ * New movies are added to the loaded list as their records are written.
+*/
+void dbse_movies_load(ctx_motapp *motapp, int device_id)
+{
+    bool loaded;
+
+    pthread_mutex_lock(&motapp->dbse->mutex_dbse);
+        loaded = (motapp->dbse->movies.count(device_id) > 0);
+    pthread_mutex_unlock(&motapp->dbse->mutex_dbse);
+
+    if (loaded == false) {
+        dbse_movies_getlist(motapp, device_id);
+    }
+}
+
+/* Full name of a movie of the device or an empty string when not in the database.
+ * The loaded list already has the movies written by this process so a name
+ * that is not in it only causes a reload once DBSE_RELOAD_WAIT has passed.
+*/
+std::string dbse_movies_fullnm(ctx_motapp *motapp, int device_id, std::string movie_nm)
+{
+    std::map<int, ctx_dbse_movies>::iterator it_dev;
+    std::unordered_map<std::string, int>::iterator it;
+    std::string full_nm;
+    bool reload;
+    int retry;
+
+    full_nm = "";
+    for (retry = 0; retry < 2; retry++) {
+        reload = false;
+        pthread_mutex_lock(&motapp->dbse->mutex_dbse);
+            it_dev = motapp->dbse->movies.find(device_id);
+            if (it_dev == motapp->dbse->movies.end()) {
+                reload = true;
+            } else {
+                it = it_dev->second.movie_idx.find(movie_nm);
+                if ((it != it_dev->second.movie_idx.end()) &&
+                    (it_dev->second.movie_list[it->second].full_nm != NULL)) {
+                    full_nm = it_dev->second.movie_list[it->second].full_nm;
+                } else if ((time(NULL) - it_dev->second.load_tm) >= DBSE_RELOAD_WAIT) {
+                    reload = true;
+                }
+            }
+        pthread_mutex_unlock(&motapp->dbse->mutex_dbse);
+        if ((reload == false) || (retry == 1)) {
+            break;
+        }
+        dbse_movies_getlist(motapp, device_id);
+    }
+
+    return full_nm;
 }
 
 void dbse_close(ctx_motapp *motapp)
@@ -1232,12 +1769,20 @@ void dbse_close(ctx_motapp *motapp)
 
 void dbse_deinit(ctx_motapp *motapp)
 {
+    if (dbse_writer_stop(motapp) == false) {
+        /* The thread still references the context so it can not be freed */
+        return;
+    }
+
     dbse_movies_free(motapp);
+    dbse_movies_drop(motapp);
 
     dbse_cols_free(motapp);
 
     dbse_close(motapp);
 
+    pthread_cond_destroy(&motapp->dbse->cond_queue);
+    pthread_mutex_destroy(&motapp->dbse->mutex_queue);
     pthread_mutex_destroy(&motapp->dbse->mutex_dbse);
 
     if (motapp->dbse != NULL) {
@@ -1246,6 +1791,212 @@ void dbse_deinit(ctx_motapp *motapp)
 
 }
 
+/* Execute sql against the database.  Caller holds the mutex */
+static void dbse_exec_query(ctx_motapp *motapp, const char *sqlquery)
+{
+    #ifdef HAVE_MARIADB
+        if (motapp->dbse->database_type == "mariadb") {
+            dbse_mariadb_exec(motapp, sqlquery);
+        }
+    #endif
+    #ifdef HAVE_PGSQL
+        if (motapp->dbse->database_type == "postgresql") {
+            dbse_pgsql_exec(motapp, sqlquery);
+        }
+    #endif
+    #ifdef HAVE_SQLITE3
+        if (motapp->dbse->database_type == "sqlite3") {
+            dbse_sqlite3_exec(motapp, sqlquery);
+        }
+    #endif
+    #ifndef HAVE_DBSE
+        (void)motapp;
+        (void)sqlquery;
+    #endif
+}
+
+/* Execute sql that returns records for the dbse_action.  Caller holds the mutex */
+static void dbse_exec_recs(ctx_motapp *motapp, const char *sqlquery)
+{
+    #ifdef HAVE_SQLITE3
+        int retcd;
+        char *errmsg  = NULL;
+    #endif
+
+    if (strlen(sqlquery) == 0) {
+        return;
+    }
+
+    #ifdef HAVE_MARIADB
+        if ((motapp->dbse->database_type == "mariadb") &&
+            (motapp->dbse->database_mariadb != NULL)) {
+            dbse_mariadb_recs(motapp, sqlquery);
+        }
+    #endif
+    #ifdef HAVE_PGSQL
+        if (motapp->dbse->database_type == "postgresql") {
+            dbse_pgsql_recs(motapp, sqlquery);
+        }
+    #endif
+    #ifdef HAVE_SQLITE3
+        if ((motapp->dbse->database_type == "sqlite3") &&
+            (motapp->dbse->database_sqlite3 != NULL)) {
+            retcd = sqlite3_exec(motapp->dbse->database_sqlite3
+                , sqlquery, dbse_sqlite3_cb, motapp, &errmsg);
+            if (retcd != SQLITE_OK ) {
+                MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+                    , _("SQLite error was %s"), errmsg);
+                sqlite3_free(errmsg);
+            }
+        }
+    #endif
+    #ifndef HAVE_DBSE
+        (void)motapp;
+    #endif
+}
+
+/* Vacuum the sqlite3 database once enough of its pages are free.
+ * The other databases reclaim the space on their own.
+*/
+static void dbse_clean_vacuum(ctx_motapp *motapp)
+{
+    ctx_dbse *dbse = motapp->dbse;
+
+    if (dbse->database_type != "sqlite3") {
+        return;
+    }
+
+    dbse->page_cnt = 0;
+    dbse->free_cnt = 0;
+    dbse->dbse_action = DBSE_CLN_PAGES;
+    dbse_exec_recs(motapp, "PRAGMA page_count;");
+    dbse_exec_recs(motapp, "PRAGMA freelist_count;");
+
+    if ((dbse->free_cnt < DBSE_VACUUM_MIN) ||
+        ((dbse->free_cnt * 100) < (dbse->page_cnt * DBSE_VACUUM_PCT))) {
+        return;
+    }
+
+    MOTPLS_LOG(INF, TYPE_DB, NO_ERRNO
+        , _("Vacuum of database with %lld of %lld pages free")
+        , (long long)dbse->free_cnt, (long long)dbse->page_cnt);
+    dbse_exec_query(motapp, "vacuum;");
+}
+
+/* Delete the records of one batch of missing movie files.
+ * The position is kept in the motionplus_clean table so a restart
+ * continues the pass.  Returns false once the pass is complete.
+*/
+static bool dbse_clean_step(ctx_motapp *motapp)
+{
+    ctx_dbse *dbse = motapp->dbse;
+    std::string sql;
+    bool more;
+
+    if (dbse->is_open == false) {
+        return false;
+    }
+
+    pthread_mutex_lock(&dbse->mutex_dbse);
+        if (dbse->clean_cursor == -1) {
+            dbse_exec_query(motapp
+                , "create table if not exists motionplus_clean (record_id bigint);");
+            dbse->dbse_action = DBSE_CLN_CURSOR;
+            dbse_sql_motpls(dbse, sql);
+            dbse_exec_recs(motapp, sql.c_str());
+            if (dbse->clean_cursor == -1) {
+                dbse_exec_query(motapp
+                    , "insert into motionplus_clean (record_id) values (0);");
+                dbse->clean_cursor = 0;
+            }
+        }
+
+        dbse->clean_ids.clear();
+        dbse->clean_rows = 0;
+        dbse->clean_last = dbse->clean_cursor;
+        dbse->dbse_action = DBSE_CLN_SELECT;
+        dbse_sql_motpls(dbse, sql);
+        dbse_exec_recs(motapp, sql.c_str());
+
+        if (dbse->clean_ids.empty() == false) {
+            MOTPLS_LOG(DBG, TYPE_DB, NO_ERRNO
+                , _("Removing %d records of missing movies")
+                , (int)dbse->clean_ids.size());
+            dbse->clean_cnt += dbse->clean_ids.size();
+            dbse->dbse_action = DBSE_CLN_DELETE;
+            dbse_sql_motpls(dbse, sql);
+            dbse_exec_query(motapp, sql.c_str());
+            dbse->clean_ids.clear();
+            /* The lists are read again when next requested */
+            dbse_movies_drop(motapp);
+        }
+
+        more = (dbse->clean_rows >= DBSE_CLEAN_ROWS);
+        if (more) {
+            dbse->clean_cursor = dbse->clean_last;
+        } else {
+            dbse->clean_cursor = 0;
+        }
+        sql = " update motionplus_clean set record_id = " +
+            std::to_string(dbse->clean_cursor) + ";";
+        dbse_exec_query(motapp, sql.c_str());
+
+        if (more == false) {
+            dbse_clean_vacuum(motapp);
+        }
+    pthread_mutex_unlock(&dbse->mutex_dbse);
+
+    return more;
+}
+
+/* Execute a queued item.  Caller holds the mutex.
+ * Returns false when the query failed.
+*/
+static bool dbse_exec_item(ctx_motapp *motapp, ctx_dbse_sql &item)
+{
+    bool prev_err, retcd;
+
+    prev_err = motapp->dbse->batch_err;
+    motapp->dbse->batch_err = false;
+
+    if (item.addrec == false) {
+        dbse_exec_query(motapp, item.sql.c_str());
+    }
+    #ifdef HAVE_MARIADB
+        if ((item.addrec) && (motapp->dbse->database_type == "mariadb")) {
+            dbse_mariadb_addrec(motapp, item.mov);
+        }
+    #endif
+    #ifdef HAVE_PGSQL
+        if ((item.addrec) && (motapp->dbse->database_type == "postgresql")) {
+            dbse_pgsql_addrec(motapp, item.mov);
+        }
+    #endif
+    #ifdef HAVE_SQLITE3
+        if ((item.addrec) && (motapp->dbse->database_type == "sqlite3")) {
+            dbse_sqlite3_addrec(motapp, item.mov);
+        }
+    #endif
+
+    retcd = (motapp->dbse->batch_err == false);
+    motapp->dbse->batch_err = (prev_err || motapp->dbse->batch_err);
+
+    return retcd;
+}
+
+/* Keep the loaded movie list current with the records that were written */
+static void dbse_exec_added(ctx_motapp *motapp, ctx_dbse_sql &item)
+{
+    #ifdef HAVE_DBSE
+        if (item.addrec) {
+            dbse_movies_append(motapp, item.mov);
+        }
+    #else
+        (void)motapp;
+        (void)item;
+    #endif
+}
+
 /* Execute sql against database with mutex lock */
 void dbse_exec_sql(ctx_motapp *motapp, const char *sqlquery)
 {
@@ -1255,26 +2006,226 @@ void dbse_exec_sql(ctx_motapp *motapp, const char *sqlquery)
     }
 
     pthread_mutex_lock(&motapp->dbse->mutex_dbse);
-        #ifdef HAVE_MARIADB
+        dbse_exec_query(motapp, sqlquery);
+    pthread_mutex_unlock(&motapp->dbse->mutex_dbse);
+
+}
+
+/* Execute a batch of queries from the queue in one transaction.
+ * When any query fails the transaction is rolled back and the
+ * queries are executed one at a time so only the bad one is lost.
+*/
+static void dbse_exec_batch(ctx_motapp *motapp, std::list<ctx_dbse_sql> &batch)
+{
+    std::list<ctx_dbse_sql>::iterator it;
+    bool open;
+
+    open = false;
+    for (it = batch.begin(); it != batch.end(); it++) {
+        if (it->open) {
+            open = true;
+        }
+    }
+    if (open) {
+        dbse_open(motapp);
+    }
+    if (motapp->dbse->is_open == false) {
+        return;
+    }
+
+    pthread_mutex_lock(&motapp->dbse->mutex_dbse);
+        if (batch.size() > 1) {
+            motapp->dbse->in_batch = true;
+            motapp->dbse->batch_err = false;
             if (motapp->dbse->database_type == "mariadb") {
-                dbse_mariadb_exec(motapp, sqlquery);
+                dbse_exec_query(motapp, "START TRANSACTION;");
+            } else {
+                dbse_exec_query(motapp, "BEGIN;");
             }
-        #endif
-        #ifdef HAVE_PGSQL
-            if (motapp->dbse->database_type == "postgresql") {
-                dbse_pgsql_exec(motapp, sqlquery);
+            for (it = batch.begin(); it != batch.end(); it++) {
+                dbse_exec_item(motapp, *it);
             }
-        #endif
-        #ifdef HAVE_SQLITE3
-            if (motapp->dbse->database_type == "sqlite3") {
-                dbse_sqlite3_exec(motapp, sqlquery);
+            if (motapp->dbse->batch_err) {
+                MOTPLS_LOG(WRN, TYPE_DB, NO_ERRNO
+                    , _("Batch of %d queries failed.  Retrying individually")
+                    , (int)batch.size());
+                dbse_exec_query(motapp, "ROLLBACK;");
+            } else {
+                dbse_exec_query(motapp, "COMMIT;");
             }
-        #endif
-        #ifndef HAVE_DBSE
-            (void)sqlquery;
-        #endif
+            motapp->dbse->in_batch = false;
+            if (motapp->dbse->batch_err == false) {
+                for (it = batch.begin(); it != batch.end(); it++) {
+                    dbse_exec_added(motapp, *it);
+                }
+                pthread_mutex_unlock(&motapp->dbse->mutex_dbse);
+                return;
+            }
+        }
+        for (it = batch.begin(); it != batch.end(); it++) {
+            if (dbse_exec_item(motapp, *it)) {
+                dbse_exec_added(motapp, *it);
+            }
+        }
     pthread_mutex_unlock(&motapp->dbse->mutex_dbse);
+}
+
+/* Thread that writes the queued queries to the database */
+static void *dbse_handler(void *arg)
+{
+    ctx_motapp *motapp = (ctx_motapp *)arg;
+    ctx_dbse *dbse = motapp->dbse;
+    std::list<ctx_dbse_sql> batch;
+    struct timespec ts;
+    time_t clean_next;
+    int cnt;
+
+    mythreadname_set("db", 0, NULL);
+
+    clean_next = time(NULL) + DBSE_CLEAN_WAIT;
+
+    pthread_mutex_lock(&dbse->mutex_queue);
+    while (true) {
+        /* The cleanup of missing movies runs only while no queries are waiting */
+        while ((dbse->queue.empty()) && (dbse->closing == false)) {
+            if (time(NULL) >= clean_next) {
+                pthread_mutex_unlock(&dbse->mutex_queue);
+                if (dbse_clean_step(motapp)) {
+                    clean_next = time(NULL) + DBSE_CLEAN_WAIT;
+                } else {
+                    clean_next = time(NULL) + DBSE_CLEAN_PASS;
+                }
+                pthread_mutex_lock(&dbse->mutex_queue);
+                continue;
+            }
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += (clean_next - time(NULL));
+            pthread_cond_timedwait(&dbse->cond_queue, &dbse->mutex_queue, &ts);
+        }
+        /* Write any remaining queries before exiting */
+        if (dbse->queue.empty()) {
+            break;
+        }
+        cnt = 0;
+        while ((dbse->queue.empty() == false) && (cnt < DBSE_BATCH_MAX)) {
+            batch.splice(batch.end(), dbse->queue, dbse->queue.begin());
+            cnt++;
+        }
+        pthread_mutex_unlock(&dbse->mutex_queue);
+
+        dbse_exec_batch(motapp, batch);
+        batch.clear();
+
+        pthread_mutex_lock(&dbse->mutex_queue);
+        dbse->write_cnt += (uint64_t)cnt;
+        dbse->batch_cnt++;
+    }
+    pthread_mutex_unlock(&dbse->mutex_queue);
 
+    dbse->thread_running = false;
+
+    pthread_exit(NULL);
+}
+
+/* Start the thread that writes the queries */
+static void dbse_writer_start(ctx_motapp *motapp)
+{
+    pthread_attr_t thread_attr;
+    int retcd;
+
+    if ((motapp->dbse->database_type == "") ||
+        (motapp->dbse->queue_max == 0)) {
+        return;
+    }
+
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+
+    motapp->dbse->thread_running = true;
+    retcd = pthread_create(&motapp->dbse->thread_id
+        , &thread_attr, &dbse_handler, motapp);
+    if (retcd != 0) {
+        MOTPLS_LOG(ERR, TYPE_DB, SHOW_ERRNO
+            ,_("Unable to start database thread.  Queries will be written directly"));
+        motapp->dbse->thread_running = false;
+    }
+
+    pthread_attr_destroy(&thread_attr);
+}
+
+/* Stop the thread once the queued queries are written */
+static bool dbse_writer_stop(ctx_motapp *motapp)
+{
+    int waitcnt;
+
+    if (motapp->dbse->thread_running == false) {
+        return true;
+    }
+
+    pthread_mutex_lock(&motapp->dbse->mutex_queue);
+        motapp->dbse->closing = true;
+        pthread_cond_signal(&motapp->dbse->cond_queue);
+    pthread_mutex_unlock(&motapp->dbse->mutex_queue);
+
+    waitcnt = 0;
+    while ((motapp->dbse->thread_running) && (waitcnt < 10000)) {
+        SLEEP(0,1000000)
+        waitcnt++;
+    }
+    if (waitcnt == 10000) {
+        MOTPLS_LOG(ERR, TYPE_DB, NO_ERRNO
+            ,_("Graceful shutdown of database thread failed"));
+        return false;
+    }
+
+    MOTPLS_LOG(INF, TYPE_DB, NO_ERRNO
+        ,_("Database: %llu queries in %llu batches, peak queue %d, dropped %llu"
+            ", missing movies removed %llu")
+        , (unsigned long long)motapp->dbse->write_cnt
+        , (unsigned long long)motapp->dbse->batch_cnt
+        , motapp->dbse->queue_peak
+        , (unsigned long long)motapp->dbse->drop_cnt
+        , (unsigned long long)motapp->dbse->clean_cnt);
+
+    return true;
+}
+
+/* Hand a query to the database thread or execute it when there is no thread */
+static void dbse_put(ctx_motapp *motapp, ctx_dbse_sql &item)
+{
+    ctx_dbse *dbse = motapp->dbse;
+
+    if (dbse->thread_running == false) {
+        if (item.open) {
+            if (dbse_open(motapp) == false) {
+                return;
+            }
+        } else if (dbse->is_open == false) {
+            return;
+        }
+        pthread_mutex_lock(&dbse->mutex_dbse);
+            if (dbse_exec_item(motapp, item)) {
+                dbse_exec_added(motapp, item);
+            }
+        pthread_mutex_unlock(&dbse->mutex_dbse);
+        return;
+    }
+
+    pthread_mutex_lock(&dbse->mutex_queue);
+        if ((int)dbse->queue.size() >= dbse->queue_max) {
+            if ((dbse->drop_cnt % 100) == 0) {
+                MOTPLS_LOG(WRN, TYPE_DB, NO_ERRNO
+                    ,_("Database queue is full.  Query discarded"));
+            }
+            dbse->drop_cnt++;
+        } else {
+            dbse->queue.push_back(item);
+            if ((int)dbse->queue.size() > dbse->queue_peak) {
+                dbse->queue_peak = (int)dbse->queue.size();
+            }
+            pthread_cond_signal(&dbse->cond_queue);
+        }
+    pthread_mutex_unlock(&dbse->mutex_queue);
 }
 
 /* Create and execute user provided sql with mutex lock*/
@@ -1282,18 +2233,14 @@ void dbse_exec(ctx_dev *cam, char *filename
     , int sqltype, struct timespec *ts1, const char *cmd)
 {
     char sqlquery[PATH_MAX];
+    ctx_dbse_sql item;
 
-    /* This is to prevent flooding log with open/fail messages*/
-    if (mystrceq(cmd,"event_start")) {
-        if (dbse_open(cam->motapp) == false) {
-            return;
-        }
-    } else {
-        if (cam->motapp->dbse->is_open == false) {
-            return;
-        }
+    if (cam->motapp->dbse->database_type == "") {
+        return;
     }
 
+    sqlquery[0] = '\0';
+
     if (mystrceq(cmd,"pic_save")) {
         mystrftime(cam, sqlquery, sizeof(sqlquery)
             , cam->conf->sql_pic_save.c_str()
@@ -1321,32 +2268,33 @@ void dbse_exec(ctx_dev *cam, char *filename
     }
     MOTPLS_LOG(DBG, TYPE_DB, NO_ERRNO, "%s query: %s", cmd, sqlquery);
 
-    dbse_exec_sql(cam->motapp, sqlquery);
+    /* This is to prevent flooding log with open/fail messages*/
+    item.sql = sqlquery;
+    item.open = mystrceq(cmd,"event_start");
+    item.addrec = false;
+    dbse_put(cam->motapp, item);
 
 }
 
 /* Add a record to motionplus table for new movies */
 void dbse_movies_addrec(ctx_dev *cam, ctx_movie *movie, timespec *ts1)
 {
-    std::string sqlquery;
+    ctx_dbse_sql item;
     struct stat statbuf;
-    int64_t bsz;
     char dtl[12];
     char tmc[12];
     char tml[12];
-
-    uint64_t diff_avg, sdev_avg;
     struct tm timestamp_tm;
 
-    if (dbse_open(cam->motapp) == false) {
+    if (cam->motapp->dbse->database_type == "") {
         return;
     }
 
     /* Movie file times */
     if (stat(movie->full_nm, &statbuf) == 0) {
-        bsz = statbuf.st_size;
+        item.mov.movie_sz = statbuf.st_size;
     } else {
-        bsz = 0;
+        item.mov.movie_sz = 0;
     }
     localtime_r(&ts1->tv_sec, &timestamp_tm);
     strftime(dtl, 11, "%G%m%d"   , &timestamp_tm);
@@ -1354,34 +2302,26 @@ void dbse_movies_addrec(ctx_dev *cam, ctx_movie *movie, timespec *ts1)
     strftime(tml, 11, "%H:%M:%S" , &timestamp_tm);
 
     if (cam->info_diff_cnt != 0) {
-        diff_avg = (cam->info_diff_tot / cam->info_diff_cnt);
-    } else {
-        diff_avg =0;
-    }
-    if (cam->info_diff_cnt != 0) {
-        sdev_avg = (cam->info_sdev_tot / cam->info_diff_cnt);
+        item.mov.diff_avg = (int64_t)(cam->info_diff_tot / cam->info_diff_cnt);
+        item.mov.sdev_avg = (int64_t)(cam->info_sdev_tot / cam->info_diff_cnt);
     } else {
-        sdev_avg =0;
+        item.mov.diff_avg = 0;
+        item.mov.sdev_avg = 0;
     }
 
-    sqlquery =  "insert into motionplus ";
-    sqlquery += " (device_id, movie_nm, movie_dir, full_nm, movie_sz, movie_dtl";
-    sqlquery += " , movie_tmc, movie_tml, diff_avg, sdev_min, sdev_max, sdev_avg)";
-    sqlquery += " values ("+std::to_string(cam->device_id);
-    sqlquery += " ,'" + std::string(movie->movie_nm) + "'";
-    sqlquery += " ,'" + std::string(movie->movie_dir) + "'";
-    sqlquery += " ,'" + std::string(movie->full_nm) + "'";
-    sqlquery += " ,"  + std::to_string(bsz);
-    sqlquery += " ,"  + std::string(dtl);
-    sqlquery += " ,'" + std::string(tmc)+ "'";
-    sqlquery += " ,'" + std::string(tml)+ "'";
-    sqlquery += " ,"  + std::to_string(diff_avg);
-    sqlquery += " ,"  + std::to_string(cam->info_sdev_min);
-    sqlquery += " ,"  + std::to_string(cam->info_sdev_max);
-    sqlquery += " ,"  + std::to_string(sdev_avg);
-    sqlquery += ")";
+    item.mov.device_id = cam->device_id;
+    item.mov.movie_nm = movie->movie_nm;
+    item.mov.movie_dir = movie->movie_dir;
+    item.mov.full_nm = movie->full_nm;
+    item.mov.movie_dtl = atoi(dtl);
+    item.mov.movie_tmc = tmc;
+    item.mov.movie_tml = tml;
+    item.mov.sdev_min = cam->info_sdev_min;
+    item.mov.sdev_max = cam->info_sdev_max;
 
-    dbse_exec_sql(cam->motapp, sqlquery.c_str());
+    item.open = true;
+    item.addrec = true;
+    dbse_put(cam->motapp, item);
 
 }
 
@@ -1400,6 +2340,16 @@ void ctx_motapp::dbse_movies_getlist(int device_id)
     ::dbse_movies_getlist(this, device_id);
 }
 
+void ctx_motapp::dbse_movies_load(int device_id)
+{
+    ::dbse_movies_load(this, device_id);
+}
+
+std::string ctx_motapp::dbse_movies_fullnm(int device_id, std::string movie_nm)
+{
+    return ::dbse_movies_fullnm(this, device_id, movie_nm);
+}
+
 void ctx_dev::dbse_exec(char *filename
                , int sqltype, timespec *ts1, const char *cmd)
 {
@@ -27,6 +27,9 @@
 #include "motionplus.hpp"
 #include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <map>
+#include <list>
 #ifdef HAVE_MYSQL
         #include <mysql.h>
         #ifndef HAVE_DBSE
@@ -55,12 +58,23 @@
         #endif
     #endif
 
+    #define DBSE_BATCH_MAX    64    /* Queries written in one transaction */
+    #define DBSE_CLEAN_ROWS   100   /* Records checked for missing files in one step */
+    #define DBSE_CLEAN_WAIT   1     /* Seconds between the steps of a cleanup pass */
+    #define DBSE_CLEAN_PASS   3600  /* Seconds between the cleanup passes */
+    #define DBSE_VACUUM_PCT   25    /* Percent of free pages in sqlite3 that triggers a vacuum */
+    #define DBSE_VACUUM_MIN   256   /* Minimum free pages in sqlite3 that trigger a vacuum */
+    #define DBSE_RELOAD_WAIT  30    /* Minimum seconds between reloads of a list for unknown movies */
+
     enum DBSE_ACT {
         DBSE_TBL_CHECK,
         DBSE_TBL_CREATE,
         DBSE_MOV_COUNT,
         DBSE_MOV_SELECT,
-        DBSE_MOV_CLEAN,
+        DBSE_CLN_CURSOR,
+        DBSE_CLN_SELECT,
+        DBSE_CLN_DELETE,
+        DBSE_CLN_PAGES,
         DBSE_COLS_LIST,
         DBSE_COLS_ADD,
         DBSE_END
@@ -91,16 +105,51 @@
         char        *col_typ;   /*Data type of the column*/
     };
 
+    /* Values of a new record of the motionplus table */
+    struct ctx_dbse_mov {
+        int             device_id;
+        std::string     movie_nm;
+        std::string     movie_dir;
+        std::string     full_nm;
+        int64_t         movie_sz;
+        int             movie_dtl;
+        std::string     movie_tmc;
+        std::string     movie_tml;
+        int64_t         diff_avg;
+        int64_t         sdev_min;
+        int64_t         sdev_max;
+        int64_t         sdev_avg;
+    };
+
+    /* Query waiting for the database thread */
+    struct ctx_dbse_sql {
+        std::string     sql;
+        bool            open;       /* Open the database if it is not open */
+        bool            addrec;     /* Insert mov with the prepared statement instead of sql */
+        ctx_dbse_mov    mov;
+    };
+
+    /* Movies of one device loaded from the database */
+    struct ctx_dbse_movies {
+        int                 movie_cnt;      /* count of movie_list */
+        struct ctx_dbse_rec *movie_list;    /* movies ordered by date and time */
+        std::unordered_map<std::string, int> movie_idx; /* movie_list index by movie_nm */
+        time_t              load_tm;        /* time the list was read from the database */
+    };
+
     /* Database context structure*/
     struct ctx_dbse {
         #ifdef HAVE_SQLITE3
             sqlite3 *database_sqlite3;
+            sqlite3_stmt *stmt_sqlite3_addrec;
         #endif
         #ifdef HAVE_MARIADB
             MYSQL *database_mariadb;
+            MYSQL_STMT *stmt_mariadb_addrec;
         #endif
         #ifdef HAVE_PGSQL
             PGconn *database_pgsql;
+            bool pgsql_addrec_ok;   /* addrec statement is prepared on the connection */
         #endif
 
         std::string     database_type;
@@ -117,10 +166,33 @@
         bool                table_ok;       /* bool of whether table exists*/
         int                 rec_indx;       /* index of recordset */
         int                 movie_cnt;      /* count of movie_list */
-        struct ctx_dbse_rec *movie_list;    /* list of movies from the database*/
+        struct ctx_dbse_rec *movie_list;    /* movies being read from the database*/
+        std::map<int, ctx_dbse_movies> movies;  /* loaded movie lists by device_id */
         int                 cols_cnt;       /* count of columns */
         struct ctx_dbse_col *cols_list;     /* columns of table from the database*/
         bool                is_open;
+        bool                in_batch;       /* queries are part of a transaction */
+        bool                batch_err;      /* a query of the transaction failed */
+
+        std::list<ctx_dbse_sql> queue;      /* queries waiting for the database thread */
+        int                 queue_max;
+        int                 queue_peak;
+        pthread_mutex_t     mutex_queue;
+        pthread_cond_t      cond_queue;     /* Signaled when queries are queued or on shutdown */
+        pthread_t           thread_id;
+        volatile bool       thread_running;
+        volatile bool       closing;
+        uint64_t            write_cnt;
+        uint64_t            batch_cnt;
+        uint64_t            drop_cnt;       /* queries discarded with a full queue */
+
+        int64_t             clean_cursor;   /* last record_id checked or -1 when not loaded */
+        int64_t             clean_last;     /* last record_id of the current step */
+        int                 clean_rows;     /* records read in the current step */
+        std::list<int64_t>  clean_ids;      /* records of missing files to delete */
+        int64_t             page_cnt;       /* sqlite3 pages of the database */
+        int64_t             free_cnt;       /* sqlite3 pages on the freelist */
+        uint64_t            clean_cnt;      /* records deleted by the cleanup */
 
     };
 /*
@@ -1250,9 +1250,6 @@ void draw_init_scale(ctx_dev *cam)
             ,_("Invalid text scale.  Adjusted to %d"), cam->text_scale);
     }
 
-    /* If we had to modify the scale, change conf so we don't get another message */
-    cam->conf->text_scale = cam->text_scale;
-
 }
 
 static void draw_location(ctx_coord *cent, ctx_images *imgs, int width
@@ -27,6 +27,8 @@
 #include "video_loopback.hpp"
 #include "webu_stream.hpp"
 #include "alg_sec.hpp"
+#include "pic_writer.hpp"
+#include "extpipe.hpp"
 
 namespace {
 #if 0
@@ -178,8 +180,8 @@ static void event_vlp_putpipe(ctx_dev *cam, motion_event evnt
     (void)fname;
     (void)ts1;
 
-    if (*(int *)ftype >= 0) {
-        if (vlp_putpipe(*(int *)ftype, img_data->image_norm, cam->imgs.size_norm) == -1) {
+    if (ftype != NULL) {
+        if (vlp_putpipe((ctx_vlp *)ftype, img_data->image_norm, cam->imgs.size_norm) == -1) {
             MOTPLS_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
                 ,_("Failed to put image into video pipe"));
         }
@@ -216,12 +218,10 @@ static void event_image_detect(ctx_dev *cam, motion_event evnt
         }
         passthrough = mycheck_passthrough(cam);
         if ((cam->imgs.size_high > 0) && (!passthrough)) {
-            pic_save_norm(cam, fullfilename,img_data->image_high, FTYPE_IMAGE);
+            picwrt_save_norm(cam, fullfilename,img_data->image_high, FTYPE_IMAGE, ts1);
         } else {
-            pic_save_norm(cam, fullfilename,img_data->image_norm, FTYPE_IMAGE);
+            picwrt_save_norm(cam, fullfilename,img_data->image_norm, FTYPE_IMAGE, ts1);
         }
-        cam->event(EVENT_FILECREATE, NULL, fullfilename, (void *)FTYPE_IMAGE, ts1);
-        cam->dbse_exec(fullfilename, FTYPE_IMAGE, ts1, "pic_save");
     }
 }
 
@@ -238,7 +238,7 @@ static void event_imagem_detect(ctx_dev *cam, motion_event evnt
     (void)fname;
     (void)ftype;
 
-    if (cam->conf->picture_output_motion == "on") {
+    if (cam->picture_output_motion == PICMOT_ON) {
         mystrftime(cam, filename, sizeof(filename), cam->conf->picture_filename.c_str(), ts1, NULL, 0);
         retcd = snprintf(fullfilename, PATH_MAX, "%s/%sm.%s"
             , cam->conf->target_dir.c_str(), filename, imageext(cam));
@@ -247,10 +247,8 @@ static void event_imagem_detect(ctx_dev *cam, motion_event evnt
                 ,_("Error creating image motion file name"));
             return;
         }
-        pic_save_norm(cam, fullfilename, cam->imgs.image_motion.image_norm, FTYPE_IMAGE_MOTION);
-        cam->event(EVENT_FILECREATE, NULL, fullfilename, (void *)FTYPE_IMAGE_MOTION, ts1);
-        cam->dbse_exec(fullfilename, FTYPE_IMAGE_MOTION, ts1, "pic_save");
-    } else if (cam->conf->picture_output_motion == "roi") {
+        picwrt_save_norm(cam, fullfilename, cam->imgs.image_motion.image_norm, FTYPE_IMAGE_MOTION, ts1);
+    } else if (cam->picture_output_motion == PICMOT_ROI) {
         mystrftime(cam, filename, sizeof(filename), cam->conf->picture_filename.c_str(), ts1, NULL, 0);
         retcd = snprintf(fullfilename, PATH_MAX, "%s/%sr.%s"
             , cam->conf->target_dir.c_str(), filename, imageext(cam));
@@ -259,9 +257,7 @@ static void event_imagem_detect(ctx_dev *cam, motion_event evnt
                 ,_("Error creating image motion roi file name"));
             return;
         }
-        pic_save_roi(cam, fullfilename, cam->current_image->image_norm);
-        cam->event(EVENT_FILECREATE, NULL, fullfilename, (void *)FTYPE_IMAGE_ROI, ts1);
-        cam->dbse_exec(fullfilename, FTYPE_IMAGE_ROI, ts1, "pic_save");
+        picwrt_save_roi(cam, fullfilename, cam->current_image->image_norm, ts1);
     }
 }
 
@@ -296,9 +292,7 @@ static void event_image_snapshot(ctx_dev *cam, motion_event evnt
             MOTPLS_LOG(INF, TYPE_STREAM, NO_ERRNO, _("Error option"));
         }
 
-        pic_save_norm(cam, fullfilename, img_data->image_norm, FTYPE_IMAGE_SNAPSHOT);
-        cam->event(EVENT_FILECREATE, NULL, fullfilename, (void *)FTYPE_IMAGE_SNAPSHOT, ts1);
-        cam->dbse_exec(fullfilename, FTYPE_IMAGE_SNAPSHOT, ts1, "pic_save");
+        picwrt_save_norm(cam, fullfilename, img_data->image_norm, FTYPE_IMAGE_SNAPSHOT, ts1);
 
         /* Update symbolic link */
         snprintf(linkpath, PATH_MAX, "%s/lastsnap.%s", cam->conf->target_dir.c_str(), imageext(cam));
@@ -321,9 +315,7 @@ static void event_image_snapshot(ctx_dev *cam, motion_event evnt
         }
 
         remove(fullfilename);
-        pic_save_norm(cam, fullfilename, img_data->image_norm, FTYPE_IMAGE_SNAPSHOT);
-        cam->event(EVENT_FILECREATE, NULL, fullfilename, (void *)FTYPE_IMAGE_SNAPSHOT, ts1);
-        cam->dbse_exec(fullfilename, FTYPE_IMAGE_SNAPSHOT, ts1, "pic_save");
+        picwrt_save_norm(cam, fullfilename, img_data->image_norm, FTYPE_IMAGE_SNAPSHOT, ts1);
     }
 
     cam->snapshot = 0;
@@ -358,12 +350,10 @@ static void event_image_preview(ctx_dev *cam, motion_event evnt
         }
         passthrough = mycheck_passthrough(cam);
         if ((cam->imgs.size_high > 0) && (!passthrough)) {
-            pic_save_norm(cam, previewname, cam->imgs.image_preview.image_high , FTYPE_IMAGE);
+            picwrt_save_norm(cam, previewname, cam->imgs.image_preview.image_high , FTYPE_IMAGE, ts1);
         } else {
-            pic_save_norm(cam, previewname, cam->imgs.image_preview.image_norm, FTYPE_IMAGE);
+            picwrt_save_norm(cam, previewname, cam->imgs.image_preview.image_norm, FTYPE_IMAGE, ts1);
         }
-        cam->event(EVENT_FILECREATE, NULL, previewname, (void *)FTYPE_IMAGE, ts1);
-        cam->dbse_exec(previewname, FTYPE_IMAGE, ts1, "pic_save");
 
         /* Restore global context values. */
         cam->current_image = saved_current_image;
@@ -444,12 +434,8 @@ static void event_extpipe_end(ctx_dev *cam, motion_event evnt
 
     if (cam->extpipe_open) {
         cam->extpipe_open = 0;
-        fflush(cam->extpipe);
-        MOTPLS_LOG(NTC, TYPE_EVENTS, NO_ERRNO
-            ,_("CLOSING: extpipe file desc %d, error state %d")
-            ,fileno(cam->extpipe), ferror(cam->extpipe));
-        MOTPLS_LOG(NTC, TYPE_EVENTS, NO_ERRNO, "pclose return: %d",
-                   pclose(cam->extpipe));
+        /* Writes the remaining images and closes the pipe */
+        extpipe_deinit(cam);
 
         if ((cam->conf->movie_retain == "secondary") && (cam->algsec_inuse)) {
             if (cam->algsec->isdetected == false) {
@@ -466,7 +452,6 @@ static void event_extpipe_end(ctx_dev *cam, motion_event evnt
             cam->event(EVENT_FILECLOSE, NULL, cam->extpipefilename, (void *)FTYPE_MOVIE, ts1);
             cam->dbse_exec(cam->extpipefilename, FTYPE_MOVIE, ts1, "movie_end");
         }
-        cam->extpipe = NULL;
     }
 }
 
@@ -540,6 +525,12 @@ static void event_extpipe_start(ctx_dev *cam, motion_event evnt
 
         setbuf(cam->extpipe, NULL);
         cam->extpipe_open = 1;
+
+        if ((cam->imgs.size_high > 0) && (!mycheck_passthrough(cam))) {
+            extpipe_init(cam, cam->imgs.size_high);
+        } else {
+            extpipe_init(cam, cam->imgs.size_norm);
+        }
     }
 }
 
@@ -561,15 +552,9 @@ static void event_extpipe_put(ctx_dev *cam, motion_event evnt
         /* Check that is open */
         if ((cam->extpipe_open) && (fileno(cam->extpipe) > 0)) {
             if ((cam->imgs.size_high > 0) && (!passthrough)) {
-                if (!fwrite(img_data->image_high, cam->imgs.size_high, 1, cam->extpipe)) {
-                    MOTPLS_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
-                        ,_("Error writing in pipe , state error %d"), ferror(cam->extpipe));
-                }
+                extpipe_put(cam, img_data->image_high);
             } else {
-                if (!fwrite(img_data->image_norm, cam->imgs.size_norm, 1, cam->extpipe)) {
-                    MOTPLS_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
-                        ,_("Error writing in pipe , state error %d"), ferror(cam->extpipe));
-                }
+                extpipe_put(cam, img_data->image_norm);
            }
         } else {
             MOTPLS_LOG(ERR, TYPE_EVENTS, NO_ERRNO
@@ -578,12 +563,77 @@ static void event_extpipe_put(ctx_dev *cam, motion_event evnt
     }
 }
 
+/* Difference in seconds between the two times */
+static double event_segment_diff(struct timespec *ts_end, struct timespec *ts_st)
+{
+    return (double)(ts_end->tv_sec - ts_st->tv_sec) +
+        ((double)(ts_end->tv_nsec - ts_st->tv_nsec) / 1000000000.0);
+}
+
+/* Remember the segment and offset where the event starts */
+static void event_segment_mark(ctx_dev *cam, struct timespec *ts1)
+{
+    cam->segment_evt_ts = *ts1;
+    cam->segment_evt_nm[0] = '\0';
+    cam->segment_evt_ofs = 0;
+
+    /* The pre capture images may reach back into the prior segment */
+    if ((cam->movie_norm != NULL) && (cam->movie_norm->segment) &&
+        (event_segment_diff(ts1, &cam->movie_norm->start_time) >= 0)) {
+        snprintf(cam->segment_evt_nm, PATH_MAX, "%s", cam->movie_norm->full_nm);
+        cam->segment_evt_ofs = event_segment_diff(ts1, &cam->movie_norm->start_time);
+    } else if ((cam->segment_prev_nm[0] != '\0') &&
+        (event_segment_diff(ts1, &cam->segment_prev_ts) >= 0)) {
+        snprintf(cam->segment_evt_nm, PATH_MAX, "%s", cam->segment_prev_nm);
+        cam->segment_evt_ofs = event_segment_diff(ts1, &cam->segment_prev_ts);
+    }
+}
+
+/* Add the event to the index of the continuous recording */
+static void event_segment_index(ctx_dev *cam, struct timespec *ts1)
+{
+    char idx_nm[PATH_MAX];
+    FILE *idx_file;
+    long idx_pos;
+
+    if (cam->segment_evt_ts.tv_sec == 0) {
+        return;
+    }
+
+    snprintf(idx_nm, PATH_MAX, "%s/events.csv", cam->conf->target_dir.c_str());
+
+    /* The check for an empty file and the writes are done as one step */
+    pthread_mutex_lock(&cam->motapp->mutex_evtidx);
+        idx_file = myfopen(idx_nm, "ae");
+        if (idx_file == NULL) {
+            pthread_mutex_unlock(&cam->motapp->mutex_evtidx);
+            MOTPLS_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
+                ,_("Unable to open event index %s"), idx_nm);
+            cam->segment_evt_ts.tv_sec = 0;
+            return;
+        }
+
+        fseek(idx_file, 0, SEEK_END);
+        idx_pos = ftell(idx_file);
+        if (idx_pos == 0) {
+            fprintf(idx_file, "camera,event,start,end,file,offset\n");
+        }
+        fprintf(idx_file, "%d,%d,%ld.%03ld,%ld.%03ld,%s,%.3f\n"
+            , cam->device_id, cam->event_nr
+            , (long)cam->segment_evt_ts.tv_sec, cam->segment_evt_ts.tv_nsec / 1000000
+            , (long)ts1->tv_sec, ts1->tv_nsec / 1000000
+            , cam->segment_evt_nm, cam->segment_evt_ofs);
+        myfclose(idx_file);
+    pthread_mutex_unlock(&cam->motapp->mutex_evtidx);
+
+    cam->segment_evt_ts.tv_sec = 0;
+}
+
 static void event_movie_start(ctx_dev *cam, motion_event evnt
         ,ctx_image_data *img_data, char *fname, void *ftype, struct timespec *ts1)
 {
     int retcd;
 
-    (void)evnt;
     (void)img_data;
     (void)fname;
     (void)ftype;
@@ -597,7 +647,12 @@ static void event_movie_start(ctx_dev *cam, motion_event evnt
         cam->movie_fps = cam->lastrate;
     }
 
-    if (cam->conf->movie_output) {
+    if ((cam->conf->movie_output) && (cam->conf->movie_segment > 0)) {
+        /* The continuous recording only needs to know where the event is */
+        if (evnt == EVENT_START) {
+            event_segment_mark(cam, ts1);
+        }
+    } else if (cam->conf->movie_output) {
         retcd = cam->movie_init_norm(ts1);
         if (retcd < 0) {
             MOTPLS_LOG(ERR, TYPE_EVENTS, NO_ERRNO
@@ -628,7 +683,7 @@ static void event_movie_put(ctx_dev *cam, motion_event evnt
     (void)fname;
     (void)ftype;
 
-    if (cam->movie_norm) {
+    if ((cam->movie_norm) && (cam->movie_norm->segment == false)) {
         if (cam->movie_norm->movie_put_image(img_data, ts1) == -1) {
             MOTPLS_LOG(ERR, TYPE_EVENTS, NO_ERRNO, _("Error encoding image"));
         }
@@ -645,12 +700,15 @@ static void event_movie_end(ctx_dev *cam, motion_event evnt
 {
 
     int retcd;
-    (void)evnt;
     (void)img_data;
     (void)fname;
     (void)ftype;
 
-    if (cam->movie_norm) {
+    if (evnt == EVENT_END) {
+        event_segment_index(cam, ts1);
+    }
+
+    if ((cam->movie_norm) && (cam->movie_norm->segment == false)) {
         if ((cam->conf->movie_retain == "secondary") && (cam->algsec_inuse)) {
             if (cam->algsec->isdetected == false) {
                 retcd = remove(cam->movie_norm->full_nm);
@@ -706,6 +764,80 @@ static void event_movie_end(ctx_dev *cam, motion_event evnt
     }
 }
 
+/* Close the current segment of the continuous recording */
+static void event_segment_close(ctx_dev *cam, struct timespec *ts1)
+{
+    snprintf(cam->segment_prev_nm, PATH_MAX, "%s", cam->movie_norm->full_nm);
+    cam->segment_prev_ts = cam->movie_norm->start_time;
+
+    cam->event(EVENT_FILECLOSE, NULL, cam->movie_norm->full_nm
+        , (void *)FTYPE_MOVIE, ts1);
+    cam->dbse_exec(cam->movie_norm->full_nm
+        , FTYPE_MOVIE, ts1, "movie_end");
+    cam->dbse_movies_addrec(cam->movie_norm, ts1);
+    cam->movie_norm->movie_close();
+    myfree(&cam->movie_norm);
+}
+
+static void event_segment_put(ctx_dev *cam, motion_event evnt
+        ,ctx_image_data *img_data, char *fname, void *ftype, struct timespec *ts1)
+{
+    int retcd;
+
+    (void)evnt;
+    (void)fname;
+    (void)ftype;
+
+    if (cam->movie_norm != NULL) {
+        /* A movie of an event started before the segments were enabled */
+        if (cam->movie_norm->segment == false) {
+            return;
+        }
+        if ((ts1->tv_sec - cam->movie_norm->start_time.tv_sec) >=
+            cam->conf->movie_segment) {
+            event_segment_close(cam, ts1);
+        }
+    }
+
+    if (cam->movie_norm == NULL) {
+        if (ts1->tv_sec < cam->segment_retry) {
+            return;
+        }
+        if (cam->lastrate < 2) {
+            cam->movie_fps = 2;
+        } else {
+            cam->movie_fps = cam->lastrate;
+        }
+        retcd = cam->movie_init_norm(ts1);
+        if (retcd < 0) {
+            MOTPLS_LOG(ERR, TYPE_EVENTS, NO_ERRNO
+                ,_("Error opening movie segment.  Retrying in 10 seconds"));
+            myfree(&cam->movie_norm);
+            cam->segment_retry = ts1->tv_sec + 10;
+            return;
+        }
+        cam->event(EVENT_FILECREATE, NULL, cam->movie_norm->full_nm, (void *)FTYPE_MOVIE, ts1);
+        cam->dbse_exec(cam->movie_norm->full_nm, FTYPE_MOVIE, ts1, "movie_start");
+    }
+
+    if (cam->movie_norm->movie_put_image(img_data, ts1) == -1) {
+        MOTPLS_LOG(ERR, TYPE_EVENTS, NO_ERRNO, _("Error encoding image"));
+    }
+}
+
+static void event_segment_end(ctx_dev *cam, motion_event evnt
+        ,ctx_image_data *img_data, char *fname, void *ftype, struct timespec *ts1)
+{
+    (void)evnt;
+    (void)img_data;
+    (void)fname;
+    (void)ftype;
+
+    if ((cam->movie_norm != NULL) && (cam->movie_norm->segment)) {
+        event_segment_close(cam, ts1);
+    }
+}
+
 static void event_tlapse_start(ctx_dev *cam, motion_event evnt
         ,ctx_image_data *img_data, char *fname, void *ftype, struct timespec *ts1)
 {
@@ -886,6 +1018,14 @@ struct event_handlers event_handlers[] = {
     EVENT_SECDETECT,
     event_secondary_detect
     },
+    {
+    EVENT_SEGMENT_PUT,
+    event_segment_put
+    },
+    {
+    EVENT_SEGMENT_END,
+    event_segment_end
+    },
     {(motion_event)0, NULL}
 };
 
@@ -0,0 +1,405 @@
+/*
+ *    This file is part of MotionPlus.
+ *
+ *    MotionPlus is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    MotionPlus is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with MotionPlus.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *    Copyright 2020-2023 MotionMrDave@gmail.com
+ */
+
+/*
+ * extpipe.cpp
+ *   Writer thread for the images sent to the movie_extpipe program.  The
+ *   camera thread copies the image into one of a few slots and the writer
+ *   thread sends it to the pipe which is non-blocking and enlarged.  On
+ *   Linux the slot pages are handed to the pipe with vmsplice so they are
+ *   not copied again.  A spliced slot is only reused once the program has
+ *   read past it.  When all the slots are busy, movie_extpipe_drop decides
+ *   whether the camera waits or a frame is dropped.
+ */
+
+#include "motionplus.hpp"
+#include "conf.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+#include "extpipe.hpp"
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+/* Return the spliced slots that the program has read */
+static void extpipe_reclaim(ctx_extpipe *expipe)
+{
+    int indx, pending;
+    uint64_t consumed;
+
+    /* The mutex is held by the caller and also by the writer across each
+     * write to the pipe so wr_bytes includes everything in the pipe.
+     */
+    if (ioctl(expipe->fd, FIONREAD, &pending) != 0) {
+        return;
+    }
+    if ((pending < 0) || ((uint64_t)pending > expipe->wr_bytes)) {
+        return;
+    }
+    consumed = expipe->wr_bytes - (uint64_t)pending;
+
+    for (indx = 0; indx < EXTPIPE_SLOTS; indx++) {
+        if ((expipe->slots[indx].state == EXTPIPE_SPLICED) &&
+            (expipe->slots[indx].wr_end <= consumed)) {
+            expipe->slots[indx].state = EXTPIPE_FREE;
+        }
+    }
+}
+
+/* Get a free slot or -1 when all are busy */
+static int extpipe_slot_free(ctx_extpipe *expipe)
+{
+    int indx;
+
+    extpipe_reclaim(expipe);
+    for (indx = 0; indx < EXTPIPE_SLOTS; indx++) {
+        if (expipe->slots[indx].state == EXTPIPE_FREE) {
+            return indx;
+        }
+    }
+    return -1;
+}
+
+/* Wait until the pipe can take more data */
+static bool extpipe_wait(ctx_extpipe *expipe)
+{
+    struct pollfd fds;
+    int retcd;
+
+    fds.fd = expipe->fd;
+    fds.events = POLLOUT;
+    fds.revents = 0;
+    retcd = poll(&fds, 1, 1000);
+    if ((retcd < 0) && (errno != EINTR)) {
+        return false;
+    }
+    if (fds.revents & (POLLERR | POLLHUP)) {
+        return false;
+    }
+    return true;
+}
+
+/* Send one image to the pipe.  Returns whether the pages were spliced */
+static bool extpipe_write(ctx_extpipe *expipe, unsigned char *image)
+{
+    struct iovec iov;
+    ssize_t retcd;
+    size_t done;
+    int errnum;
+    bool spliced;
+
+    done = 0;
+    spliced = false;
+    while ((done < (size_t)expipe->frame_size) && (expipe->broken == false)) {
+        /* The pipe is non-blocking so the lock is only held for the copy
+         * or splice.  Counting the bytes under the same lock keeps the
+         * reclaim from seeing data in the pipe that is not yet counted.
+         */
+        pthread_mutex_lock(&expipe->mutex);
+            #if defined(__linux__)
+                if (expipe->use_splice) {
+                    iov.iov_base = image + done;
+                    iov.iov_len = (size_t)expipe->frame_size - done;
+                    retcd = vmsplice(expipe->fd, &iov, 1, SPLICE_F_NONBLOCK);
+                    if (retcd > 0) {
+                        spliced = true;
+                    }
+                } else {
+                    retcd = write(expipe->fd, image + done, (size_t)expipe->frame_size - done);
+                }
+            #else
+                (void)iov;
+                retcd = write(expipe->fd, image + done, (size_t)expipe->frame_size - done);
+            #endif
+            errnum = errno;
+            if (retcd > 0) {
+                expipe->wr_bytes += (uint64_t)retcd;
+            }
+        pthread_mutex_unlock(&expipe->mutex);
+        errno = errnum;
+
+        #if defined(__linux__)
+            if (expipe->use_splice && (retcd < 0) &&
+                ((errno == EINVAL) || (errno == ENOSYS))) {
+                MOTPLS_LOG(INF, TYPE_EVENTS, NO_ERRNO
+                    ,_("vmsplice not available for extpipe, using write"));
+                expipe->use_splice = false;
+                continue;
+            }
+        #endif
+
+        if (retcd > 0) {
+            done += (size_t)retcd;
+        } else if ((retcd < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+            if (extpipe_wait(expipe) == false) {
+                expipe->broken = true;
+            }
+        } else {
+            MOTPLS_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
+                ,_("Error writing to extpipe"));
+            expipe->broken = true;
+        }
+    }
+
+    return spliced;
+}
+
+static void *extpipe_handler(void *arg)
+{
+    ctx_extpipe *expipe = (ctx_extpipe *)arg;
+    ctx_dev *cam = expipe->cam;
+    int indx;
+    bool spliced;
+
+    mythreadname_set("ep", cam->threadnr, cam->conf->device_name.c_str());
+
+    pthread_mutex_lock(&expipe->mutex);
+    while (true) {
+        while (expipe->queue.empty() && (expipe->closing == false)) {
+            pthread_cond_wait(&expipe->cond_work, &expipe->mutex);
+        }
+        /* The queued images are still written when closing */
+        if (expipe->queue.empty()) {
+            break;
+        }
+        indx = expipe->queue.front();
+        expipe->queue.pop_front();
+        expipe->slots[indx].state = EXTPIPE_WRITING;
+        pthread_mutex_unlock(&expipe->mutex);
+
+        spliced = extpipe_write(expipe, expipe->slots[indx].image);
+
+        pthread_mutex_lock(&expipe->mutex);
+        if (spliced) {
+            expipe->slots[indx].wr_end = expipe->wr_bytes;
+            expipe->slots[indx].state = EXTPIPE_SPLICED;
+        } else {
+            expipe->slots[indx].state = EXTPIPE_FREE;
+        }
+        if (expipe->broken == false) {
+            expipe->frame_cnt++;
+        } else {
+            expipe->drop_cnt++;
+        }
+        pthread_cond_broadcast(&expipe->cond_space);
+    }
+    pthread_mutex_unlock(&expipe->mutex);
+
+    expipe->thread_running = false;
+
+    pthread_exit(NULL);
+}
+
+/* Set up the pipe and start the writer thread for the opened extpipe */
+void extpipe_init(ctx_dev *cam, int frame_size)
+{
+    ctx_extpipe *expipe;
+    pthread_attr_t thread_attr;
+    int indx, retcd, flags;
+
+    expipe = new ctx_extpipe;
+    expipe->cam = cam;
+    expipe->fd = fileno(cam->extpipe);
+    expipe->frame_size = frame_size;
+    expipe->broken = false;
+    expipe->closing = false;
+    expipe->wr_bytes = 0;
+    expipe->frame_cnt = 0;
+    expipe->drop_cnt = 0;
+    expipe->stall_cnt = 0;
+
+    for (indx = 0; indx < EXTPIPE_SLOTS; indx++) {
+        expipe->slots[indx].state = EXTPIPE_FREE;
+        expipe->slots[indx].image =(unsigned char*)mymalloc(frame_size);
+        expipe->slots[indx].wr_end = 0;
+    }
+
+    flags = fcntl(expipe->fd, F_GETFL);
+    if ((flags == -1) || (fcntl(expipe->fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        MOTPLS_LOG(WRN, TYPE_EVENTS, SHOW_ERRNO
+            ,_("Unable to set the extpipe to non-blocking"));
+    }
+
+    #if defined(__linux__)
+        /* Ask for room for a whole frame.  The system limit may reduce it */
+        retcd = fcntl(expipe->fd, F_SETPIPE_SZ, frame_size);
+        if (retcd == -1) {
+            retcd = fcntl(expipe->fd, F_SETPIPE_SZ, 1048576);
+        }
+        if (retcd != -1) {
+            MOTPLS_LOG(DBG, TYPE_EVENTS, NO_ERRNO
+                ,_("extpipe buffer size %d"), retcd);
+        }
+        expipe->use_splice = true;
+    #else
+        expipe->use_splice = false;
+    #endif
+
+    pthread_mutex_init(&expipe->mutex, NULL);
+    pthread_cond_init(&expipe->cond_work, NULL);
+    pthread_cond_init(&expipe->cond_space, NULL);
+
+    cam->extpipe_writer = expipe;
+
+    expipe->thread_running = true;
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    retcd = pthread_create(&expipe->thread_id, &thread_attr, &extpipe_handler, expipe);
+    pthread_attr_destroy(&thread_attr);
+    if (retcd != 0) {
+        MOTPLS_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
+            ,_("Error starting extpipe writer thread"));
+        expipe->thread_running = false;
+        expipe->broken = true;
+    }
+}
+
+/* Finish writing the images, close the pipe and release the slots */
+void extpipe_deinit(ctx_dev *cam)
+{
+    ctx_extpipe *expipe = cam->extpipe_writer;
+    int indx, waitcnt;
+
+    if (expipe == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&expipe->mutex);
+        expipe->closing = true;
+        pthread_cond_broadcast(&expipe->cond_work);
+    pthread_mutex_unlock(&expipe->mutex);
+
+    /* Allow the program some time to read what is still queued */
+    waitcnt = 0;
+    while ((expipe->thread_running) && (waitcnt < 5000)) {
+        if (waitcnt == 4000) {
+            expipe->broken = true;
+        }
+        SLEEP(0,1000000)
+        waitcnt++;
+    }
+
+    MOTPLS_LOG(NTC, TYPE_EVENTS, NO_ERRNO
+        ,_("CLOSING: extpipe file desc %d, %llu frames written, %llu dropped, %llu waits")
+        , expipe->fd
+        , (unsigned long long)expipe->frame_cnt
+        , (unsigned long long)expipe->drop_cnt
+        , (unsigned long long)expipe->stall_cnt);
+
+    if (waitcnt == 5000) {
+        /* The thread may still be using the descriptor and the slots
+         * so the pipe and the memory are abandoned rather than closed.
+         */
+        MOTPLS_LOG(ERR, TYPE_EVENTS, NO_ERRNO
+            ,_("Graceful shutdown of extpipe writer thread failed.  Pipe left open"));
+        cam->extpipe = NULL;
+        cam->extpipe_writer = NULL;
+        return;
+    }
+
+    /* The spliced pages belong to the pipe until the program has exited */
+    MOTPLS_LOG(NTC, TYPE_EVENTS, NO_ERRNO, "pclose return: %d",
+               pclose(cam->extpipe));
+    cam->extpipe = NULL;
+    cam->extpipe_writer = NULL;
+
+    for (indx = 0; indx < EXTPIPE_SLOTS; indx++) {
+        myfree(&expipe->slots[indx].image);
+    }
+    pthread_cond_destroy(&expipe->cond_space);
+    pthread_cond_destroy(&expipe->cond_work);
+    pthread_mutex_destroy(&expipe->mutex);
+
+    delete expipe;
+}
+
+/* Wait on the condition for at most the number of milliseconds */
+static void extpipe_timedwait(ctx_extpipe *expipe, int msec)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long)msec * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&expipe->cond_space, &expipe->mutex, &ts);
+}
+
+/* Queue a copy of the image for the writer thread */
+void extpipe_put(ctx_dev *cam, unsigned char *image)
+{
+    ctx_extpipe *expipe = cam->extpipe_writer;
+    int indx;
+    bool waited;
+
+    if (expipe == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&expipe->mutex);
+        if (expipe->broken) {
+            expipe->drop_cnt++;
+            pthread_mutex_unlock(&expipe->mutex);
+            return;
+        }
+
+        indx = extpipe_slot_free(expipe);
+        if (indx == -1) {
+            if (cam->conf->movie_extpipe_drop == "newest") {
+                expipe->drop_cnt++;
+                pthread_mutex_unlock(&expipe->mutex);
+                return;
+            } else if ((cam->conf->movie_extpipe_drop == "oldest") &&
+                (expipe->queue.empty() == false)) {
+                /* Reuse the oldest image the thread has not started */
+                indx = expipe->queue.front();
+                expipe->queue.pop_front();
+                expipe->drop_cnt++;
+            } else {
+                /* Spliced slots free up without a signal so check again shortly */
+                waited = false;
+                while ((indx == -1) && (expipe->broken == false)) {
+                    if (waited == false) {
+                        expipe->stall_cnt++;
+                        waited = true;
+                    }
+                    extpipe_timedwait(expipe, 10);
+                    indx = extpipe_slot_free(expipe);
+                }
+                if (indx == -1) {
+                    expipe->drop_cnt++;
+                    pthread_mutex_unlock(&expipe->mutex);
+                    return;
+                }
+            }
+        }
+
+        expipe->slots[indx].state = EXTPIPE_FILLING;
+    pthread_mutex_unlock(&expipe->mutex);
+
+    memcpy(expipe->slots[indx].image, image, expipe->frame_size);
+
+    pthread_mutex_lock(&expipe->mutex);
+        expipe->slots[indx].state = EXTPIPE_QUEUED;
+        expipe->queue.push_back(indx);
+        pthread_cond_signal(&expipe->cond_work);
+    pthread_mutex_unlock(&expipe->mutex);
+}
@@ -0,0 +1,65 @@
+/*
+ *    This file is part of MotionPlus.
+ *
+ *    MotionPlus is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    MotionPlus is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with MotionPlus.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *    Copyright 2020-2023 MotionMrDave@gmail.com
+ *
+*/
+#ifndef _INCLUDE_EXTPIPE_HPP_
+#define _INCLUDE_EXTPIPE_HPP_
+
+    #define EXTPIPE_SLOTS     8     /* Frames that can be waiting for the external program */
+
+    enum EXTPIPE_SLOT_STATE {
+        EXTPIPE_FREE,
+        EXTPIPE_FILLING,    /* Camera thread is copying the image */
+        EXTPIPE_QUEUED,     /* Waiting for the writer thread */
+        EXTPIPE_WRITING,    /* Being written by the writer thread */
+        EXTPIPE_SPLICED     /* Pages are in the pipe until the program reads them */
+    };
+
+    struct ctx_extpipe_slot {
+        enum EXTPIPE_SLOT_STATE state;
+        unsigned char           *image;
+        uint64_t                wr_end;     /* Bytes written to the pipe including this frame */
+    };
+
+    struct ctx_extpipe {
+        ctx_dev                 *cam;
+        int                     fd;
+        int                     frame_size;
+        ctx_extpipe_slot        slots[EXTPIPE_SLOTS];
+        std::list<int>          queue;          /* Slots waiting to be written in order */
+        bool                    use_splice;
+        volatile bool           broken;         /* The external program stopped reading */
+
+        pthread_mutex_t         mutex;
+        pthread_cond_t          cond_work;      /* Signaled when frames are queued or on shutdown */
+        pthread_cond_t          cond_space;     /* Signaled when a frame has been written */
+        pthread_t               thread_id;
+        volatile bool           thread_running;
+        volatile bool           closing;
+
+        uint64_t                wr_bytes;
+        uint64_t                frame_cnt;
+        uint64_t                drop_cnt;
+        uint64_t                stall_cnt;      /* Times the camera thread waited for a free slot */
+    };
+
+    void extpipe_init(ctx_dev *cam, int frame_size);
+    void extpipe_deinit(ctx_dev *cam);
+    void extpipe_put(ctx_dev *cam, unsigned char *image);
+
+#endif /* _INCLUDE_EXTPIPE_HPP_ */
@@ -39,6 +39,14 @@
  *      jpgutl_buffer_src
  *      jpgutl_error_exit
  *      jpgutl_emit_message
+ *    The following functions keep a compressor for each thread.
+ *      jpgutl_enc_free
+ *      jpgutl_enc_key_init
+ *      jpgutl_enc_get
+ *    When built with TurboJPEG, the planar images are processed directly by
+ *    the TurboJPEG functions and the libjpeg functions are used as the fallback.
+ *      jpgutl_put_turbo
+ *      jpgutl_decode_turbo
  *  Exposed Functions
  *    jpgutl_decode_jpeg
  */
@@ -52,6 +60,9 @@
 #include <jpeglib.h>
 #include <jerror.h>
 #include <assert.h>
+#ifdef HAVE_TURBOJPEG
+    #include <turbojpeg.h>
+#endif
 
 static const uint8_t EOI_data[2] = { 0xFF, 0xD9 };
 
@@ -389,21 +400,238 @@ static GLOBAL(int) _jpeg_mem_size(j_compress_ptr cinfo)
     return (int)dest->jpegsize;
 }
 
+/*
+ * Each thread that compresses images keeps its compressors between images.
+ * The parameters, quantization and huffman tables and destination manager
+ * are only rebuilt when the size or quality of the image changes.
+ */
+struct jpgutl_enc {
+    struct jpeg_compress_struct cinfo;
+    struct jpgutl_error_mgr     jerr;
+    bool                        created;
+    bool                        ready;      /* Parameters set for the values below */
+    int                         width;
+    int                         height;
+    int                         quality;
+};
+
+struct jpgutl_enc_thread {
+    jpgutl_enc  yuv;
+    jpgutl_enc  grey;
+    #ifdef HAVE_TURBOJPEG
+        tjhandle        tj_comp;
+        tjhandle        tj_decomp;
+        unsigned char   *tj_buf;        /* Compressed image before the EXIF is added */
+        unsigned long   tj_buf_size;
+    #endif
+};
+
+static pthread_key_t jpgutl_enc_key;
+static pthread_once_t jpgutl_enc_once = PTHREAD_ONCE_INIT;
+
+/* Release the compressors when the thread ends */
+static void jpgutl_enc_free(void *arg)
+{
+    jpgutl_enc_thread *enc = (jpgutl_enc_thread *)arg;
+
+    if (enc == NULL) {
+        return;
+    }
+    if (enc->yuv.created) {
+        jpeg_destroy_compress(&enc->yuv.cinfo);
+    }
+    if (enc->grey.created) {
+        jpeg_destroy_compress(&enc->grey.cinfo);
+    }
+    #ifdef HAVE_TURBOJPEG
+        if (enc->tj_comp != NULL) {
+            tjDestroy(enc->tj_comp);
+        }
+        if (enc->tj_decomp != NULL) {
+            tjDestroy(enc->tj_decomp);
+        }
+        if (enc->tj_buf != NULL) {
+            tjFree(enc->tj_buf);
+        }
+    #endif
+    delete enc;
+}
+
+static void jpgutl_enc_key_init(void)
+{
+    pthread_key_create(&jpgutl_enc_key, jpgutl_enc_free);
+}
+
+/* Create the compressor and its error manager */
+static void jpgutl_enc_create(jpgutl_enc *enc)
+{
+    enc->created = false;
+    enc->ready = false;
+    enc->width = 0;
+    enc->height = 0;
+    enc->quality = 0;
+
+    enc->cinfo.err = jpeg_std_error (&enc->jerr.pub);
+    enc->jerr.pub.error_exit = jpgutl_error_exit;
+    /* Also hook the emit_message routine to note corrupt-data warnings. */
+    enc->jerr.original_emit_message = enc->jerr.pub.emit_message;
+    enc->jerr.pub.emit_message = jpgutl_emit_message;
+    enc->jerr.warning_seen = 0;
+
+    if (setjmp (enc->jerr.setjmp_buffer)) {
+        return;
+    }
+    jpeg_create_compress(&enc->cinfo);
+    enc->created = true;
+}
+
+/* Get the compressors for the calling thread */
+static jpgutl_enc_thread *jpgutl_enc_get(void)
+{
+    jpgutl_enc_thread *enc;
+
+    pthread_once(&jpgutl_enc_once, jpgutl_enc_key_init);
+
+    enc = (jpgutl_enc_thread *)pthread_getspecific(jpgutl_enc_key);
+    if (enc == NULL) {
+        enc = new jpgutl_enc_thread;
+        jpgutl_enc_create(&enc->yuv);
+        jpgutl_enc_create(&enc->grey);
+        #ifdef HAVE_TURBOJPEG
+            enc->tj_comp = NULL;
+            enc->tj_decomp = NULL;
+            enc->tj_buf = NULL;
+            enc->tj_buf_size = 0;
+        #endif
+        pthread_setspecific(jpgutl_enc_key, enc);
+    }
+
+    return enc;
+}
+
+#ifdef HAVE_TURBOJPEG
+
+/**
+ * jpgutl_put_turbo
+ *  Purpose:  Compress the planar yuv420p or grey image using TurboJPEG.
+ *            The EXIF data is added with jpgutl_insert_exif.
+ *
+ *  Return Values
+ *    Size of the image in dest_image or -1 on failure
+ */
+static int jpgutl_put_turbo(unsigned char *dest_image, int image_size,
+        unsigned char *input_image, int width, int height, int quality,
+        unsigned char *exif, unsigned exif_len, bool grey)
+{
+    jpgutl_enc_thread *enc;
+    const unsigned char *planes[3];
+    unsigned long buf_size, jpeg_size;
+    int subsamp;
+
+    enc = jpgutl_enc_get();
+    if (enc->tj_comp == NULL) {
+        enc->tj_comp = tjInitCompress();
+        if (enc->tj_comp == NULL) {
+            return -1;
+        }
+    }
+
+    if (grey) {
+        subsamp = TJSAMP_GRAY;
+    } else {
+        subsamp = TJSAMP_420;
+    }
+
+    buf_size = tjBufSize(width, height, subsamp);
+    if (enc->tj_buf_size < buf_size) {
+        if (enc->tj_buf != NULL) {
+            tjFree(enc->tj_buf);
+        }
+        enc->tj_buf = tjAlloc((int)buf_size);
+        if (enc->tj_buf == NULL) {
+            enc->tj_buf_size = 0;
+            return -1;
+        }
+        enc->tj_buf_size = buf_size;
+    }
+
+    /* The grey images only use the first plane */
+    planes[0] = input_image;
+    planes[1] = input_image + (width * height);
+    planes[2] = planes[1] + ((width * height) / 4);
+
+    jpeg_size = enc->tj_buf_size;
+    if (tjCompressFromYUVPlanes(enc->tj_comp, planes, width, NULL, height
+            , subsamp, &enc->tj_buf, &jpeg_size, quality
+            , TJFLAG_NOREALLOC | TJFLAG_FASTDCT) != 0) {
+        MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
+            , "%s", tjGetErrorStr2(enc->tj_comp));
+        return -1;
+    }
+
+    return jpgutl_insert_exif(dest_image, image_size
+        , enc->tj_buf, (int)jpeg_size, exif, exif_len);
+}
+
+/**
+ * jpgutl_decode_turbo
+ *  Purpose:  Decompress a 4:2:0 jpeg directly into the planes of img_out.
+ *            Any other jpeg is left for the libjpeg functions to convert.
+ *
+ *  Return Values
+ *    Success 0, Failure -1
+ */
+static int jpgutl_decode_turbo(unsigned char *jpeg_data_in, int jpeg_data_len,
+        unsigned int width, unsigned int height, unsigned char *img_out)
+{
+    jpgutl_enc_thread *enc;
+    unsigned char *planes[3];
+    int jpg_width, jpg_height, subsamp, colorspace;
+
+    enc = jpgutl_enc_get();
+    if (enc->tj_decomp == NULL) {
+        enc->tj_decomp = tjInitDecompress();
+        if (enc->tj_decomp == NULL) {
+            return -1;
+        }
+    }
+
+    if (tjDecompressHeader3(enc->tj_decomp, jpeg_data_in, jpeg_data_len
+            , &jpg_width, &jpg_height, &subsamp, &colorspace) != 0) {
+        return -1;
+    }
+
+    if (((unsigned int)jpg_width != width) ||
+        ((unsigned int)jpg_height != height) ||
+        (subsamp != TJSAMP_420)) {
+        return -1;
+    }
+
+    planes[0] = img_out;
+    planes[1] = img_out + (width * height);
+    planes[2] = planes[1] + ((width * height) / 4);
+
+    /* Warnings also fail here so the libjpeg functions can count them */
+    if (tjDecompressToYUVPlanes(enc->tj_decomp, jpeg_data_in, jpeg_data_len
+            , planes, width, NULL, height, 0) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif /* HAVE_TURBOJPEG */
+
 /*
  * put_jpeg_exif writes the EXIF APP1 chunk to the jpeg file.
  * It must be called after jpeg_start_compress() but before
  * any image data is written by jpeg_write_scanlines().
  */
-static void put_jpeg_exif(j_compress_ptr cinfo, ctx_dev *cam,
-        const struct timespec *ts1, ctx_coord *box)
+static void put_jpeg_exif(j_compress_ptr cinfo, unsigned char *exif, unsigned exif_len)
 {
-    unsigned char *exif = NULL;
-    unsigned exif_len = exif_prepare(&exif, cam, ts1, box);
-
-    if(exif_len > 0) {
+    if ((exif != NULL) && (exif_len > 0)) {
         /* EXIF data lives in a JPEG APP1 marker */
         jpeg_write_marker(cinfo, JPEG_APP0 + 1, exif, exif_len);
-        free(exif);
     }
 }
 
@@ -434,6 +662,13 @@ int jpgutl_decode_jpeg (unsigned char *jpeg_data_in, int jpeg_data_len,
     struct jpeg_decompress_struct dinfo;
     struct jpgutl_error_mgr jerr;
 
+    #ifdef HAVE_TURBOJPEG
+        if (jpgutl_decode_turbo(jpeg_data_in, jpeg_data_len
+                , width, height, img_out) == 0) {
+            return 0;
+        }
+    #endif
+
     /* We set up the normal JPEG error routines, then override error_exit. */
     dinfo.err = jpeg_std_error (&jerr.pub);
     jerr.pub.error_exit = jpgutl_error_exit;
@@ -523,64 +758,77 @@ int jpgutl_decode_jpeg (unsigned char *jpeg_data_in, int jpeg_data_len,
 
 int jpgutl_put_yuv420p(unsigned char *dest_image, int image_size,
         unsigned char *input_image, int width, int height, int quality,
-        ctx_dev *cam, struct timespec *ts1, ctx_coord *box)
-
+        unsigned char *exif, unsigned exif_len)
 {
     int i, j, jpeg_image_size;
 
     JSAMPROW y[16],cb[16],cr[16]; // y[2][5] = color sample of row 2 and pixel column 5; (one plane)
     JSAMPARRAY data[3]; // t[0][2][5] = color sample 0 of row 2 and column 5
 
-    struct jpeg_compress_struct cinfo;
-    struct jpgutl_error_mgr jerr;
+    jpgutl_enc *enc;
+
+    #ifdef HAVE_TURBOJPEG
+        jpeg_image_size = jpgutl_put_turbo(dest_image, image_size, input_image
+            , width, height, quality, exif, exif_len, false);
+        if (jpeg_image_size > 0) {
+            return jpeg_image_size;
+        }
+    #endif
 
     data[0] = y;
     data[1] = cb;
     data[2] = cr;
 
-    cinfo.err = jpeg_std_error (&jerr.pub);
-    jerr.pub.error_exit = jpgutl_error_exit;
-    /* Also hook the emit_message routine to note corrupt-data warnings. */
-    jerr.original_emit_message = jerr.pub.emit_message;
-    jerr.pub.emit_message = jpgutl_emit_message;
-    jerr.warning_seen = 0;
-
-    jpeg_create_compress(&cinfo);
+    enc = &jpgutl_enc_get()->yuv;
+    if (enc->created == false) {
+        return -1;
+    }
+    enc->jerr.warning_seen = 0;
 
     /* Establish the setjmp return context for jpgutl_error_exit to use. */
-    if (setjmp (jerr.setjmp_buffer)) {
+    if (setjmp (enc->jerr.setjmp_buffer)) {
         /* If we get here, the JPEG code has signaled an error. */
-        jpeg_destroy_compress (&cinfo);
+        jpeg_abort_compress(&enc->cinfo);
+        enc->ready = false;
         return -1;
     }
 
-    cinfo.image_width = width;
-    cinfo.image_height = height;
-    cinfo.input_components = 3;
-    jpeg_set_defaults(&cinfo);
-
-    jpeg_set_colorspace(&cinfo, JCS_YCbCr);
-
-    cinfo.raw_data_in = TRUE; // Supply downsampled data
-    #if JPEG_LIB_VERSION >= 70
-        cinfo.do_fancy_downsampling = FALSE;  // Fix segfault with v7
-    #endif
-    cinfo.comp_info[0].h_samp_factor = 2;
-    cinfo.comp_info[0].v_samp_factor = 2;
-    cinfo.comp_info[1].h_samp_factor = 1;
-    cinfo.comp_info[1].v_samp_factor = 1;
-    cinfo.comp_info[2].h_samp_factor = 1;
-    cinfo.comp_info[2].v_samp_factor = 1;
-
-    jpeg_set_quality(&cinfo, quality, TRUE);
-    cinfo.dct_method = JDCT_FASTEST;
-
-    _jpeg_mem_dest(&cinfo, dest_image, image_size);  // Data written to mem
+    if ((enc->ready == false) || (enc->width != width) ||
+        (enc->height != height) || (enc->quality != quality)) {
+        enc->ready = false;
+
+        enc->cinfo.image_width = width;
+        enc->cinfo.image_height = height;
+        enc->cinfo.input_components = 3;
+        jpeg_set_defaults(&enc->cinfo);
+
+        jpeg_set_colorspace(&enc->cinfo, JCS_YCbCr);
+
+        enc->cinfo.raw_data_in = TRUE; // Supply downsampled data
+        #if JPEG_LIB_VERSION >= 70
+            enc->cinfo.do_fancy_downsampling = FALSE;  // Fix segfault with v7
+        #endif
+        enc->cinfo.comp_info[0].h_samp_factor = 2;
+        enc->cinfo.comp_info[0].v_samp_factor = 2;
+        enc->cinfo.comp_info[1].h_samp_factor = 1;
+        enc->cinfo.comp_info[1].v_samp_factor = 1;
+        enc->cinfo.comp_info[2].h_samp_factor = 1;
+        enc->cinfo.comp_info[2].v_samp_factor = 1;
+
+        jpeg_set_quality(&enc->cinfo, quality, TRUE);
+        enc->cinfo.dct_method = JDCT_FASTEST;
+
+        enc->width = width;
+        enc->height = height;
+        enc->quality = quality;
+        enc->ready = true;
+    }
 
+    _jpeg_mem_dest(&enc->cinfo, dest_image, image_size);  // Data written to mem
 
-    jpeg_start_compress(&cinfo, TRUE);
+    jpeg_start_compress(&enc->cinfo, TRUE);
 
-    put_jpeg_exif(&cinfo, cam, ts1, box);
+    put_jpeg_exif(&enc->cinfo, exif, exif_len);
 
     /* If the image is not a multiple of 16, this overruns the buffers
      * we'll just pad those last bytes with zeros
@@ -599,12 +847,12 @@ int jpgutl_put_yuv420p(unsigned char *dest_image, int image_size,
                 cr[i] = 0x00;
             }
         }
-        jpeg_write_raw_data(&cinfo, data, 16);
+        jpeg_write_raw_data(&enc->cinfo, data, 16);
     }
 
-    jpeg_finish_compress(&cinfo);
-    jpeg_image_size = _jpeg_mem_size(&cinfo);
-    jpeg_destroy_compress(&cinfo);
+    /* The compressor keeps its parameters and tables for the next image */
+    jpeg_finish_compress(&enc->cinfo);
+    jpeg_image_size = _jpeg_mem_size(&enc->cinfo);
 
     return jpeg_image_size;
 }
@@ -612,55 +860,164 @@ int jpgutl_put_yuv420p(unsigned char *dest_image, int image_size,
 
 int jpgutl_put_grey(unsigned char *dest_image, int image_size,
         unsigned char *input_image, int width, int height, int quality,
-        ctx_dev *cam, struct timespec *ts1, ctx_coord *box)
+        unsigned char *exif, unsigned exif_len)
 {
     int y, dest_image_size;
     JSAMPROW row_ptr[1];
-    struct jpeg_compress_struct cjpeg;
-    struct jpgutl_error_mgr jerr;
+    jpgutl_enc *enc;
 
-    cjpeg.err = jpeg_std_error (&jerr.pub);
-    jerr.pub.error_exit = jpgutl_error_exit;
-    /* Also hook the emit_message routine to note corrupt-data warnings. */
-    jerr.original_emit_message = jerr.pub.emit_message;
-    jerr.pub.emit_message = jpgutl_emit_message;
-    jerr.warning_seen = 0;
+    #ifdef HAVE_TURBOJPEG
+        dest_image_size = jpgutl_put_turbo(dest_image, image_size, input_image
+            , width, height, quality, exif, exif_len, true);
+        if (dest_image_size > 0) {
+            return dest_image_size;
+        }
+    #endif
 
-    jpeg_create_compress(&cjpeg);
+    enc = &jpgutl_enc_get()->grey;
+    if (enc->created == false) {
+        return -1;
+    }
+    enc->jerr.warning_seen = 0;
 
     /* Establish the setjmp return context for jpgutl_error_exit to use. */
-    if (setjmp (jerr.setjmp_buffer)) {
+    if (setjmp (enc->jerr.setjmp_buffer)) {
         /* If we get here, the JPEG code has signaled an error. */
-        jpeg_destroy_compress (&cjpeg);
+        jpeg_abort_compress(&enc->cinfo);
+        enc->ready = false;
         return -1;
     }
 
-    cjpeg.image_width = width;
-    cjpeg.image_height = height;
-    cjpeg.input_components = 1; /* One colour component */
-    cjpeg.in_color_space = JCS_GRAYSCALE;
+    if ((enc->ready == false) || (enc->width != width) ||
+        (enc->height != height) || (enc->quality != quality)) {
+        enc->ready = false;
+
+        enc->cinfo.image_width = width;
+        enc->cinfo.image_height = height;
+        enc->cinfo.input_components = 1; /* One colour component */
+        enc->cinfo.in_color_space = JCS_GRAYSCALE;
+
+        jpeg_set_defaults(&enc->cinfo);
 
-    jpeg_set_defaults(&cjpeg);
+        jpeg_set_quality(&enc->cinfo, quality, TRUE);
+        enc->cinfo.dct_method = JDCT_FASTEST;
 
-    jpeg_set_quality(&cjpeg, quality, TRUE);
-    cjpeg.dct_method = JDCT_FASTEST;
-    _jpeg_mem_dest(&cjpeg, dest_image, image_size);  // Data written to mem
+        enc->width = width;
+        enc->height = height;
+        enc->quality = quality;
+        enc->ready = true;
+    }
+
+    _jpeg_mem_dest(&enc->cinfo, dest_image, image_size);  // Data written to mem
 
-    jpeg_start_compress (&cjpeg, TRUE);
+    jpeg_start_compress (&enc->cinfo, TRUE);
 
-    put_jpeg_exif(&cjpeg, cam, ts1, box);
+    put_jpeg_exif(&enc->cinfo, exif, exif_len);
 
     row_ptr[0] = input_image;
 
     for (y = 0; y < height; y++) {
-        jpeg_write_scanlines(&cjpeg, row_ptr, 1);
+        jpeg_write_scanlines(&enc->cinfo, row_ptr, 1);
         row_ptr[0] += width;
     }
 
-    jpeg_finish_compress(&cjpeg);
-    dest_image_size = _jpeg_mem_size(&cjpeg);
-    jpeg_destroy_compress(&cjpeg);
+    /* The compressor keeps its parameters and tables for the next image */
+    jpeg_finish_compress(&enc->cinfo);
+    dest_image_size = _jpeg_mem_size(&enc->cinfo);
 
     return dest_image_size;
 }
 
+/* Compress the yuv420p image with the EXIF data for the camera */
+int jpgutl_put_yuv420p(unsigned char *dest_image, int image_size,
+        unsigned char *input_image, int width, int height, int quality,
+        ctx_dev *cam, struct timespec *ts1, ctx_coord *box)
+{
+    int retcd;
+    unsigned char *exif = NULL;
+    unsigned exif_len = exif_prepare(&exif, cam, ts1, box);
+
+    retcd = jpgutl_put_yuv420p(dest_image, image_size, input_image
+        , width, height, quality, exif, exif_len);
+
+    free(exif);
+
+    return retcd;
+}
+
+/* Compress the grey image with the EXIF data for the camera */
+int jpgutl_put_grey(unsigned char *dest_image, int image_size,
+        unsigned char *input_image, int width, int height, int quality,
+        ctx_dev *cam, struct timespec *ts1, ctx_coord *box)
+{
+    int retcd;
+    unsigned char *exif = NULL;
+    unsigned exif_len = exif_prepare(&exif, cam, ts1, box);
+
+    retcd = jpgutl_put_grey(dest_image, image_size, input_image
+        , width, height, quality, exif, exif_len);
+
+    free(exif);
+
+    return retcd;
+}
+
+/**
+ * jpgutl_insert_exif
+ *  Purpose:  Copy a jpeg compressed without EXIF data into dest_image and add
+ *            the EXIF APP1 marker at the same location as put_jpeg_exif.
+ *
+ *  Parameters:
+ *  dest_image       The buffer for the resulting jpeg
+ *  image_size       The size of the dest_image buffer
+ *  jpeg_data        The jpeg compressed without EXIF data
+ *  jpeg_size        The size of the jpeg data
+ *  exif             The EXIF data from exif_prepare
+ *  exif_len         The length of the EXIF data
+ *
+ *  Return Values
+ *    Size of the resulting jpeg, Failure -1
+ */
+int jpgutl_insert_exif(unsigned char *dest_image, int image_size,
+        unsigned char *jpeg_data, int jpeg_size,
+        unsigned char *exif, unsigned exif_len)
+{
+    int offset, marker_len;
+
+    if ((exif == NULL) || (exif_len == 0) || (exif_len > 65533)) {
+        if (jpeg_size > image_size) {
+            return -1;
+        }
+        memcpy(dest_image, jpeg_data, jpeg_size);
+        return jpeg_size;
+    }
+
+    if ((jpeg_size < 4) || (jpeg_data[0] != 0xFF) || (jpeg_data[1] != 0xD8)) {
+        return -1;
+    }
+
+    /* The marker is written after the SOI and the JFIF APP0 marker */
+    offset = 2;
+    if ((jpeg_data[2] == 0xFF) && (jpeg_data[3] == (JPEG_APP0 & 0xFF))) {
+        offset += 2 + ((jpeg_data[4] << 8) | jpeg_data[5]);
+        if (offset > jpeg_size) {
+            return -1;
+        }
+    }
+
+    marker_len = (int)exif_len + 2;
+    if ((jpeg_size + marker_len + 2) > image_size) {
+        return -1;
+    }
+
+    memcpy(dest_image, jpeg_data, offset);
+    dest_image[offset]     = 0xFF;
+    dest_image[offset + 1] = (JPEG_APP0 + 1) & 0xFF;
+    dest_image[offset + 2] = (marker_len >> 8) & 0xFF;
+    dest_image[offset + 3] = marker_len & 0xFF;
+    memcpy(dest_image + offset + 4, exif, exif_len);
+    memcpy(dest_image + offset + 4 + exif_len
+        , jpeg_data + offset, jpeg_size - offset);
+
+    return jpeg_size + marker_len + 2;
+}
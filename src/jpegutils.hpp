@@ -30,5 +30,14 @@
     int jpgutl_put_grey(unsigned char *dest_image, int image_size,
         unsigned char *input_image, int width, int height, int quality,
         ctx_dev *cam, struct timespec *ts1, ctx_coord *box);
+    int jpgutl_put_yuv420p(unsigned char *dest_image, int image_size,
+        unsigned char *input_image, int width, int height, int quality,
+        unsigned char *exif, unsigned exif_len);
+    int jpgutl_put_grey(unsigned char *dest_image, int image_size,
+        unsigned char *input_image, int width, int height, int quality,
+        unsigned char *exif, unsigned exif_len);
+    int jpgutl_insert_exif(unsigned char *dest_image, int image_size,
+        unsigned char *jpeg_data, int jpeg_size,
+        unsigned char *exif, unsigned exif_len);
 
 #endif /*  _INCLUDE_JPEGUTILS_HPP_ */
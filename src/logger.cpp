@@ -22,11 +22,58 @@
 #include "logger.hpp"
 #include <stdarg.h>
 #include <syslog.h>
+#include <atomic>
+#include <algorithm>
+
+#define LOG_MSG_SIZE        1024    /* Size of a formatted message */
+#define LOG_RING_SLOTS      64      /* Messages a thread can have waiting for the writer */
+
+/* Formatted message waiting for the writer thread */
+struct ctx_log_item {
+    uint64_t    seq;            /* Order of the message across all the threads */
+    int         level;
+    int         timelen;
+    int         prefixlen;
+    char        msg[LOG_MSG_SIZE];
+};
+
+/* Ring of messages with one producing thread and the writer as consumer */
+struct ctx_log_ring {
+    std::atomic<uint32_t>   head;       /* Next slot to fill.  Only the owner moves it */
+    std::atomic<uint32_t>   tail;       /* Next slot to write.  Only the writer moves it */
+    std::atomic<bool>       in_use;     /* Ring is owned by a running thread */
+    std::atomic<bool>       busy;       /* Owner is putting a message in the ring */
+    std::atomic<uint64_t>   drop_cnt;   /* Messages lost with a full ring */
+    uint64_t                drop_rpt;   /* drop_cnt already reported by the writer */
+    ctx_log_ring            *next;
+    ctx_log_item            items[LOG_RING_SLOTS];
+};
+
+/* Releases the ring of a thread when the thread ends so another thread can use it */
+struct ctx_log_tls {
+    ctx_log_ring    *ring;
+    ~ctx_log_tls()
+    {
+        if (ring != NULL) {
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
 
 static int log_mode = LOGMODE_SYSLOG;
 static FILE *logfile  = NULL;
-static int log_level = LEVEL_DEFAULT;
-static int log_type = TYPE_DEFAULT;
+static std::atomic<int> log_level(LEVEL_DEFAULT);
+static std::atomic<int> log_type(TYPE_DEFAULT);
+
+static std::atomic<ctx_log_ring *> log_rings(NULL);
+static std::atomic<uint64_t> log_seq(0);
+static std::atomic<bool> log_async(false);
+static thread_local ctx_log_tls log_tls = {NULL};
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t log_thread_id;
+static volatile bool log_thread_running = false;
+static volatile bool log_closing = false;
 
 static const char *log_type_str[]  = {NULL, "COR", "STR", "ENC", "NET", "DBS", "EVT", "TRK", "VID", "ALL"};
 static const char *log_level_str[] = {NULL, "EMG", "ALR", "CRT", "ERR", "WRN", "NTC", "INF", "DBG", "ALL"};
@@ -51,7 +98,7 @@ static int log_get_type(const char *type)
 void log_set_type(const char *new_logtype)
 {
 
-    if ( mystreq(new_logtype, log_type_str[log_type]) ) {
+    if ( mystreq(new_logtype, log_type_str[log_type.load()]) ) {
         return;
     }
 
@@ -106,42 +153,275 @@ static void log_set_logfile(const char *logfile_name)
     return;
 }
 
-/** Return string with human readable time */
-static char *str_time(void)
+/* Send a line to the log.  With a batch the file and stderr output is collected */
+static void log_emit(int level, char *line, std::string *batch)
+{
+    switch (log_mode) {
+    case LOGMODE_FILE:
+        if (batch != NULL) {
+            batch->append(line);
+            batch->append("\n");
+        } else {
+            fputs(line, logfile);
+            fputs("\n", logfile);
+            fflush(logfile);
+        }
+        break;
+
+    case LOGMODE_SYSLOG:
+        /* The syslog level values are one less than the motion numeric values*/
+        syslog(level-1, "%s", line);
+        if (batch != NULL) {
+            batch->append(line);
+            batch->append("\n");
+        } else {
+            fputs(line, stderr);
+            fputs("\n", stderr);
+            fflush(stderr);
+        }
+        break;
+    }
+}
+
+/* Write a message unless it repeats the previous one.  Only one thread at a time */
+static void log_flood(int level, char *buf, int timelen, int prefixlen, std::string *batch)
+{
+    static int flood_cnt = 0;
+    static char flood_msg[LOG_MSG_SIZE];
+    static char prefix_msg[512];
+    char flood_repeats[LOG_MSG_SIZE];
+
+    if ((mystreq(&buf[timelen], flood_msg)) && (flood_cnt <= 5000)) {
+        flood_cnt++;
+    } else {
+        if (flood_cnt > 1) {
+            snprintf(flood_repeats, LOG_MSG_SIZE
+                , "%s Above message repeats %d times"
+                , prefix_msg, flood_cnt-1);
+            log_emit(level, flood_repeats, batch);
+        }
+        flood_cnt = 1;
+        snprintf(flood_msg, LOG_MSG_SIZE, "%s", &buf[timelen]);
+        snprintf(prefix_msg, (size_t)std::min(prefixlen, 512), "%s", buf);
+        log_emit(level, buf, batch);
+    }
+}
+
+/* Ring of the calling thread.  A ring released by an ended thread is reused */
+static ctx_log_ring *log_ring_get(void)
+{
+    ctx_log_ring *ring;
+    bool expect;
+
+    if (log_tls.ring != NULL) {
+        return log_tls.ring;
+    }
+
+    for (ring = log_rings.load(std::memory_order_acquire); ring != NULL; ring = ring->next) {
+        expect = false;
+        if (ring->in_use.compare_exchange_strong(expect, true
+                , std::memory_order_acquire)) {
+            log_tls.ring = ring;
+            return ring;
+        }
+    }
+
+    ring = new ctx_log_ring;
+    ring->head.store(0);
+    ring->tail.store(0);
+    ring->in_use.store(true);
+    ring->busy.store(false);
+    ring->drop_cnt.store(0);
+    ring->drop_rpt = 0;
+    ring->next = log_rings.load(std::memory_order_relaxed);
+    while (log_rings.compare_exchange_weak(ring->next, ring
+            , std::memory_order_release, std::memory_order_relaxed) == false) {
+    }
+    log_tls.ring = ring;
+
+    return ring;
+}
+
+/* Hand a formatted message to the writer thread.  The message is dropped
+ * rather than waiting when the ring of the thread is full.  Returns false
+ * when the writer is stopping and the message must be written directly.
+*/
+static bool log_put(int level, char *buf, int timelen, int prefixlen)
+{
+    ctx_log_ring *ring;
+    ctx_log_item *item;
+    uint32_t head;
+
+    ring = log_ring_get();
+
+    /* Paired with log_thread_stop.  Either the stop is seen here or the
+     * stop waits for busy to clear before the writer does its last drain.
+     */
+    ring->busy.store(true);
+    if (log_async.load() == false) {
+        ring->busy.store(false, std::memory_order_release);
+        return false;
+    }
+
+    head = ring->head.load(std::memory_order_relaxed);
+    if ((head - ring->tail.load(std::memory_order_acquire)) >= LOG_RING_SLOTS) {
+        ring->drop_cnt.fetch_add(1, std::memory_order_relaxed);
+        ring->busy.store(false, std::memory_order_release);
+        return true;
+    }
+
+    item = &ring->items[head % LOG_RING_SLOTS];
+    item->seq = log_seq.fetch_add(1, std::memory_order_relaxed);
+    item->level = level;
+    item->timelen = timelen;
+    item->prefixlen = prefixlen;
+    snprintf(item->msg, LOG_MSG_SIZE, "%s", buf);
+    ring->head.store(head + 1, std::memory_order_release);
+    ring->busy.store(false, std::memory_order_release);
+
+    /* The writer also wakes on its own so a busy mutex is not waited on */
+    if (pthread_mutex_trylock(&log_mutex) == 0) {
+        pthread_cond_signal(&log_cond);
+        pthread_mutex_unlock(&log_mutex);
+    }
+
+    return true;
+}
+
+/* Determine whether any thread is still putting a message in its ring */
+static bool log_put_busy(void)
 {
-    static char buffer[16];
-    time_t now = 0;
+    ctx_log_ring *ring;
+
+    for (ring = log_rings.load(std::memory_order_acquire); ring != NULL; ring = ring->next) {
+        if (ring->busy.load()) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    now = time(0);
-    strftime(buffer, 16, "%b %d %H:%M:%S", localtime(&now));
-    return buffer;
+static bool log_item_cmp(const ctx_log_item *item1, const ctx_log_item *item2)
+{
+    return (item1->seq < item2->seq);
+}
+
+/* Write all the waiting messages of all the threads in order with one write */
+static void log_drain(std::vector<ctx_log_item *> &items, std::string &batch)
+{
+    ctx_log_ring *ring;
+    uint32_t tail, head;
+    uint64_t drop_cnt, drop_new;
+    char drop_msg[LOG_MSG_SIZE];
+    size_t indx;
+
+    items.clear();
+    batch.clear();
+    drop_cnt = 0;
+
+    for (ring = log_rings.load(std::memory_order_acquire); ring != NULL; ring = ring->next) {
+        tail = ring->tail.load(std::memory_order_relaxed);
+        head = ring->head.load(std::memory_order_acquire);
+        while (tail != head) {
+            items.push_back(&ring->items[tail % LOG_RING_SLOTS]);
+            tail++;
+        }
+        drop_new = ring->drop_cnt.load(std::memory_order_relaxed);
+        drop_cnt += (drop_new - ring->drop_rpt);
+        ring->drop_rpt = drop_new;
+    }
+
+    std::sort(items.begin(), items.end(), log_item_cmp);
+    for (indx = 0; indx < items.size(); indx++) {
+        log_flood(items[indx]->level, items[indx]->msg
+            , items[indx]->timelen, items[indx]->prefixlen, &batch);
+    }
+    if (drop_cnt > 0) {
+        snprintf(drop_msg, LOG_MSG_SIZE, "[%s][%s] %llu log messages dropped"
+            , log_level_str[WRN], log_type_str[TYPE_ALL], (unsigned long long)drop_cnt);
+        log_emit(WRN, drop_msg, &batch);
+    }
+
+    if (batch.length() > 0) {
+        if (log_mode == LOGMODE_FILE) {
+            fwrite(batch.c_str(), 1, batch.length(), logfile);
+            fflush(logfile);
+        } else if (log_mode == LOGMODE_SYSLOG) {
+            fwrite(batch.c_str(), 1, batch.length(), stderr);
+            fflush(stderr);
+        }
+    }
+
+    /* Release the slots only once the messages are written */
+    for (ring = log_rings.load(std::memory_order_acquire); ring != NULL; ring = ring->next) {
+        tail = ring->tail.load(std::memory_order_relaxed);
+        for (indx = 0; indx < items.size(); indx++) {
+            if ((items[indx] >= &ring->items[0]) &&
+                (items[indx] < &ring->items[LOG_RING_SLOTS])) {
+                tail++;
+            }
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+}
+
+static void *log_handler(void *arg)
+{
+    std::vector<ctx_log_item *> items;
+    std::string batch;
+    struct timespec ts;
+
+    (void)arg;
+
+    mythreadname_set("lg", 0, NULL);
+
+    items.reserve(LOG_RING_SLOTS * 4);
+
+    while (log_closing == false) {
+        pthread_mutex_lock(&log_mutex);
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100000000L;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&log_cond, &log_mutex, &ts);
+        pthread_mutex_unlock(&log_mutex);
+        log_drain(items, batch);
+    }
+    log_drain(items, batch);
+
+    log_thread_running = false;
+
+    pthread_exit(NULL);
 }
 
 /**
  *    This routine is used for printing all informational, debug or error
  *    messages produced by any of the other motion functions.
+ *    Once the writer thread is started the message is only formatted on
+ *    the calling thread and is written by the writer thread.
  */
 void motpls_log(int level, int type, int errno_flag,int fncname, const char *fmt, ...)
 {
     int errno_save, n, prefixlen, timelen;
-    char buf[1024]= {0};
-    char usrfmt[1024]= {0};
+    char buf[LOG_MSG_SIZE]= {0};
+    char usrfmt[LOG_MSG_SIZE]= {0};
     char msg_buf[100]= {0};
+    char timebuf[16];
+    time_t now;
+    struct tm now_tm;
 
     va_list ap;
     unsigned long threadnr;
 
-    static int flood_cnt = 0;
-    static char flood_msg[1024];
-    static char prefix_msg[512];
-    char flood_repeats[1024];
     char threadname[32];
     int  applvl, apptyp;
 
-    pthread_mutex_lock(&log_motapp->mutex_parms);
-        applvl = log_level;
-        apptyp = log_type;
-    pthread_mutex_unlock(&log_motapp->mutex_parms);
+    errno_save = errno;
+
+    applvl = log_level.load(std::memory_order_relaxed);
+    apptyp = log_type.load(std::memory_order_relaxed);
 
     /*Exit if not our level or type */
     if (level > applvl) {
@@ -155,12 +435,14 @@ void motpls_log(int level, int type, int errno_flag,int fncname, const char *fmt
 
     snprintf(buf, sizeof(buf), "%s","");
     n = 0;
-    errno_save = errno;
     mythreadname_get(threadname);
 
     if (log_mode == LOGMODE_FILE) {
+        now = time(NULL);
+        localtime_r(&now, &now_tm);
+        strftime(timebuf, sizeof(timebuf), "%b %d %H:%M:%S", &now_tm);
         n = snprintf(buf, sizeof(buf), "%s [%s][%s][%02ld:%s] "
-            , str_time(), log_level_str[level], log_type_str[type]
+            , timebuf, log_level_str[level], log_type_str[type]
             , threadnr, threadname );
         timelen = 16;
     } else {
@@ -185,20 +467,20 @@ void motpls_log(int level, int type, int errno_flag,int fncname, const char *fmt
     va_start(ap, fmt);
     n += vsnprintf(buf + n, sizeof(buf) - n, usrfmt, ap);
     va_end(ap);
-    buf[1023] = '\0';
+    buf[LOG_MSG_SIZE - 1] = '\0';
 
     /* If errno_flag is set, add on the library error message. */
     if (errno_flag) {
       size_t buf_len = strlen(buf);
 
       // just knock off 10 characters if we're that close...
-      if (buf_len + 10 > 1024) {
-          buf[1024 - 10] = '\0';
-          buf_len = 1024 - 10;
+      if (buf_len + 10 > LOG_MSG_SIZE) {
+          buf[LOG_MSG_SIZE - 10] = '\0';
+          buf_len = LOG_MSG_SIZE - 10;
       }
 
-      strncat(buf, ": ", 1024 - buf_len);
-      n += 2;
+      strncat(buf, ": ", LOG_MSG_SIZE - buf_len);
+      n = (int)buf_len + 2;
         /*
          * This is bad - apparently gcc/libc wants to use the non-standard GNU
          * version of strerror_r, which doesn't actually put the message into
@@ -210,53 +492,81 @@ void motpls_log(int level, int type, int errno_flag,int fncname, const char *fmt
             (void)msg_buf;
         #else
             /* GNU-specific strerror_r() */
-            strncat(buf, strerror_r(errno_save, msg_buf, sizeof(msg_buf)), 1024 - strlen(buf));
+            strncat(buf, strerror_r(errno_save, msg_buf, sizeof(msg_buf)), LOG_MSG_SIZE - strlen(buf));
         #endif
     }
 
-    if ((mystreq(&buf[timelen], flood_msg)) && (flood_cnt <= 5000)) {
-        flood_cnt++;
-    } else {
-        if (flood_cnt > 1) {
-            snprintf(flood_repeats, 1024
-                , "%s Above message repeats %d times"
-                , prefix_msg, flood_cnt-1);
-            switch (log_mode) {
-            case LOGMODE_FILE:
-                strncat(flood_repeats, "\n", 1024 - strlen(flood_repeats));
-                fputs(flood_repeats, logfile);
-                fflush(logfile);
-                break;
-
-            case LOGMODE_SYSLOG:
-                /* The syslog level values are one less than the motion numeric values*/
-                syslog(level-1, "%s", flood_repeats);
-                strncat(flood_repeats, "\n", 1024 - strlen(flood_repeats));
-                fputs(flood_repeats, stderr);
-                fflush(stderr);
-                break;
-            }
-        }
-        flood_cnt = 1;
-        snprintf(flood_msg, 1024, "%s", &buf[timelen]);
-        snprintf(prefix_msg, prefixlen, "%s", buf);
-        switch (log_mode) {
-        case LOGMODE_FILE:
-            strncat(buf, "\n", 1024 - strlen(buf));
-            fputs(buf, logfile);
-            fflush(logfile);
-            break;
+    if ((log_async.load(std::memory_order_acquire) == false) ||
+        (log_put(level, buf, timelen, prefixlen) == false)) {
+        log_flood(level, buf, timelen, prefixlen, NULL);
+    }
 
-        case LOGMODE_SYSLOG:
-            /* The syslog level values are one less than the motion numeric values*/
-            syslog(level-1, "%s", buf);
-            strncat(buf, "\n", 1024 - strlen(buf));
-            fputs(buf, stderr);
-            fflush(stderr);
-            break;
-        }
+}
+
+/* Start the thread that writes the log.  Called once MotionPlus no longer forks */
+void log_thread_start(void)
+{
+    pthread_attr_t thread_attr;
+    int retcd;
+
+    if ((log_thread_running) || (log_mode == LOGMODE_NONE)) {
+        return;
+    }
+
+    log_closing = false;
+    log_thread_running = true;
+
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    retcd = pthread_create(&log_thread_id, &thread_attr, &log_handler, NULL);
+    pthread_attr_destroy(&thread_attr);
+    if (retcd != 0) {
+        log_thread_running = false;
+        MOTPLS_LOG(ERR, TYPE_ALL, SHOW_ERRNO
+            , _("Unable to start log thread.  Messages will be written directly"));
+        return;
     }
 
+    log_async.store(true, std::memory_order_release);
+}
+
+/* Write the waiting messages and return to writing on the calling thread.
+ * Returns false when the thread has not exited.
+ */
+static bool log_thread_stop(void)
+{
+    int waitcnt;
+
+    if (log_thread_running == false) {
+        return true;
+    }
+
+    log_async.store(false);
+
+    /* Messages being put in a ring now are written by the last drain */
+    waitcnt = 0;
+    while ((log_put_busy()) && (waitcnt < 1000)) {
+        SLEEP(0,1000000)
+        waitcnt++;
+    }
+
+    pthread_mutex_lock(&log_mutex);
+        log_closing = true;
+        pthread_cond_signal(&log_cond);
+    pthread_mutex_unlock(&log_mutex);
+
+    waitcnt = 0;
+    while ((log_thread_running) && (waitcnt < 1000)) {
+        SLEEP(0,1000000)
+        waitcnt++;
+    }
+    if (waitcnt == 1000) {
+        MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
+            ,_("Graceful shutdown of log thread failed"));
+        return false;
+    }
+
+    return true;
 }
 
 void log_init(ctx_motapp *motapp)
@@ -310,6 +620,15 @@ void log_init(ctx_motapp *motapp)
 
 void log_deinit(ctx_motapp *motapp)
 {
+    if (log_thread_stop() == false) {
+        /* The thread may still be writing so the file is left open */
+        if (logfile != NULL) {
+            MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
+                , _("Leaving logfile (%s) open.")
+                , motapp->conf->log_file.c_str());
+        }
+        return;
+    }
 
     if (logfile != NULL) {
         MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO
@@ -61,5 +61,6 @@
     void log_set_level(int new_level);
     void log_set_type(const char *new_logtype);
     void log_init_app(ctx_motapp *motapp);
+    void log_thread_start(void);
 
 #endif /* _INCLUDE_LOGGER_HPP_ */
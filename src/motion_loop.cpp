@@ -35,6 +35,9 @@
 #include "dbse.hpp"
 #include "draw.hpp"
 #include "webu_stream.hpp"
+#include "pic_writer.hpp"
+#include "precap.hpp"
+#include "trace.hpp"
 
 namespace {
 
@@ -54,21 +57,30 @@ static void mlp_ring_resize(ctx_dev *cam)
 
     tmp =(ctx_image_data*) mymalloc(new_size * sizeof(ctx_image_data));
 
+    cam->imgs.image_ring = tmp;
+    cam->current_image = NULL;
+    cam->imgs.ring_size = new_size;
+    cam->imgs.ring_in = 0;
+    cam->imgs.ring_out = 0;
+
+    /* The compressed ring attaches shared images to the items as needed.
+     * When it is not used or could not be started each item gets its own.
+     */
+    precap_init(cam);
+    if (cam->precap != NULL) {
+        return;
+    }
+
     for(i = 0; i < new_size; i++) {
         tmp[i].image_norm =(unsigned char*) mymalloc(cam->imgs.size_norm);
         memset(tmp[i].image_norm, 0x80, cam->imgs.size_norm);
+        tmp[i].image_high = NULL;
         if (cam->imgs.size_high > 0) {
             tmp[i].image_high =(unsigned char*) mymalloc(cam->imgs.size_high);
             memset(tmp[i].image_high, 0x80, cam->imgs.size_high);
         }
     }
 
-    cam->imgs.image_ring = tmp;
-    cam->current_image = NULL;
-    cam->imgs.ring_size = new_size;
-    cam->imgs.ring_in = 0;
-    cam->imgs.ring_out = 0;
-
 }
 
 /* Clean image ring */
@@ -80,6 +92,8 @@ static void mlp_ring_destroy(ctx_dev *cam)
         return;
     }
 
+    precap_deinit(cam);
+
     for (i = 0; i < cam->imgs.ring_size; i++) {
         myfree(&cam->imgs.image_ring[i].image_norm);
         myfree(&cam->imgs.image_ring[i].image_high);
@@ -131,6 +145,8 @@ static void mlp_ring_process(ctx_dev *cam)
             break;
         }
 
+        precap_load(cam, cam->imgs.ring_out);
+
         cam->current_image = &cam->imgs.image_ring[cam->imgs.ring_out];
 
         if (cam->imgs.image_ring[cam->imgs.ring_out].shot < cam->conf->framerate) {
@@ -158,6 +174,8 @@ static void mlp_ring_process(ctx_dev *cam)
             }
         }
 
+        precap_done(cam, cam->imgs.ring_out);
+
         if (++cam->imgs.ring_out >= cam->imgs.ring_size) {
             cam->imgs.ring_out = 0;
         }
@@ -262,7 +280,7 @@ static void mlp_detected(ctx_dev *cam, ctx_image_data *img)
         if (conf->stream_motion && !cam->motapp->conf->setup_mode && img->shot != 1) {
             cam->event(EVENT_STREAM, img, NULL, NULL, &img->imgts);
         }
-        if (conf->picture_output_motion != "off") {
+        if (cam->picture_output_motion != PICMOT_OFF) {
             cam->event(EVENT_IMAGEM_DETECTED, NULL, NULL, NULL, &img->imgts);
         }
     }
@@ -449,6 +467,9 @@ static void mlp_init_firstimage(ctx_dev *cam)
         }
         MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO, "%s", msg);
         for (indx = 0; indx<cam->imgs.ring_size; indx++) {
+            if (cam->imgs.image_ring[indx].image_norm == NULL) {
+                continue;
+            }
             memset(cam->imgs.image_ring[indx].image_norm
                 , 0x80, cam->imgs.size_norm);
             draw_text(cam->imgs.image_ring[indx].image_norm
@@ -610,12 +631,25 @@ void mlp_cleanup(ctx_dev *cam)
             cam->event(EVENT_IMAGE_PREVIEW, NULL, NULL, NULL, &cam->current_image->imgts);
             cam->imgs.image_preview.diffs = 0;
         }
+    }
+
+    picwrt_flush(cam);
+
+    if (cam->event_nr == cam->prev_event) {
         cam->event(EVENT_END, NULL, NULL, NULL, &cam->current_image->imgts);
         cam->dbse_exec(NULL, 0, &cam->current_image->imgts, "event_end");
     }
 
+    cam->event(EVENT_SEGMENT_END, NULL, NULL, NULL, &cam->current_image->imgts);
+
+    cam->movie_standby_deinit();
+
     webu_stream_deinit(cam);
 
+    pic_cache_deinit(cam);
+
+    pic_scale_deinit(cam);
+
     cam->algsec_deinit();
 
     if (cam->device_status == STATUS_OPENED) {
@@ -646,15 +680,7 @@ void mlp_cleanup(ctx_dev *cam)
 
     rotate_deinit(cam); /* cleanup image rotation data */
 
-    if (cam->pipe != -1) {
-        close(cam->pipe);
-        cam->pipe = -1;
-    }
-
-    if (cam->mpipe != -1) {
-        close(cam->mpipe);
-        cam->mpipe = -1;
-    }
+    vlp_deinit(cam); /* Close the video loopback devices */
 
 }
 
@@ -686,10 +712,15 @@ static void mlp_init(ctx_dev *cam)
 
     webu_stream_init(cam);
 
+    pic_cache_init(cam);
+
     cam->algsec_init();
 
     rotate_init(cam);
 
+    /* Sized from the output dimensions which rotate_init may swap */
+    pic_scale_init(cam);
+
     draw_init_scale(cam);
 
     mlp_init_firstimage(cam);
@@ -753,10 +784,6 @@ static void mlp_prepare(ctx_dev *cam)
     cam->frame_last_ts.tv_nsec = cam->frame_curr_ts.tv_nsec;
     clock_gettime(CLOCK_MONOTONIC, &cam->frame_curr_ts);
 
-    if (cam->conf->pre_capture < 0) {
-        cam->conf->pre_capture = 0;
-    }
-
     if (cam->frame_last_ts.tv_sec != cam->frame_curr_ts.tv_sec) {
         cam->lastrate = cam->shots + 1;
         cam->shots = -1;
@@ -772,6 +799,10 @@ static void mlp_prepare(ctx_dev *cam)
 /* reset the images */
 static void mlp_resetimages(ctx_dev *cam)
 {
+    int indx_prev;
+
+    indx_prev = cam->imgs.ring_in;
+
     /* ring_buffer_in is pointing to current pos, update before put in a new image */
     if (++cam->imgs.ring_in >= cam->imgs.ring_size) {
         cam->imgs.ring_in = 0;
@@ -784,6 +815,13 @@ static void mlp_resetimages(ctx_dev *cam)
         }
     }
 
+    /* Compress the prior image and get an uncompressed one for the new frame */
+    precap_next(cam, indx_prev);
+
+    /* Jpeg and scaled images from the prior frame are no longer valid */
+    pic_cache_reset(cam);
+    pic_scale_reset(cam);
+
     cam->current_image = &cam->imgs.image_ring[cam->imgs.ring_in];
     cam->current_image->diffs = 0;
     cam->current_image->flags = 0;
@@ -801,7 +839,7 @@ static void mlp_resetimages(ctx_dev *cam)
 /* Try to reconnect to camera */
 static void mlp_retry(ctx_dev *cam)
 {
-    int size_high;
+    int size_high, width, height;
 
     if ((cam->device_status == STATUS_CLOSED) &&
         (cam->frame_curr_ts.tv_sec % 10 == 0) &&
@@ -809,11 +847,15 @@ static void mlp_retry(ctx_dev *cam)
         MOTPLS_LOG(WRN, TYPE_ALL, NO_ERRNO
             ,_("Retrying until successful connection with camera"));
 
+        /* Size the image buffers were allocated for */
+        width = cam->imgs.width;
+        height = cam->imgs.height;
+
         mlp_cam_start(cam);
 
         mlp_check_szimg(cam);
 
-        if (cam->imgs.width != cam->conf->width || cam->imgs.height != cam->conf->height) {
+        if ((cam->imgs.width != width) || (cam->imgs.height != height)) {
             MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO,_("Resetting image buffers"));
             cam->device_status = STATUS_RESET;
         }
@@ -906,6 +948,7 @@ static void mlp_detection(ctx_dev *cam)
     if (cam->frame_skip) {
         cam->frame_skip--;
         cam->current_image->diffs = 0;
+        trace_flag(cam, TRACE_FLAG_SKIP);
         return;
     }
 
@@ -957,7 +1000,7 @@ static void mlp_overlay(ctx_dev *cam)
     char tmp[PATH_MAX];
 
     if (cam->smartmask_speed &&
-        ((cam->conf->picture_output_motion != "off") ||
+        ((cam->picture_output_motion != PICMOT_OFF) ||
         cam->conf->movie_output_motion ||
         cam->motapp->conf->setup_mode ||
         (cam->stream.motion.cnct_count > 0))) {
@@ -965,7 +1008,7 @@ static void mlp_overlay(ctx_dev *cam)
     }
 
     if (cam->imgs.largest_label &&
-        ((cam->conf->picture_output_motion != "off") ||
+        ((cam->picture_output_motion != PICMOT_OFF) ||
         cam->conf->movie_output_motion ||
         cam->motapp->conf->setup_mode ||
         (cam->stream.motion.cnct_count > 0))) {
@@ -973,7 +1016,7 @@ static void mlp_overlay(ctx_dev *cam)
     }
 
     if (cam->imgs.mask &&
-        ((cam->conf->picture_output_motion != "off") ||
+        ((cam->picture_output_motion != PICMOT_OFF) ||
         cam->conf->movie_output_motion ||
         cam->motapp->conf->setup_mode ||
         (cam->stream.motion.cnct_count > 0))) {
@@ -1103,6 +1146,8 @@ static void mlp_actions_event(ctx_dev *cam)
                 cam->event(EVENT_IMAGE_PREVIEW, NULL, NULL, NULL, &cam->current_image->imgts);
                 cam->imgs.image_preview.diffs = 0;
             }
+            /* The pictures of the event must be written before the end actions */
+            picwrt_flush(cam);
             cam->event(EVENT_END, NULL, NULL, NULL, &cam->current_image->imgts);
             cam->dbse_exec(NULL, 0, &cam->current_image->imgts, "event_end");
 
@@ -1136,6 +1181,9 @@ static void mlp_actions_event(ctx_dev *cam)
         cam->event(EVENT_MOVIE_START, NULL, NULL, NULL, &cam->current_image->imgts);
     }
 
+    /* Prepare the encoder for the next event while no movie is open */
+    cam->movie_standby_update();
+
 }
 
 static void mlp_actions(ctx_dev *cam)
@@ -1240,6 +1288,17 @@ static void mlp_snapshot(ctx_dev *cam)
     }
 }
 
+/* Write the image to the continuous recording */
+static void mlp_segment(ctx_dev *cam)
+{
+    if ((cam->conf->movie_output) && (cam->conf->movie_segment > 0)) {
+        cam->event(EVENT_SEGMENT_PUT, cam->current_image, NULL
+            , NULL, &cam->current_image->imgts);
+    } else if ((cam->movie_norm != NULL) && (cam->movie_norm->segment)) {
+        cam->event(EVENT_SEGMENT_END, NULL, NULL, NULL, &cam->current_image->imgts);
+    }
+}
+
 /* Create timelapse video*/
 static void mlp_timelapse(ctx_dev *cam)
 {
@@ -1252,21 +1311,21 @@ static void mlp_timelapse(ctx_dev *cam)
             (cam->frame_curr_ts.tv_sec % 60 < cam->frame_last_ts.tv_sec % 60) &&
             cam->shots == 0) {
 
-            if (cam->conf->timelapse_mode == "daily") {
+            if (cam->timelapse_mode == TLAPSE_DAILY) {
                 if (timestamp_tm.tm_hour == 0) {
                     cam->event(EVENT_TLAPSE_END, NULL, NULL, NULL, &cam->current_image->imgts);
                 }
-            } else if (cam->conf->timelapse_mode == "hourly") {
+            } else if (cam->timelapse_mode == TLAPSE_HOURLY) {
                 cam->event(EVENT_TLAPSE_END, NULL, NULL, NULL, &cam->current_image->imgts);
-            } else if (cam->conf->timelapse_mode == "weekly-sunday") {
+            } else if (cam->timelapse_mode == TLAPSE_SUNDAY) {
                 if (timestamp_tm.tm_wday == 0 && timestamp_tm.tm_hour == 0) {
                     cam->event(EVENT_TLAPSE_END, NULL, NULL, NULL, &cam->current_image->imgts);
                 }
-            } else if (cam->conf->timelapse_mode == "weekly-monday") {
+            } else if (cam->timelapse_mode == TLAPSE_MONDAY) {
                 if (timestamp_tm.tm_wday == 1 && timestamp_tm.tm_hour == 0) {
                     cam->event(EVENT_TLAPSE_END, NULL, NULL, NULL, &cam->current_image->imgts);
                 }
-            } else if (cam->conf->timelapse_mode == "monthly") {
+            } else if (cam->timelapse_mode == TLAPSE_MONTHLY) {
                 if (timestamp_tm.tm_mday == 1 && timestamp_tm.tm_hour == 0) {
                     cam->event(EVENT_TLAPSE_END, NULL, NULL, NULL, &cam->current_image->imgts);
                 }
@@ -1294,27 +1353,34 @@ static void mlp_timelapse(ctx_dev *cam)
 static void mlp_loopback(ctx_dev *cam)
 {
     if (cam->motapp->conf->setup_mode) {
-        cam->event(EVENT_IMAGE, &cam->imgs.image_motion, NULL, &cam->pipe, &cam->current_image->imgts);
+        cam->event(EVENT_IMAGE, &cam->imgs.image_motion, NULL, cam->pipe, &cam->current_image->imgts);
         cam->event(EVENT_STREAM, &cam->imgs.image_motion, NULL, NULL, &cam->current_image->imgts);
     } else {
-        cam->event(EVENT_IMAGE, cam->current_image, NULL, &cam->pipe, &cam->current_image->imgts);
+        cam->event(EVENT_IMAGE, cam->current_image, NULL, cam->pipe, &cam->current_image->imgts);
 
         if (!cam->conf->stream_motion || cam->shots == 0) {
             cam->event(EVENT_STREAM, cam->current_image, NULL, NULL, &cam->current_image->imgts);
         }
     }
 
-    cam->event(EVENT_IMAGEM, &cam->imgs.image_motion, NULL, &cam->mpipe, &cam->current_image->imgts);
+    cam->event(EVENT_IMAGEM, &cam->imgs.image_motion, NULL, cam->mpipe, &cam->current_image->imgts);
 }
 
 /* Update parameters from web interface*/
-static void mlp_parmsupdate(ctx_dev *cam)
+/* Take the configuration published by the webcontrol.  Only the
+ * pointer is checked unless there is a new snapshot.
+ */
+static void mlp_conf_update(ctx_dev *cam)
 {
-    /* Check for some config parameter changes but only every second */
-    if (cam->shots != 0) {
-        return;
+    if (conf_snapshot_load(cam)) {
+        MOTPLS_LOG(INF, TYPE_ALL, NO_ERRNO, _("Configuration updated"));
+        cam->parms_changed = true;
     }
+}
 
+/* Convert the configuration strings used on each frame */
+static void mlp_parmsupdate(ctx_dev *cam)
+{
     if (cam->parms_changed  || (cam->passflag == false)) {
         draw_init_scale(cam);  /* Initialize and validate text_scale */
 
@@ -1350,6 +1416,28 @@ static void mlp_parmsupdate(ctx_dev *cam)
             cam->locate_motion_style = LOCATE_BOX;
         }
 
+        if (cam->conf->picture_output_motion == "on") {
+            cam->picture_output_motion = PICMOT_ON;
+        } else if (cam->conf->picture_output_motion == "roi") {
+            cam->picture_output_motion = PICMOT_ROI;
+        } else {
+            cam->picture_output_motion = PICMOT_OFF;
+        }
+
+        if (cam->conf->timelapse_mode == "hourly") {
+            cam->timelapse_mode = TLAPSE_HOURLY;
+        } else if (cam->conf->timelapse_mode == "daily") {
+            cam->timelapse_mode = TLAPSE_DAILY;
+        } else if (cam->conf->timelapse_mode == "weekly-sunday") {
+            cam->timelapse_mode = TLAPSE_SUNDAY;
+        } else if (cam->conf->timelapse_mode == "weekly-monday") {
+            cam->timelapse_mode = TLAPSE_MONDAY;
+        } else if (cam->conf->timelapse_mode == "monthly") {
+            cam->timelapse_mode = TLAPSE_MONTHLY;
+        } else {
+            cam->timelapse_mode = TLAPSE_MANUAL;
+        }
+
         if (cam->conf->smart_mask_speed != cam->smartmask_speed ||
             cam->smartmask_lastrate != cam->lastrate) {
             if (cam->conf->smart_mask_speed == 0) {
@@ -1364,6 +1452,11 @@ static void mlp_parmsupdate(ctx_dev *cam)
         cam->parms_changed = false;
     }
 
+    /* Check for application parameter changes but only every second */
+    if (cam->shots != 0) {
+        return;
+    }
+
     if (cam->motapp->parms_changed) {
         log_set_level(cam->motapp->conf->log_level);
         log_set_type(cam->motapp->conf->log_type_str.c_str());
@@ -1433,22 +1526,37 @@ void *mlp_main(void *arg)
     cam->restart_dev = false;
     cam->device_status = STATUS_INIT;
 
+    trace_init(cam);
+
     while (cam->finish_dev == false) {
+        trace_start(cam);
+        mlp_conf_update(cam);
         mlp_init(cam);
         mlp_prepare(cam);
         mlp_resetimages(cam);
         mlp_retry(cam);
+        trace_mark(cam, TRACE_PREPARE);
         mlp_capture(cam);
+        trace_mark(cam, TRACE_CAPTURE);
         mlp_detection(cam);
+        trace_mark(cam, TRACE_DETECTION);
         mlp_tuning(cam);
+        trace_mark(cam, TRACE_TUNING);
         mlp_overlay(cam);
+        trace_mark(cam, TRACE_OVERLAY);
+        mlp_segment(cam);
         mlp_actions(cam);
+        trace_mark(cam, TRACE_ACTIONS);
         mlp_setupmode(cam);
         mlp_snapshot(cam);
         mlp_timelapse(cam);
+        picwrt_process(cam);
         mlp_loopback(cam);
+        trace_mark(cam, TRACE_OUTPUT);
         mlp_parmsupdate(cam);
         mlp_frametiming(cam);
+        trace_mark(cam, TRACE_TIMING);
+        trace_end(cam);
     }
 
     MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Exiting"));
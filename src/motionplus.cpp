@@ -29,6 +29,8 @@
 #include "movie.hpp"
 #include "netcam.hpp"
 #include "draw.hpp"
+#include "pic_writer.hpp"
+#include "trace.hpp"
 
 pthread_key_t tls_key_threadnr;
 volatile enum MOTPLS_SIGNAL motsignal;
@@ -55,6 +57,13 @@ static void motpls_signal_process(ctx_motapp *motapp)
             }
         }
         break;
+    case MOTPLS_SIGNAL_USR2:        /* Write the frame traces */
+        if (motapp->cam_list != NULL) {
+            for (indx=0; indx<motapp->cam_cnt; indx++) {
+                trace_write(motapp->cam_list[indx]);
+            }
+        }
+        break;
     case MOTPLS_SIGNAL_SIGHUP:      /* Restart the threads */
         motapp->restart_all = true;
         /*FALLTHROUGH*/
@@ -90,6 +99,9 @@ static void sig_handler(int signo)
     case SIGUSR1:
         motsignal = MOTPLS_SIGNAL_USR1;
         break;
+    case SIGUSR2:
+        motsignal = MOTPLS_SIGNAL_USR2;
+        break;
     case SIGHUP:
         motsignal = MOTPLS_SIGNAL_SIGHUP;
         break;
@@ -154,6 +166,7 @@ static void setup_signals(void)
     sigaction(SIGQUIT, &sig_handler_action, NULL);
     sigaction(SIGTERM, &sig_handler_action, NULL);
     sigaction(SIGUSR1, &sig_handler_action, NULL);
+    sigaction(SIGUSR2, &sig_handler_action, NULL);
 
     /* use SIGVTALRM as a way to break out of the ioctl, don't restart */
     sig_handler_action.sa_flags = 0;
@@ -263,6 +276,8 @@ static void motpls_shutdown(ctx_motapp *motapp)
 
     webu_deinit(motapp);
 
+    picwrt_deinit(motapp);
+
     motapp->dbse_deinit();
 
     motapp->conf_deinit();
@@ -411,6 +426,8 @@ static void motpls_startup(ctx_motapp *motapp, int daemonize)
         }
     }
 
+    log_thread_start();
+
     if (motapp->conf->setup_mode) {
         MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO,_("MotionPlus running in setup mode."));
     }
@@ -425,6 +442,8 @@ static void motpls_startup(ctx_motapp *motapp, int daemonize)
 
     motapp->dbse_init();
 
+    picwrt_init(motapp);
+
     draw_init_chars();
 
     webu_init(motapp);
@@ -507,6 +526,7 @@ static void motpls_watchdog(ctx_motapp *motapp, int camindx)
         pthread_mutex_unlock(&motapp->mutex_parms);
         pthread_mutex_unlock(&motapp->mutex_camlst);
         pthread_mutex_unlock(&motapp->mutex_post);
+        pthread_mutex_unlock(&motapp->mutex_evtidx);
         if (motapp->dbse != NULL) {
             pthread_mutex_unlock(&motapp->dbse->mutex_dbse);
         }
@@ -625,6 +645,7 @@ static void motpls_init(ctx_motapp *motapp, int argc, char *argv[])
 
     motapp->conf = new ctx_config;
     motapp->dbse = NULL;
+    motapp->picwrt = NULL;
 
     motapp->webcontrol_running = false;
     motapp->webcontrol_finish = false;
@@ -632,6 +653,9 @@ static void motpls_init(ctx_motapp *motapp, int argc, char *argv[])
     motapp->webcontrol_headers = NULL;
     motapp->webcontrol_actions = NULL;
     motapp->webcontrol_clients.clear();
+    motapp->webcontrol_pool = false;
+    motapp->webcontrol_waiting.clear();
+    motapp->webcontrol_wake_running = false;
     memset(motapp->webcontrol_digest_rand, 0, sizeof(motapp->webcontrol_digest_rand));
 
     pthread_key_create(&tls_key_threadnr, NULL);
@@ -641,6 +665,9 @@ static void motpls_init(ctx_motapp *motapp, int argc, char *argv[])
     pthread_mutex_init(&motapp->mutex_parms, NULL);
     pthread_mutex_init(&motapp->mutex_camlst, NULL);
     pthread_mutex_init(&motapp->mutex_post, NULL);
+    pthread_mutex_init(&motapp->mutex_evtidx, NULL);
+    pthread_mutex_init(&motapp->webcontrol_mutex, NULL);
+    pthread_cond_init(&motapp->webcontrol_cond, NULL);
 
 }
 
@@ -723,6 +750,8 @@ static void motpls_cam_delete(ctx_motapp *motapp)
     }
 
     pthread_mutex_lock(&motapp->mutex_camlst);
+        trace_deinit(motapp->cam_list[motapp->cam_delete]);
+        conf_snapshot_deinit(motapp->cam_list[motapp->cam_delete]);
         delete motapp->cam_list[motapp->cam_delete]->conf;
         delete motapp->cam_list[motapp->cam_delete];
         myfree(&motapp->cam_list);
@@ -834,6 +863,9 @@ int main (int argc, char **argv)
     pthread_mutex_destroy(&motapp->mutex_parms);
     pthread_mutex_destroy(&motapp->mutex_camlst);
     pthread_mutex_destroy(&motapp->mutex_post);
+    pthread_mutex_destroy(&motapp->mutex_evtidx);
+    pthread_mutex_destroy(&motapp->webcontrol_mutex);
+    pthread_cond_destroy(&motapp->webcontrol_cond);
 
     delete motapp->conf;
     delete motapp;
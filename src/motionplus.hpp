@@ -108,6 +108,11 @@ struct ctx_config;
 struct ctx_v4l2cam;
 struct ctx_webui;
 struct ctx_netcam;
+struct ctx_picwrt;
+struct ctx_precap;
+struct ctx_extpipe;
+struct ctx_trace;
+struct ctx_vlp;
 
 class cls_libcam;
 
@@ -145,6 +150,17 @@ class cls_libcam;
 #define LOCATE_NORMAL     1
 #define LOCATE_BOTH       2
 
+#define PICMOT_OFF        0
+#define PICMOT_ON         1
+#define PICMOT_ROI        2
+
+#define TLAPSE_MANUAL     0
+#define TLAPSE_HOURLY     1
+#define TLAPSE_DAILY      2
+#define TLAPSE_SUNDAY     3
+#define TLAPSE_MONDAY     4
+#define TLAPSE_MONTHLY    5
+
 #define UPDATE_REF_FRAME  1
 #define RESET_REF_FRAME   2
 
@@ -191,6 +207,7 @@ enum MOTPLS_SIGNAL {
     MOTPLS_SIGNAL_NONE,
     MOTPLS_SIGNAL_ALARM,
     MOTPLS_SIGNAL_USR1,
+    MOTPLS_SIGNAL_USR2,
     MOTPLS_SIGNAL_SIGHUP,
     MOTPLS_SIGNAL_SIGTERM
 };
@@ -268,7 +285,6 @@ struct ctx_images {
     unsigned char *smartmask;
     unsigned char *smartmask_final;
     unsigned char *common_buffer;
-    unsigned char *image_substream;
     unsigned char *image_virgin;            /* Last picture frame with no text or locate overlay */
     unsigned char *image_vprvcy;            /* Virgin image with the privacy mask applied */
     unsigned char *mask_privacy;            /* Buffer for the privacy mask values */
@@ -303,17 +319,66 @@ struct ctx_images {
 
 };
 
-struct ctx_stream_data {
-    unsigned char   *jpeg_data; /* Image compressed as JPG */
+/* One jpeg of a stream with its multipart header.  Once published it is not
+ * changed and it is shared by all the clients until the last one releases it.
+ */
+struct ctx_stream_frame {
+    int             refcnt;     /* References held.  Protected by the stream mutex */
+    unsigned char   *data;      /* Room for the header, the jpeg and the terminator */
+    int             alloc_size;
+    int             part_ofs;   /* Start of the multipart header in data */
+    int             part_size;  /* Bytes of header, jpeg and terminator */
     long            jpeg_size;  /* The number of bytes for jpg */
+};
+
+struct ctx_stream_data {
+    ctx_stream_frame *frame;    /* Latest image compressed as JPG */
+    volatile uint64_t seq;      /* Incremented for each frame published */
+    ctx_stream_frame *spare;    /* Released frame kept for reuse */
     int             cnct_count; /* Counter of the number of connections */
     int             consumed;   /* Bool for whether the jpeg data was consumed*/
 };
 
+#define PIC_CACHE_MAX     8
+
+/* A jpeg compressed from an image on the current frame.  No EXIF data is included */
+struct ctx_pic_cache_item {
+    unsigned char   *image;     /* Image buffer the jpeg was compressed from */
+    int             width;
+    int             height;
+    int             quality;
+    bool            grey;       /* Grey or color compression of the image */
+    unsigned char   *jpeg_data;
+    int             jpeg_size;
+    int             jpeg_alloc; /* Allocated size of jpeg_data */
+};
+
+struct ctx_pic_cache {
+    ctx_pic_cache_item  items[PIC_CACHE_MAX];
+    int                 item_cnt;   /* Number of items filled on the current frame */
+};
+
+#define PIC_SCALE_MAX     4
+
+/* Box filtered images at 1/2, 1/4, 1/8 and 1/16 of the image size */
+struct ctx_pic_scale {
+    unsigned char   *src;                   /* Image the levels were built from on the current frame */
+    int             level_cnt;              /* Number of levels built from src */
+    int             level_max;              /* Number of levels large enough to use */
+    unsigned char   *image[PIC_SCALE_MAX];
+    int             width[PIC_SCALE_MAX];
+    int             height[PIC_SCALE_MAX];
+};
+
 struct ctx_stream {
     pthread_mutex_t  mutex;
+    pthread_cond_t   cond_frame; /* Signaled when frames are published */
+    bool             sync_init;  /* The mutex and cond_frame are initialized */
+    bool             closing;    /* The streams are being shut down.  Protected by the mutex */
+    int              wait_cnt;   /* Clients waiting on cond_frame.  Protected by the mutex */
     ctx_stream_data  norm;       /* Copy of the image to use for web stream*/
     ctx_stream_data  sub;        /* Copy of the image to use for web stream*/
+    ctx_stream_data  thumb;      /* Copy of the image to use for web stream*/
     ctx_stream_data  motion;     /* Copy of the image to use for web stream*/
     ctx_stream_data  source;     /* Copy of the image to use for web stream*/
     ctx_stream_data  secondary;  /* Copy of the image to use for web stream*/
@@ -406,6 +471,8 @@ typedef enum {
     EVENT_MOVIE_START,
     EVENT_MOVIE_END,
     EVENT_SECDETECT,
+    EVENT_SEGMENT_PUT,
+    EVENT_SEGMENT_END,
     EVENT_LAST,
 } motion_event;
 
@@ -415,6 +482,9 @@ struct ctx_dev {
     pthread_t       thread_id;
 
     ctx_config      *conf;
+    ctx_config      *volatile conf_next;    /* Snapshot published by the webcontrol.  Uses parms_lock */
+    ctx_config      **conf_retired;         /* Replaced snapshots that other threads may still read */
+    int             conf_retired_cnt;
     ctx_images      imgs;
     ctx_netcam      *netcam;            /* this structure contains the context for normal RTSP connection */
     ctx_netcam      *netcam_high;       /* this structure contains the context for high resolution RTSP connection */
@@ -425,12 +495,18 @@ struct ctx_dev {
     ctx_movie       *movie_norm;
     ctx_movie       *movie_motion;
     ctx_movie       *movie_timelapse;
+    ctx_movie       *movie_standby;     /* Encoder prepared for the next movie */
     ctx_stream      stream;
+    ctx_pic_cache   pic_cache;          /* jpeg images compressed on the current frame */
+    ctx_pic_scale   pic_scale;          /* Scaled images of the current frame */
+    ctx_precap      *precap;            /* Compressed image ring when pre_capture_compress is set */
+    ctx_trace       *trace;             /* Timing and detection values of the recent frames */
 
     cls_libcam      *libcam;
 
     FILE                    *extpipe;
     int                     extpipe_open;
+    ctx_extpipe             *extpipe_writer;    /* Writer thread for the extpipe images */
     bool                    algsec_inuse;        /*Bool for whether we have secondary detection*/
     int                     track_posx;
     int                     track_posy;
@@ -440,6 +516,8 @@ struct ctx_dev {
     unsigned int            new_img;
     int                     locate_motion_mode;
     int                     locate_motion_style;
+    int                     picture_output_motion;
+    int                     timelapse_mode;
     int                     noise;
     int                     threshold;
     int                     threshold_maximum;
@@ -479,8 +557,8 @@ struct ctx_dev {
     int                     missing_frame_counter;               /* counts failed attempts to fetch picture frame from camera */
     unsigned int            lost_connection;
 
-    int                     pipe;
-    int                     mpipe;
+    ctx_vlp                 *pipe;
+    ctx_vlp                 *mpipe;
 
     char                    hostname[PATH_MAX];
     char                    action_user[40];
@@ -489,6 +567,13 @@ struct ctx_dev {
     char                    extpipefilename[PATH_MAX];
     char                    extpipecmdline[PATH_MAX];
     bool                    movie_passthrough;
+    time_t                  movie_standby_retry;        /* Time the standby encoder may next be prepared */
+    char                    segment_prev_nm[PATH_MAX];  /* Prior segment of the continuous recording */
+    struct timespec         segment_prev_ts;            /* Start time of the prior segment */
+    time_t                  segment_retry;              /* Time to retry opening a segment after an error */
+    struct timespec         segment_evt_ts;             /* Start time of the event in the segments */
+    char                    segment_evt_nm[PATH_MAX];   /* Segment holding the start of the event */
+    double                  segment_evt_ofs;            /* Seconds into the segment the event starts */
 
     int area_minx[9], area_miny[9], area_maxx[9], area_maxy[9];
     int                     areadetect_eventnbr;
@@ -539,6 +624,8 @@ struct ctx_dev {
     int movie_init_timelapse(timespec *ts1);
     int movie_init_norm(timespec *ts1);
     int movie_init_motion(timespec *ts1);
+    void movie_standby_update();
+    void movie_standby_deinit();
 };
 
 /*  ctx_motapp for whole motion application including all the cameras */
@@ -568,12 +655,19 @@ struct ctx_motapp {
     std::list<ctx_webu_clients> webcontrol_clients;         /* C++ list of client ips */
     ctx_params                  *webcontrol_headers;        /* parameters for header */
     ctx_params                  *webcontrol_actions;        /* parameters for actions */
+    bool                        webcontrol_pool;            /* Connections are served by a pool of threads */
+    std::list<ctx_webui *>      webcontrol_waiting;         /* Suspended stream connections */
+    pthread_mutex_t             webcontrol_mutex;           /* Lock for the suspended stream connections */
+    pthread_cond_t              webcontrol_cond;            /* Signaled when a camera publishes stream frames */
+    volatile bool               webcontrol_wake_running;
     ctx_dbse                    *dbse;                      /* user specified database */
+    ctx_picwrt                  *picwrt;                    /* picture writer threads */
 
     bool                parms_changed;      /*bool indicating if the parms have changed */
     pthread_mutex_t     mutex_parms;        /* mutex used to lock when changing parms */
     pthread_mutex_t     mutex_camlst;       /* Lock the list of cams while adding/removing */
     pthread_mutex_t     mutex_post;         /* mutex to allow for processing of post actions*/
+    pthread_mutex_t     mutex_evtidx;       /* Cameras sharing a target_dir append to the same events.csv */
 
     void conf_init();
     void conf_deinit();
@@ -584,6 +678,8 @@ struct ctx_motapp {
     void dbse_init();
     void dbse_deinit();
     void dbse_movies_getlist(int device_id);
+    void dbse_movies_load(int device_id);
+    std::string dbse_movies_fullnm(int device_id, std::string movie_nm);
 #if 0
     void dbse_init_motpls();
     void dbse_deinit_motpls();
@@ -41,6 +41,15 @@
 #include "netcam.hpp"
 #include "movie.hpp"
 
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+/* Write buffer for the timelapse file when appending */
+#define TIMELAPSE_BUF_SIZE  (1024 * 1024)
+
 namespace {
 
 static void movie_free_pkt(ctx_movie *movie)
@@ -90,22 +99,60 @@ static int movie_timelapse_exists(const char *fname)
     }
 }
 
+/* Flush the buffered timelapse frames to the disk */
+static void movie_timelapse_sync(ctx_movie *movie)
+{
+    if (movie->tlapse_file == NULL) {
+        return;
+    }
+    if (fflush(movie->tlapse_file) != 0) {
+        MOTPLS_LOG(ERR, TYPE_ENCODER, SHOW_ERRNO
+            ,_("Error writing timelapse file %s"), movie->full_nm);
+    }
+    fsync(fileno(movie->tlapse_file));
+    clock_gettime(CLOCK_MONOTONIC, &movie->tlapse_sync_ts);
+}
+
+/* The file stays open with a large buffer until the timelapse is closed */
 static int movie_timelapse_append(ctx_movie *movie, AVPacket *pkt)
 {
-    FILE *file;
+    struct timespec ts2;
 
-    file = myfopen(movie->full_nm, "abe");
-    if (!file) {
-        return -1;
+    if (movie->tlapse_file == NULL) {
+        movie->tlapse_file = myfopen(movie->full_nm, "abe");
+        if (movie->tlapse_file == NULL) {
+            return -1;
+        }
+        movie->tlapse_buf = (char*)mymalloc(TIMELAPSE_BUF_SIZE);
+        setvbuf(movie->tlapse_file, movie->tlapse_buf, _IOFBF, TIMELAPSE_BUF_SIZE);
+        clock_gettime(CLOCK_MONOTONIC, &movie->tlapse_sync_ts);
     }
 
-    fwrite(pkt->data, 1, pkt->size, file);
+    if (fwrite(pkt->data, 1, pkt->size, movie->tlapse_file) != (size_t)pkt->size) {
+        return -1;
+    }
 
-    myfclose(file);
+    if (movie->tlapse_sync > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &ts2);
+        if ((ts2.tv_sec - movie->tlapse_sync_ts.tv_sec) >= movie->tlapse_sync) {
+            movie_timelapse_sync(movie);
+        }
+    }
 
     return 0;
 }
 
+static void movie_timelapse_close(ctx_movie *movie)
+{
+    if (movie->tlapse_file == NULL) {
+        return;
+    }
+    movie_timelapse_sync(movie);
+    myfclose(movie->tlapse_file);
+    movie->tlapse_file = NULL;
+    myfree(&movie->tlapse_buf);
+}
+
 static void movie_free_context(ctx_movie *movie)
 {
 
@@ -126,30 +173,37 @@ static void movie_free_context(ctx_movie *movie)
 
 }
 
+/*
+ * The full_nm and movie_nm have an extra 10 bytes allocated at the end and
+ * initialized to null, so that we can just memcpy in the extension.  A
+ * standby movie does not have a name until it is assigned to an event.
+ */
+static void movie_set_extension(ctx_movie *movie)
+{
+    size_t ext_len;
+
+    if ((movie->extension == NULL) || (movie->full_nm == NULL)) {
+        return;
+    }
+    ext_len = strlen(movie->extension);
+    memcpy(movie->full_nm + strlen(movie->full_nm), movie->extension, ext_len);
+    memcpy(movie->movie_nm + strlen(movie->movie_nm), movie->extension, ext_len);
+}
+
 static int movie_get_oformat(ctx_movie *movie)
 {
 
     size_t container_name_len;
     char *container_name;
-    int len_full, len_nm;
-
     container_name_len = strcspn(movie->container_name, ":");
     container_name =(char*) mymalloc(container_name_len + 1);
     memcpy(container_name, movie->container_name, container_name_len);
     container_name[container_name_len] = 0;
 
-    /* the full_nm, movie_dir, movie_nm all have an extra 10 bytes allocated
-     * at the end and initialized to null, so that we can just memcpy in the
-     * extensions
-    */
-    len_full = (int)strlen(movie->full_nm);
-    len_nm = (int)strlen(movie->movie_nm);
-
     if (movie->tlapse == TIMELAPSE_APPEND) {
         movie->oc->oformat = av_guess_format("mpeg2video", NULL, NULL);
         movie->oc->video_codec_id = MY_CODEC_ID_MPEG2VIDEO;
-        memcpy(movie->full_nm + len_full, ".mpg", 4);
-        memcpy(movie->movie_nm + len_nm, ".mpg", 4);
+        movie->extension = ".mpg";
         if (movie->oc->oformat == NULL) {
             MOTPLS_LOG(ERR, TYPE_ENCODER, NO_ERRNO
                 ,_("Error setting timelapse append for container %s"), container_name);
@@ -159,49 +213,44 @@ static int movie_get_oformat(ctx_movie *movie)
         }
 
         myfree(&container_name);
+        movie_set_extension(movie);
         return 0;
     }
 
     if (mystreq(container_name, "flv")) {
         movie->oc->oformat = av_guess_format("flv", NULL, NULL);
-        memcpy(movie->full_nm + len_full, ".flv", 4);
-        memcpy(movie->movie_nm + len_nm, ".flv", 4);
+        movie->extension = ".flv";
         movie->oc->video_codec_id = MY_CODEC_ID_FLV1;
     }
 
     if (mystreq(container_name, "ogg")) {
         movie->oc->oformat = av_guess_format("ogg", NULL, NULL);
-        memcpy(movie->full_nm + len_full, ".ogg", 4);
-        memcpy(movie->movie_nm + len_nm, ".ogg", 4);
+        movie->extension = ".ogg";
         movie->oc->video_codec_id = MY_CODEC_ID_THEORA;
     }
 
     if (mystreq(container_name, "vp8")) {
         movie->oc->oformat = av_guess_format("webm", NULL, NULL);
-        memcpy(movie->full_nm + len_full, ".webm", 5);
-        memcpy(movie->movie_nm + len_nm, ".webm", 5);
+        movie->extension = ".webm";
         movie->oc->video_codec_id = MY_CODEC_ID_VP8;
     }
 
     if (mystreq(container_name, "mp4")) {
         movie->oc->oformat = av_guess_format("mp4", NULL, NULL);
-        memcpy(movie->full_nm + len_full, ".mp4", 4);
-        memcpy(movie->movie_nm + len_nm, ".mp4", 4);
+        movie->extension = ".mp4";
         movie->oc->video_codec_id = MY_CODEC_ID_H264;
     }
 
     if (mystreq(container_name, "mkv")) {
         movie->oc->oformat = av_guess_format("matroska", NULL, NULL);
-        memcpy(movie->full_nm + len_full, ".mkv", 4);
-        memcpy(movie->movie_nm + len_nm, ".mkv", 4);
+        movie->extension = ".mkv";
         movie->oc->video_codec_id = MY_CODEC_ID_H264;
     }
 
     if (mystreq(container_name, "hevc")) {
         movie->oc->video_codec_id = MY_CODEC_ID_HEVC;
         movie->oc->oformat = av_guess_format("mp4", NULL, NULL);
-        memcpy(movie->full_nm + len_full, ".mp4", 4);
-        memcpy(movie->movie_nm + len_nm, ".mp4", 4);
+        movie->extension = ".mp4";
         movie->oc->video_codec_id = MY_CODEC_ID_HEVC;
     }
 
@@ -222,6 +271,8 @@ static int movie_get_oformat(ctx_movie *movie)
 
     myfree(&container_name);
 
+    movie_set_extension(movie);
+
     return 0;
 }
 
@@ -524,6 +575,28 @@ static int movie_set_codec_preferred(ctx_movie *movie)
 
 }
 
+/* Semi-planar format for the v4l2m2m encoder.  NV21 unless only NV12 is listed */
+static enum AVPixelFormat movie_get_nv_fmt(ctx_movie *movie)
+{
+    const enum AVPixelFormat *fmt;
+
+    if (movie->codec->pix_fmts == NULL) {
+        return AV_PIX_FMT_NV21;
+    }
+    for (fmt = movie->codec->pix_fmts; *fmt != AV_PIX_FMT_NONE; fmt++) {
+        if (*fmt == AV_PIX_FMT_NV21) {
+            return AV_PIX_FMT_NV21;
+        }
+    }
+    for (fmt = movie->codec->pix_fmts; *fmt != AV_PIX_FMT_NONE; fmt++) {
+        if (*fmt == AV_PIX_FMT_NV12) {
+            return AV_PIX_FMT_NV12;
+        }
+    }
+
+    return AV_PIX_FMT_NV21;
+}
+
 static int movie_set_codec(ctx_movie *movie)
 {
 
@@ -594,7 +667,7 @@ static int movie_set_codec(ctx_movie *movie)
     movie->ctx_codec->time_base.num = 1;
     movie->ctx_codec->time_base.den = movie->fps;
     if (movie->preferred_codec == USER_CODEC_V4L2M2M) {
-        movie->ctx_codec->pix_fmt   = AV_PIX_FMT_NV21;
+        movie->ctx_codec->pix_fmt   = movie_get_nv_fmt(movie);
     } else {
         movie->ctx_codec->pix_fmt   = MY_PIX_FMT_YUV420P;
     }
@@ -760,8 +833,15 @@ static int movie_set_picture(ctx_movie *movie)
     }
 
     movie->picture->linesize[0] = movie->ctx_codec->width;
-    movie->picture->linesize[1] = movie->ctx_codec->width / 2;
-    movie->picture->linesize[2] = movie->ctx_codec->width / 2;
+    if ((movie->ctx_codec->pix_fmt == AV_PIX_FMT_NV21) ||
+        (movie->ctx_codec->pix_fmt == AV_PIX_FMT_NV12)) {
+        /* Both chroma components share one plane of full width rows */
+        movie->picture->linesize[1] = movie->ctx_codec->width;
+        movie->picture->linesize[2] = 0;
+    } else {
+        movie->picture->linesize[1] = movie->ctx_codec->width / 2;
+        movie->picture->linesize[2] = movie->ctx_codec->width / 2;
+    }
 
     movie->picture->format = movie->ctx_codec->pix_fmt;
     movie->picture->width  = movie->ctx_codec->width;
@@ -800,6 +880,7 @@ static int movie_set_outputfile(ctx_movie *movie)
 {
     int retcd;
     char errstr[128];
+    AVDictionary *fmt_opts = NULL;
 
     #if (MYFFVER < 58000)
         retcd = snprintf(movie->oc->full_nm, sizeof(movie->oc->full_nm), "%s", movie->full_nm);
@@ -843,8 +924,15 @@ static int movie_set_outputfile(ctx_movie *movie)
             }
         }
 
+        /* Fragmented segments remain playable if they are never closed */
+        if ((movie->segment) && mystreq(movie->oc->oformat->name, "mp4")) {
+            av_dict_set(&fmt_opts, "movflags"
+                , "frag_keyframe+empty_moov+default_base_moof", 0);
+        }
+
         clock_gettime(CLOCK_MONOTONIC, &movie->cb_st_ts);
-        retcd = avformat_write_header(movie->oc, NULL);
+        retcd = avformat_write_header(movie->oc, &fmt_opts);
+        av_dict_free(&fmt_opts);
         if (retcd < 0) {
             av_strerror(retcd, errstr, sizeof(errstr));
             MOTPLS_LOG(ERR, TYPE_ENCODER, NO_ERRNO
@@ -1367,10 +1455,49 @@ static int movie_passthru_open(ctx_movie *movie)
     return 0;
 }
 
-static void movie_put_pix_nv21(ctx_movie *movie, ctx_image_data *img_data)
+/* Interleave two chroma planes into the single chroma plane of NV12/NV21 */
+static void movie_interleave_uv(unsigned char *dst, const unsigned char *first
+    , const unsigned char *second, int cnt)
 {
-    unsigned char *image,*imagecr, *imagecb;
-    int cr_len, x, y;
+    int indx = 0;
+
+    #if defined(__SSE2__)
+        __m128i pln1, pln2;
+
+        for (; indx + 16 <= cnt; indx += 16) {
+            pln1 = _mm_loadu_si128((const __m128i *)(first + indx));
+            pln2 = _mm_loadu_si128((const __m128i *)(second + indx));
+            _mm_storeu_si128((__m128i *)(dst + indx*2), _mm_unpacklo_epi8(pln1, pln2));
+            _mm_storeu_si128((__m128i *)(dst + indx*2 + 16), _mm_unpackhi_epi8(pln1, pln2));
+        }
+    #elif defined(__ARM_NEON)
+        uint8x16x2_t pln;
+
+        for (; indx + 16 <= cnt; indx += 16) {
+            pln.val[0] = vld1q_u8(first + indx);
+            pln.val[1] = vld1q_u8(second + indx);
+            vst2q_u8(dst + indx*2, pln);
+        }
+    #endif
+
+    for (; indx < cnt; indx++) {
+        dst[indx*2] = first[indx];
+        dst[indx*2 + 1] = second[indx];
+    }
+}
+
+/* The image belongs to the camera so the buffer reference must not free it */
+static void movie_buffer_keep(void *opaque, uint8_t *data)
+{
+    (void)opaque;
+    (void)data;
+}
+
+static int movie_put_pix_nv(ctx_movie *movie, ctx_image_data *img_data)
+{
+    unsigned char *image, *imagecb, *imagecr;
+    AVBufferRef *buf_y;
+    int y_len, cr_len;
 
     if (movie->high_resolution) {
         image = img_data->image_high;
@@ -1378,20 +1505,30 @@ static void movie_put_pix_nv21(ctx_movie *movie, ctx_image_data *img_data)
         image = img_data->image_norm;
     }
 
-    cr_len = movie->ctx_codec->width * movie->ctx_codec->height / 4;
-    imagecr = image + (movie->ctx_codec->width * movie->ctx_codec->height);
-    imagecb = image + (movie->ctx_codec->width * movie->ctx_codec->height) + cr_len;
+    y_len = movie->ctx_codec->width * movie->ctx_codec->height;
+    cr_len = y_len / 4;
+    imagecb = image + y_len;
+    imagecr = image + y_len + cr_len;
 
-    memcpy(movie->picture->data[0], image, movie->ctx_codec->width * movie->ctx_codec->height);
-    for (y = 0; y < movie->ctx_codec->height; y++) {
-        for (x = 0; x < movie->ctx_codec->width/4; x++) {
-            movie->picture->data[1][y*movie->ctx_codec->width/2 + x*2] = *imagecb;
-            movie->picture->data[1][y*movie->ctx_codec->width/2 + x*2 + 1] = *imagecr;
-            imagecb++;
-            imagecr++;
-        }
+    /* The v4l2m2m encoder copies the frame into its own buffers when the
+     * frame is sent so the Y plane is used from the image without a copy.
+     */
+    buf_y = av_buffer_create(image, y_len, movie_buffer_keep, NULL, 0);
+    if (buf_y == NULL) {
+        MOTPLS_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("could not reference the image"));
+        return -1;
     }
+    av_buffer_unref(&movie->picture->buf[0]);
+    movie->picture->buf[0] = buf_y;
+    movie->picture->data[0] = image;
 
+    if (movie->ctx_codec->pix_fmt == AV_PIX_FMT_NV12) {
+        movie_interleave_uv(movie->picture->data[1], imagecb, imagecr, cr_len);
+    } else {
+        movie_interleave_uv(movie->picture->data[1], imagecr, imagecb, cr_len);
+    }
+
+    return 0;
 }
 
 static void movie_put_pix_yuv420(ctx_movie *movie, ctx_image_data *img_data)
@@ -1411,20 +1548,11 @@ static void movie_put_pix_yuv420(ctx_movie *movie, ctx_image_data *img_data)
 
 }
 
-int movie_open(ctx_movie *movie)
+/* Set up the container and encoder.  This does not need the output file */
+static int movie_open_codec(ctx_movie *movie)
 {
     int retcd;
 
-    if (movie->passthrough) {
-        retcd = movie_passthru_open(movie);
-        if (retcd < 0 ) {
-            MOTPLS_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Could not setup passthrough!"));
-            movie_free_context(movie);
-            return -1;
-        }
-        return 0;
-    }
-
     movie->oc = avformat_alloc_context();
     if (!movie->oc) {
         MOTPLS_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Could not allocate output context"));
@@ -1461,6 +1589,28 @@ int movie_open(ctx_movie *movie)
         return -1;
     }
 
+    return 0;
+}
+
+int movie_open(ctx_movie *movie)
+{
+    int retcd;
+
+    if (movie->passthrough) {
+        retcd = movie_passthru_open(movie);
+        if (retcd < 0 ) {
+            MOTPLS_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Could not setup passthrough!"));
+            movie_free_context(movie);
+            return -1;
+        }
+        return 0;
+    }
+
+    retcd = movie_open_codec(movie);
+    if (retcd < 0) {
+        return -1;
+    }
+
     retcd = movie_set_outputfile(movie);
     if (retcd < 0) {
         MOTPLS_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Could not set the stream"));
@@ -1497,6 +1647,9 @@ void movie_close(ctx_movie *movie)
         if (movie_flush_codec(movie) < 0) {
             MOTPLS_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Error flushing codec"));
         }
+        if (movie->tlapse == TIMELAPSE_APPEND) {
+            movie_timelapse_close(movie);
+        }
         if (movie->oc != NULL) {
             if (movie->oc->pb != NULL) {
                 if (movie->tlapse != TIMELAPSE_APPEND) {
@@ -1529,7 +1682,9 @@ int movie_put_image(ctx_movie *movie, ctx_image_data *img_data, const struct tim
     if (movie->picture) {
 
         if (movie->preferred_codec == USER_CODEC_V4L2M2M) {
-            movie_put_pix_nv21(movie, img_data);
+            if (movie_put_pix_nv(movie, img_data) != 0) {
+                return -1;
+            }
         } else {
             movie_put_pix_yuv420(movie, img_data);
         }
@@ -1612,19 +1767,170 @@ static const char* movie_init_container(ctx_dev *cam)
 
 }
 
+/* Set the encoder values of the normal movie */
+static void movie_init_norm_values(ctx_dev *cam, ctx_movie *movie, const char *container)
+{
+    if (cam->imgs.size_high > 0) {
+        movie->width  = cam->imgs.width_high;
+        movie->height = cam->imgs.height_high;
+        movie->high_resolution = true;
+        movie->netcam_data = cam->netcam_high;
+    } else {
+        movie->width  = cam->imgs.width;
+        movie->height = cam->imgs.height;
+        movie->high_resolution = false;
+        movie->netcam_data = cam->netcam;
+    }
+    movie->pkt = NULL;
+    movie->tlapse = TIMELAPSE_NONE;
+    movie->fps = cam->lastrate;
+    movie->bps = cam->conf->movie_bps;
+    movie->quality = cam->conf->movie_quality;
+    movie->last_pts = -1;
+    movie->base_pts = 0;
+    movie->gop_cnt = 0;
+    movie->container_name = container;
+    if (cam->conf->movie_container == "test") {
+        movie->test_mode = true;
+    } else {
+        movie->test_mode = false;
+    }
+    movie->motion_images = 0;
+    movie->passthrough = cam->movie_passthrough;
+}
+
+/* Whether the standby encoder was prepared with the current settings */
+static bool movie_standby_match(ctx_dev *cam, ctx_movie *movie, const char *container)
+{
+    int width, height, fps_diff;
+
+    if (cam->imgs.size_high > 0) {
+        width  = cam->imgs.width_high;
+        height = cam->imgs.height_high;
+    } else {
+        width  = cam->imgs.width;
+        height = cam->imgs.height;
+    }
+
+    /* The pts come from the image times so a small change of the rate is ok */
+    fps_diff = abs(movie->standby_fps - (int)cam->lastrate);
+
+    if ((movie->width != width) || (movie->height != height) ||
+        (fps_diff > (int)(cam->lastrate / 10) + 1) ||
+        (movie->bps != cam->conf->movie_bps) ||
+        (movie->standby_quality != cam->conf->movie_quality) ||
+        (cam->movie_passthrough) ||
+        mystrne(movie->standby_container, container)) {
+        return false;
+    }
+
+    return true;
+}
+
+void movie_standby_deinit(ctx_dev *cam)
+{
+    if (cam->movie_standby != NULL) {
+        movie_free(cam->movie_standby);
+        myfree(&cam->movie_standby);
+    }
+}
+
+/* Take the standby encoder for a new movie if it can be used */
+static ctx_movie *movie_standby_get(ctx_dev *cam, const char *container)
+{
+    ctx_movie *movie;
+
+    if (cam->movie_standby == NULL) {
+        return NULL;
+    }
+
+    if (movie_standby_match(cam, cam->movie_standby, container) == false) {
+        movie_standby_deinit(cam);
+        return NULL;
+    }
+
+    movie = cam->movie_standby;
+    cam->movie_standby = NULL;
+
+    return movie;
+}
+
+/*
+ * Keep an encoder opened and ready for the next movie of the camera so that
+ * starting a movie only needs to open the file and write the header.  The
+ * encoder is only prepared while no normal movie is being written.
+ */
+void movie_standby_update(ctx_dev *cam)
+{
+    const char *container;
+    ctx_movie *movie;
+    int retcd;
+
+    if ((cam->conf->movie_output == false) || (cam->movie_passthrough) ||
+        (cam->conf->movie_container == "test") || (cam->lastrate == 0)) {
+        movie_standby_deinit(cam);
+        return;
+    }
+
+    if (cam->movie_norm != NULL) {
+        return;
+    }
+
+    container = cam->conf->movie_container.c_str();
+
+    if (cam->movie_standby != NULL) {
+        if (movie_standby_match(cam, cam->movie_standby, container)) {
+            return;
+        }
+        movie_standby_deinit(cam);
+    }
+
+    /* Limit how often the encoder is rebuilt when the settings change */
+    if (cam->frame_curr_ts.tv_sec < cam->movie_standby_retry) {
+        return;
+    }
+    cam->movie_standby_retry = cam->frame_curr_ts.tv_sec + 10;
+
+    movie =(ctx_movie*) mymalloc(sizeof(ctx_movie));
+    snprintf(movie->standby_container, sizeof(movie->standby_container)
+        , "%s", container);
+    movie_init_norm_values(cam, movie, movie->standby_container);
+    movie->standby_fps = movie->fps;
+    movie->standby_quality = movie->quality;
+
+    retcd = movie_open_codec(movie);
+    if (retcd < 0) {
+        MOTPLS_LOG(INF, TYPE_ENCODER, NO_ERRNO
+            ,_("Unable to prepare the encoder for the next movie"));
+        movie_free(movie);
+        myfree(&movie);
+        return;
+    }
+
+    cam->movie_standby = movie;
+
+    MOTPLS_LOG(DBG, TYPE_ENCODER, NO_ERRNO
+        ,_("Encoder prepared for the next movie %dx%d %d fps")
+        , movie->width, movie->height, movie->standby_fps);
+}
+
 int movie_init_norm(ctx_dev *cam, struct timespec *ts1)
 {
     char tmp[PATH_MAX];
     const char *container;
     int retcd, len;
 
-    cam->movie_norm =(ctx_movie*) mymalloc(sizeof(ctx_movie));
-
     mystrftime(cam, tmp, sizeof(tmp)
         , cam->conf->movie_filename.c_str(), ts1, NULL, 0);
 
     container = movie_init_container(cam);
 
+    cam->movie_norm = movie_standby_get(cam, container);
+    if (cam->movie_norm == NULL) {
+        cam->movie_norm =(ctx_movie*) mymalloc(sizeof(ctx_movie));
+        movie_init_norm_values(cam, cam->movie_norm, container);
+    }
+
     /* The increment of 10 is to allow for the extension and other chars*/
     len = (int)(strlen(tmp) + cam->conf->target_dir.length() + 10);
     cam->movie_norm->full_nm = (char*)mymalloc(len);
@@ -1650,37 +1956,22 @@ int movie_init_norm(ctx_dev *cam, struct timespec *ts1)
             ,_("Error setting file name"));
         return -1;
     }
-    if (cam->imgs.size_high > 0) {
-        cam->movie_norm->width  = cam->imgs.width_high;
-        cam->movie_norm->height = cam->imgs.height_high;
-        cam->movie_norm->high_resolution = true;
-        cam->movie_norm->netcam_data = cam->netcam_high;
-    } else {
-        cam->movie_norm->width  = cam->imgs.width;
-        cam->movie_norm->height = cam->imgs.height;
-        cam->movie_norm->high_resolution = false;
-        cam->movie_norm->netcam_data = cam->netcam;
-    }
-    cam->movie_norm->pkt = NULL;
-    cam->movie_norm->tlapse = TIMELAPSE_NONE;
-    cam->movie_norm->fps = cam->lastrate;
-    cam->movie_norm->bps = cam->conf->movie_bps;
-    cam->movie_norm->quality = cam->conf->movie_quality;
     cam->movie_norm->start_time.tv_sec = ts1->tv_sec;
     cam->movie_norm->start_time.tv_nsec = ts1->tv_nsec;
-    cam->movie_norm->last_pts = -1;
-    cam->movie_norm->base_pts = 0;
-    cam->movie_norm->gop_cnt = 0;
-    cam->movie_norm->container_name = container;
-    if (cam->conf->movie_container == "test") {
-        cam->movie_norm->test_mode = true;
+    if (cam->conf->movie_segment > 0) {
+        cam->movie_norm->segment = true;
     } else {
-        cam->movie_norm->test_mode = false;
+        cam->movie_norm->segment = false;
     }
-    cam->movie_norm->motion_images = 0;
-    cam->movie_norm->passthrough = cam->movie_passthrough;
 
-    retcd = movie_open(cam->movie_norm);
+    /* A standby encoder is already open and only needs the file */
+    if (cam->movie_norm->oc != NULL) {
+        movie_set_extension(cam->movie_norm);
+        clock_gettime(CLOCK_MONOTONIC, &cam->movie_norm->cb_st_ts);
+        retcd = movie_set_outputfile(cam->movie_norm);
+    } else {
+        retcd = movie_open(cam->movie_norm);
+    }
 
     return retcd;
 
@@ -1766,18 +2057,18 @@ int movie_init_timelapse(ctx_dev *cam, struct timespec *ts1)
 
     /* The increment of 10 is to allow for the extension and other chars*/
     len = (int)(strlen(tmp) + cam->conf->target_dir.length() + 10);
-    cam->movie_norm->full_nm = (char*)mymalloc(len);
+    cam->movie_timelapse->full_nm = (char*)mymalloc(len);
     retcd = snprintf(cam->movie_timelapse->full_nm, len, "%s/%s"
         , cam->conf->target_dir.c_str(), tmp);
 
     len = (int)cam->conf->target_dir.length() + 10;
-    cam->movie_norm->movie_dir = (char*)mymalloc(len);
-    retcd = snprintf(cam->movie_norm->movie_dir,len,"%s"
+    cam->movie_timelapse->movie_dir = (char*)mymalloc(len);
+    retcd = snprintf(cam->movie_timelapse->movie_dir,len,"%s"
         ,cam->conf->target_dir.c_str());
 
     len = (int)strlen(tmp) + 10;
-    cam->movie_norm->movie_nm = (char*)mymalloc(len);
-    retcd = snprintf(cam->movie_norm->movie_nm, len, "%s", tmp);
+    cam->movie_timelapse->movie_nm = (char*)mymalloc(len);
+    retcd = snprintf(cam->movie_timelapse->movie_nm, len, "%s", tmp);
 
     if (retcd < 0) {
         MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
@@ -1806,6 +2097,9 @@ int movie_init_timelapse(ctx_dev *cam, struct timespec *ts1)
     cam->movie_timelapse->motion_images = false;
     cam->movie_timelapse->passthrough = false;
     cam->movie_timelapse->netcam_data = NULL;
+    cam->movie_timelapse->tlapse_file = NULL;
+    cam->movie_timelapse->tlapse_buf = NULL;
+    cam->movie_timelapse->tlapse_sync = cam->conf->timelapse_sync_interval;
 
     if (cam->conf->timelapse_container == "mpg") {
         MOTPLS_LOG(NTC, TYPE_EVENTS, NO_ERRNO, _("Timelapse using mpg container."));
@@ -1925,3 +2219,11 @@ int ctx_dev::movie_init_motion(timespec *ts1)
 {
     return ::movie_init_motion(this, ts1);
 }
+void ctx_dev::movie_standby_update()
+{
+    ::movie_standby_update(this);
+}
+void ctx_dev::movie_standby_deinit()
+{
+    ::movie_standby_deinit(this);
+}
@@ -76,12 +76,21 @@ struct ctx_movie {
     bool                high_resolution;
     bool                motion_images;
     bool                passthrough;
+    bool                segment;        /* Segment of the continuous recording */
+    const char          *extension;     /* File extension of the container */
+    int                 standby_fps;    /* Requested values when prepared as a standby encoder */
+    int                 standby_quality;
+    char                standby_container[32];
     enum USER_CODEC     preferred_codec;
     char                *nal_info;
     int                 nal_info_len;
     struct timespec     cb_st_ts;    /* The time set before calling the av functions */
     struct timespec     cb_cr_ts;    /* Time during the interrupt to determine duration since start*/
     int                 cb_dur;      /* Seconds permitted before triggering a interrupt */
+    FILE                *tlapse_file;   /* Timelapse file kept open while appending */
+    char                *tlapse_buf;    /* Write buffer for the timelapse file */
+    int                 tlapse_sync;    /* Seconds between syncs of the timelapse file */
+    struct timespec     tlapse_sync_ts; /* Time of the last sync of the timelapse file */
 
     int movie_open();
     int movie_put_image(ctx_image_data *img_data, const struct timespec *tv1);
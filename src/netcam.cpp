@@ -714,6 +714,7 @@ static void netcam_decoder_error(ctx_netcam *netcam, int retcd, const char* fnc_
 {
     char errstr[128];
     int indx;
+    std::string parms_str;
 
     if (netcam->interrupted) {
         MOTPLS_LOG(ERR, TYPE_NETCAM, NO_ERRNO
@@ -746,11 +747,8 @@ static void netcam_decoder_error(ctx_netcam *netcam, int retcd, const char* fnc_
             }
         }
 
-        if (netcam->high_resolution) {
-            util_parms_update(netcam->params, netcam->conf->netcam_high_params);
-        } else {
-            util_parms_update(netcam->params, netcam->conf->netcam_params);
-        }
+        parms_str = netcam->conf_params;
+        util_parms_update(netcam->params, parms_str);
 
         myfree(&netcam->decoder_nm);
         netcam->decoder_nm = (char*)mymalloc(5);
@@ -1311,7 +1309,7 @@ static int netcam_read_image(ctx_netcam *netcam)
         }
     } else {
         if (netcam->capture_rate < 1) {
-            netcam->capture_rate = netcam->conf->framerate;
+            netcam->capture_rate = netcam->conf_framerate;
             if (netcam->pts_adj == false) {
                MOTPLS_LOG(INF, TYPE_NETCAM, NO_ERRNO
                     ,_("%s: capture_rate not specified in netcam_params. Using framerate %d")
@@ -1353,6 +1351,15 @@ static int netcam_ntc(ctx_netcam *netcam)
 
 }
 
+/* Round a configured dimension up to a multiple of 8 */
+static int netcam_dim8(int dim)
+{
+    if (dim % 8) {
+        return dim - (dim % 8) + 8;
+    }
+    return dim;
+}
+
 static void netcam_set_options(ctx_netcam *netcam)
 {
 
@@ -1390,10 +1397,11 @@ static void netcam_set_options(ctx_netcam *netcam)
             ,_("%s: Setting input_format video4linux2"),netcam->cameratype);
         netcam->format_context->iformat = av_find_input_format("video4linux2");
 
-        sprintf(tmpval,"%d",netcam->conf->framerate);
+        sprintf(tmpval,"%d",netcam->conf_framerate);
         util_parms_add_default(netcam->params,"framerate", tmpval);
 
-        sprintf(tmpval,"%dx%d",netcam->conf->width, netcam->conf->height);
+        sprintf(tmpval,"%dx%d"
+            , netcam_dim8(netcam->conf_width), netcam_dim8(netcam->conf_height));
         util_parms_add_default(netcam->params,"video_size", tmpval);
 
         /* Allow a bit more time for the v4l2 device to start up */
@@ -1494,9 +1502,19 @@ static void netcam_set_parms (ctx_dev *cam, ctx_netcam *netcam )
 {
     /* Set the parameters to be used with our camera */
     int indx, val_len;
+    std::string parms_str;
 
     netcam->motapp = cam->motapp;
-    netcam->conf = cam->conf;
+    netcam->conf_framerate = cam->conf->framerate;
+    netcam->conf_width = cam->conf->width;
+    netcam->conf_height = cam->conf->height;
+    if (netcam->high_resolution) {
+        parms_str = cam->conf->netcam_high_params;
+    } else {
+        parms_str = cam->conf->netcam_params;
+    }
+    netcam->conf_params = (char*)mymalloc(parms_str.length() + 1);
+    snprintf(netcam->conf_params, parms_str.length() + 1, "%s", parms_str.c_str());
 
     pthread_mutex_lock(&netcam->motapp->global_lock);
         netcam->threadnbr = ++netcam->motapp->threads_running;
@@ -1510,8 +1528,8 @@ static void netcam_set_parms (ctx_dev *cam, ctx_netcam *netcam )
         netcam->params->update_params = true;
         util_parms_parse(netcam->params, cam->conf->netcam_high_params);
     } else {
-        netcam->imgsize.width = cam->conf->width;
-        netcam->imgsize.height = cam->conf->height;
+        netcam->imgsize.width = cam->imgs.width;
+        netcam->imgsize.height = cam->imgs.height;
         snprintf(netcam->cameratype, 29, "%s",_("Norm"));
         netcam->params = (ctx_params*)mymalloc(sizeof(ctx_params));
         netcam->params->update_params = true;
@@ -1584,6 +1602,7 @@ static void netcam_set_parms (ctx_dev *cam, ctx_netcam *netcam )
 
 static void netcam_set_dimensions (ctx_dev *cam)
 {
+    int width, height;
 
     cam->imgs.width = 0;
     cam->imgs.height = 0;
@@ -1594,28 +1613,29 @@ static void netcam_set_dimensions (ctx_dev *cam)
     cam->imgs.height_high = 0;
     cam->imgs.size_high   = 0;
 
-    if (cam->conf->width % 8) {
+    /* The configuration is left as is and only the image size is adjusted */
+    width = netcam_dim8(cam->conf->width);
+    height = netcam_dim8(cam->conf->height);
+    if (width != cam->conf->width) {
         MOTPLS_LOG(CRT, TYPE_NETCAM, NO_ERRNO
             ,_("Image width (%d) requested is not modulo 8.")
             , cam->conf->width);
-        cam->conf->width = cam->conf->width - (cam->conf->width % 8) + 8;
         MOTPLS_LOG(CRT, TYPE_NETCAM, NO_ERRNO
-            ,_("%s: Adjusting width to next higher multiple of 8 (%d).")
-            , cam->conf->width);
+            ,_("Adjusting width to next higher multiple of 8 (%d).")
+            , width);
     }
-    if (cam->conf->height % 8) {
+    if (height != cam->conf->height) {
         MOTPLS_LOG(CRT, TYPE_NETCAM, NO_ERRNO
             ,_("Image height (%d) requested is not modulo 8."), cam->conf->height);
-        cam->conf->height = cam->conf->height - (cam->conf->height % 8) + 8;
         MOTPLS_LOG(CRT, TYPE_NETCAM, NO_ERRNO
-            ,_("Adjusting height to next higher multiple of 8 (%d)."), cam->conf->height);
+            ,_("Adjusting height to next higher multiple of 8 (%d)."), height);
     }
 
     /* Fill in camera details into context structure. */
-    cam->imgs.width = cam->conf->width;
-    cam->imgs.height = cam->conf->height;
-    cam->imgs.size_norm = (cam->conf->width * cam->conf->height * 3) / 2;
-    cam->imgs.motionsize = cam->conf->width * cam->conf->height;
+    cam->imgs.width = width;
+    cam->imgs.height = height;
+    cam->imgs.size_norm = (width * height * 3) / 2;
+    cam->imgs.motionsize = width * height;
 
 }
 
@@ -1888,6 +1908,7 @@ static void netcam_shutdown(ctx_netcam *netcam)
         }
 
         myfree(&netcam->decoder_nm);
+        myfree(&netcam->conf_params);
         util_parms_free(netcam->params);
         myfree(&netcam->params);
     }
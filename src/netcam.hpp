@@ -140,7 +140,10 @@ struct ctx_netcam {
     struct timespec           frame_prev_tm;    /* The time set before calling the av functions */
     struct timespec           frame_curr_tm;    /* Time during the interrupt to determine duration since start*/
     ctx_motapp                *motapp;          /* Pointer to parent application context  */
-    ctx_config                *conf;            /* Pointer to conf parms of parent cam*/
+    int                       conf_framerate;   /* Config values copied when the camera starts since */
+    int                       conf_width;       /* the config of the parent cam may be replaced while */
+    int                       conf_height;      /* the handler thread is running */
+    char                      *conf_params;     /* netcam_params or netcam_high_params */
     ctx_params                *params;          /* parameters for the camera */
 
     char                      threadname[16];   /* The thread name*/
@@ -0,0 +1,441 @@
+/*
+ *    This file is part of MotionPlus.
+ *
+ *    MotionPlus is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    MotionPlus is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with MotionPlus.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *    Copyright 2020-2023 MotionMrDave@gmail.com
+ */
+
+/*
+ * pic_writer.cpp
+ *   Pool of threads that encode and write the pictures so that the
+ *   camera threads do not wait on the jpeg/webp compression and file io.
+ *   The camera thread makes a private copy of the image along with the
+ *   EXIF data and the image info.  Once the file is written, the item is
+ *   returned to the camera thread which then runs the on_picture_save
+ *   command and the database insert with the image info that was current
+ *   when the picture was requested.
+ */
+
+#include "motionplus.hpp"
+#include "conf.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+#include "picture.hpp"
+#include "pic_writer.hpp"
+
+/* Release the item and its buffers */
+static void picwrt_item_free(ctx_picwrt_item *item)
+{
+    myfree(&item->image);
+    myfree(&item->jpeg_data);
+    if (item->exif != NULL) {
+        free(item->exif);
+        item->exif = NULL;
+    }
+    delete item;
+}
+
+/* Run the file created actions for a written picture on the camera thread */
+static void picwrt_complete(ctx_picwrt_item *item)
+{
+    ctx_dev *cam = item->cam;
+    ctx_image_data *saved_current_image;
+
+    /* The writer can not finish the camera so it is done here */
+    if (item->denied) {
+        cam->finish_dev = true;
+        cam->restart_dev = false;
+    }
+
+    saved_current_image = cam->current_image;
+    cam->current_image = &item->img_data;
+
+    cam->event(EVENT_FILECREATE, NULL, item->file_nm, (void *)(long)item->ftype, &item->ts1);
+    cam->dbse_exec(item->file_nm, item->ftype, &item->ts1, "pic_save");
+
+    cam->current_image = saved_current_image;
+}
+
+/* Determine whether the writer threads are in use */
+static bool picwrt_active(ctx_dev *cam)
+{
+    if ((cam->motapp->picwrt == NULL) ||
+        (cam->motapp->picwrt->thread_cnt == 0)) {
+        return false;
+    }
+    return true;
+}
+
+/* Get the worker assigned to the camera */
+static ctx_picwrt_worker *picwrt_worker(ctx_dev *cam)
+{
+    ctx_picwrt *picwrt = cam->motapp->picwrt;
+
+    return &picwrt->workers[cam->threadnr % picwrt->thread_cnt];
+}
+
+/* Determine whether the camera has items queued or being written.  Mutex must be locked */
+static bool picwrt_pending(ctx_picwrt_worker *worker, ctx_dev *cam)
+{
+    std::list<ctx_picwrt_item *>::iterator it;
+
+    if ((worker->active != NULL) && (worker->active->cam == cam)) {
+        return true;
+    }
+    for (it = worker->queue.begin(); it != worker->queue.end(); it++) {
+        if ((*it)->cam == cam) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Writer thread processing loop */
+static void *picwrt_handler(void *arg)
+{
+    ctx_picwrt_worker *worker = (ctx_picwrt_worker *)arg;
+    ctx_picwrt *picwrt = worker->picwrt;
+    ctx_picwrt_item *item;
+
+    mythreadname_set("pw", worker->indx, NULL);
+
+    pthread_mutex_lock(&picwrt->mutex);
+    while (true) {
+        while ((worker->queue.empty()) && (picwrt->closing == false)) {
+            pthread_cond_wait(&picwrt->cond_work, &picwrt->mutex);
+        }
+        /* Finish any remaining pictures before exiting */
+        if (worker->queue.empty()) {
+            break;
+        }
+        item = worker->queue.front();
+        worker->queue.pop_front();
+        worker->active = item;
+        pthread_mutex_unlock(&picwrt->mutex);
+
+        /* Only the item is used here.  The camera may be changing its config */
+        if (item->jpeg_data != NULL) {
+            pic_save_jpeg(item->file_nm
+                , item->jpeg_data, item->jpeg_size, item->ftype
+                , item->exif, item->exif_len, &item->denied);
+        } else {
+            pic_save_file(item->file_nm, item->image
+                , item->width, item->height
+                , item->picture_type, item->quality, item->ftype
+                , item->exif, item->exif_len, &item->denied);
+        }
+
+        myfree(&item->image);
+        myfree(&item->jpeg_data);
+        if (item->exif != NULL) {
+            free(item->exif);
+            item->exif = NULL;
+        }
+
+        pthread_mutex_lock(&picwrt->mutex);
+        worker->active = NULL;
+        picwrt->done.push_back(item);
+        picwrt->queue_depth--;
+        picwrt->write_cnt++;
+        pthread_cond_broadcast(&picwrt->cond_space);
+    }
+    pthread_mutex_unlock(&picwrt->mutex);
+
+    worker->thread_running = false;
+
+    pthread_exit(NULL);
+}
+
+/* Put the item on the queue of the worker for the camera.  Waits when the queue is full */
+static void picwrt_queue(ctx_dev *cam, ctx_picwrt_item *item)
+{
+    ctx_picwrt *picwrt = cam->motapp->picwrt;
+    ctx_picwrt_worker *worker = picwrt_worker(cam);
+
+    pthread_mutex_lock(&picwrt->mutex);
+        if (picwrt->queue_depth >= picwrt->queue_max) {
+            if (picwrt->stall_cnt == 0) {
+                MOTPLS_LOG(WRN, TYPE_EVENTS, NO_ERRNO
+                    ,_("Picture writer queue is full.  Consider increasing picture_writer_threads"));
+            }
+            picwrt->stall_cnt++;
+            while (picwrt->queue_depth >= picwrt->queue_max) {
+                pthread_cond_wait(&picwrt->cond_space, &picwrt->mutex);
+            }
+        }
+        worker->queue.push_back(item);
+        picwrt->queue_depth++;
+        if (picwrt->queue_depth > picwrt->queue_peak) {
+            picwrt->queue_peak = picwrt->queue_depth;
+        }
+        pthread_cond_broadcast(&picwrt->cond_work);
+    pthread_mutex_unlock(&picwrt->mutex);
+}
+
+/* Create a item with the image info that is current on the camera thread */
+static ctx_picwrt_item *picwrt_item_new(ctx_dev *cam, char *file
+        , int ftype, struct timespec *ts1)
+{
+    ctx_picwrt_item *item;
+
+    item = new ctx_picwrt_item;
+    item->cam = cam;
+    snprintf(item->file_nm, PATH_MAX, "%s", file);
+    item->ftype = ftype;
+    item->picture_type = cam->conf->picture_type;
+    item->quality = cam->conf->picture_quality;
+    item->denied = false;
+    item->image = NULL;
+    item->jpeg_data = NULL;
+    item->jpeg_size = 0;
+    item->width = 0;
+    item->height = 0;
+    item->exif = NULL;
+    item->exif_len = 0;
+    item->img_data = *cam->current_image;
+    if (ts1 != NULL) {
+        item->ts1 = *ts1;
+    } else {
+        clock_gettime(CLOCK_REALTIME, &item->ts1);
+    }
+
+    return item;
+}
+
+/* Save the picture using the writer threads when they are in use */
+void picwrt_save_norm(ctx_dev *cam, char *file, unsigned char *image
+        , int ftype, struct timespec *ts1)
+{
+    ctx_picwrt_item *item;
+    ctx_pic_cache_item *cache;
+    int image_size;
+
+    if (picwrt_active(cam) == false) {
+        pic_save_norm(cam, file, image, ftype);
+        cam->event(EVENT_FILECREATE, NULL, file, (void *)(long)ftype, ts1);
+        cam->dbse_exec(file, ftype, ts1, "pic_save");
+        return;
+    }
+
+    item = picwrt_item_new(cam, file, ftype, ts1);
+
+    pic_save_size(cam, ftype, &item->width, &item->height);
+
+    /* Only the jpeg is kept when a stream has compressed the same image */
+    cache = pic_cache_save(cam, image, item->width, item->height, ftype);
+    if (cache != NULL) {
+        item->jpeg_size = cache->jpeg_size;
+        item->jpeg_data = (unsigned char *)mymalloc(cache->jpeg_size);
+        memcpy(item->jpeg_data, cache->jpeg_data, cache->jpeg_size);
+    } else {
+        image_size = (item->width * item->height * 3) / 2;
+        item->image = (unsigned char *)mymalloc(image_size);
+        memcpy(item->image, image, image_size);
+    }
+
+    item->exif_len = pic_save_exif(cam, &item->exif, ftype
+        , &cam->current_image->imgts, &cam->current_image->location);
+
+    picwrt_queue(cam, item);
+}
+
+/* Save the region of interest using the writer threads when they are in use */
+void picwrt_save_roi(ctx_dev *cam, char *file, unsigned char *image
+        , struct timespec *ts1)
+{
+    ctx_picwrt_item *item;
+    ctx_coord *bx;
+
+    bx = &cam->current_image->location;
+
+    /* Small regions are not written but are still reported as before */
+    if ((picwrt_active(cam) == false) ||
+        (bx->width <64) || (bx->height <64)) {
+        pic_save_roi(cam, file, image);
+        cam->event(EVENT_FILECREATE, NULL, file, (void *)FTYPE_IMAGE_ROI, ts1);
+        cam->dbse_exec(file, FTYPE_IMAGE_ROI, ts1, "pic_save");
+        return;
+    }
+
+    item = picwrt_item_new(cam, file, FTYPE_IMAGE_ROI, ts1);
+
+    item->image = pic_save_roi_img(cam, image, bx);
+    item->width = bx->width;
+    item->height = bx->height;
+
+    item->exif_len = pic_save_exif(cam, &item->exif, FTYPE_IMAGE_ROI
+        , &cam->current_image->imgts, bx);
+
+    picwrt_queue(cam, item);
+}
+
+/* Run the file created actions for the pictures of the camera that have been written */
+void picwrt_process(ctx_dev *cam)
+{
+    ctx_picwrt *picwrt = cam->motapp->picwrt;
+    std::list<ctx_picwrt_item *> items;
+    std::list<ctx_picwrt_item *>::iterator it;
+
+    if (picwrt_active(cam) == false) {
+        return;
+    }
+
+    pthread_mutex_lock(&picwrt->mutex);
+        it = picwrt->done.begin();
+        while (it != picwrt->done.end()) {
+            if ((*it)->cam == cam) {
+                items.push_back(*it);
+                it = picwrt->done.erase(it);
+            } else {
+                it++;
+            }
+        }
+    pthread_mutex_unlock(&picwrt->mutex);
+
+    for (it = items.begin(); it != items.end(); it++) {
+        picwrt_complete(*it);
+        picwrt_item_free(*it);
+    }
+}
+
+/* Wait for all the pictures of the camera to be written */
+void picwrt_flush(ctx_dev *cam)
+{
+    ctx_picwrt *picwrt = cam->motapp->picwrt;
+    ctx_picwrt_worker *worker;
+
+    if (picwrt_active(cam) == false) {
+        return;
+    }
+
+    worker = picwrt_worker(cam);
+
+    pthread_mutex_lock(&picwrt->mutex);
+        while (picwrt_pending(worker, cam)) {
+            pthread_cond_wait(&picwrt->cond_space, &picwrt->mutex);
+        }
+    pthread_mutex_unlock(&picwrt->mutex);
+
+    picwrt_process(cam);
+}
+
+/* Start the writer threads */
+void picwrt_init(ctx_motapp *motapp)
+{
+    ctx_picwrt *picwrt;
+    pthread_attr_t thread_attr;
+    int indx, retcd;
+
+    motapp->picwrt = NULL;
+
+    if (motapp->conf->picture_writer_threads == 0) {
+        return;
+    }
+
+    picwrt = new ctx_picwrt;
+    picwrt->thread_cnt = 0;
+    picwrt->queue_max = motapp->conf->picture_writer_queue;
+    picwrt->workers = new ctx_picwrt_worker[motapp->conf->picture_writer_threads];
+    picwrt->closing = false;
+    picwrt->queue_depth = 0;
+    picwrt->queue_peak = 0;
+    picwrt->stall_cnt = 0;
+    picwrt->write_cnt = 0;
+
+    pthread_mutex_init(&picwrt->mutex, NULL);
+    pthread_cond_init(&picwrt->cond_work, NULL);
+    pthread_cond_init(&picwrt->cond_space, NULL);
+
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+
+    for (indx = 0; indx < motapp->conf->picture_writer_threads; indx++) {
+        picwrt->workers[indx].picwrt = picwrt;
+        picwrt->workers[indx].indx = indx;
+        picwrt->workers[indx].active = NULL;
+        picwrt->workers[indx].thread_running = true;
+        retcd = pthread_create(&picwrt->workers[indx].thread_id
+            , &thread_attr, &picwrt_handler, &picwrt->workers[indx]);
+        if (retcd != 0) {
+            MOTPLS_LOG(ALR, TYPE_EVENTS, SHOW_ERRNO
+                ,_("Error starting picture writer thread"));
+            picwrt->workers[indx].thread_running = false;
+            break;
+        }
+        picwrt->thread_cnt++;
+    }
+
+    pthread_attr_destroy(&thread_attr);
+
+    motapp->picwrt = picwrt;
+
+    if (picwrt->thread_cnt == 0) {
+        picwrt_deinit(motapp);
+        return;
+    }
+
+    MOTPLS_LOG(INF, TYPE_EVENTS, NO_ERRNO
+        ,_("Started %d picture writer threads"), picwrt->thread_cnt);
+}
+
+/* Stop the writer threads once the queued pictures are written */
+void picwrt_deinit(ctx_motapp *motapp)
+{
+    ctx_picwrt *picwrt = motapp->picwrt;
+    std::list<ctx_picwrt_item *>::iterator it;
+    int indx, waitcnt;
+
+    if (picwrt == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&picwrt->mutex);
+        picwrt->closing = true;
+        pthread_cond_broadcast(&picwrt->cond_work);
+    pthread_mutex_unlock(&picwrt->mutex);
+
+    for (indx = 0; indx < picwrt->thread_cnt; indx++) {
+        waitcnt = 0;
+        while ((picwrt->workers[indx].thread_running) && (waitcnt < 1000)) {
+            SLEEP(0,1000000)
+            waitcnt++;
+        }
+        if (waitcnt == 1000) {
+            /* The thread still references the context so it can not be freed */
+            MOTPLS_LOG(ERR, TYPE_EVENTS, NO_ERRNO
+                ,_("Graceful shutdown of picture writer thread failed"));
+            motapp->picwrt = NULL;
+            return;
+        }
+    }
+
+    MOTPLS_LOG(INF, TYPE_EVENTS, NO_ERRNO
+        ,_("Picture writer: %llu written, peak queue %d, full queue waits %llu")
+        , (unsigned long long)picwrt->write_cnt, picwrt->queue_peak
+        , (unsigned long long)picwrt->stall_cnt);
+
+    for (it = picwrt->done.begin(); it != picwrt->done.end(); it++) {
+        picwrt_item_free(*it);
+    }
+    picwrt->done.clear();
+
+    pthread_cond_destroy(&picwrt->cond_space);
+    pthread_cond_destroy(&picwrt->cond_work);
+    pthread_mutex_destroy(&picwrt->mutex);
+
+    delete [] picwrt->workers;
+    delete picwrt;
+    motapp->picwrt = NULL;
+}
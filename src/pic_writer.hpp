@@ -0,0 +1,79 @@
+/*
+ *    This file is part of MotionPlus.
+ *
+ *    MotionPlus is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    MotionPlus is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with MotionPlus.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *    Copyright 2020-2023 MotionMrDave@gmail.com
+ *
+*/
+#ifndef _INCLUDE_PIC_WRITER_HPP_
+#define _INCLUDE_PIC_WRITER_HPP_
+
+    struct ctx_picwrt;
+
+    /* A picture waiting to be encoded and written by the writer threads */
+    struct ctx_picwrt_item {
+        ctx_dev             *cam;
+        char                file_nm[PATH_MAX];
+        int                 ftype;
+        std::string         picture_type;   /* picture_type and picture_quality when queued */
+        int                 quality;
+        bool                denied;         /* Access to the target directory was denied */
+        unsigned char       *image;         /* Private copy of the image */
+        int                 width;
+        int                 height;
+        unsigned char       *jpeg_data;     /* Copy of the jpeg already compressed for a stream */
+        int                 jpeg_size;
+        unsigned char       *exif;          /* EXIF data prepared on the camera thread */
+        unsigned            exif_len;
+        ctx_image_data      img_data;       /* Image info used for the conversion specifiers */
+        struct timespec     ts1;
+    };
+
+    /* Each camera is always assigned to the same worker so its pictures stay in order */
+    struct ctx_picwrt_worker {
+        ctx_picwrt                      *picwrt;
+        int                             indx;
+        pthread_t                       thread_id;
+        volatile bool                   thread_running;
+        std::list<ctx_picwrt_item *>    queue;
+        ctx_picwrt_item                 *active;        /* Item currently being written */
+    };
+
+    struct ctx_picwrt {
+        int                             thread_cnt;
+        int                             queue_max;
+        ctx_picwrt_worker               *workers;
+        std::list<ctx_picwrt_item *>    done;           /* Written items waiting for the camera thread */
+        pthread_mutex_t                 mutex;
+        pthread_cond_t                  cond_work;      /* Signaled when items are queued or on shutdown */
+        pthread_cond_t                  cond_space;     /* Signaled when an item has been written */
+        volatile bool                   closing;
+
+        int                             queue_depth;    /* Items queued or being written */
+        int                             queue_peak;
+        uint64_t                        stall_cnt;      /* Times the camera thread waited on a full queue */
+        uint64_t                        write_cnt;
+    };
+
+    void picwrt_init(ctx_motapp *motapp);
+    void picwrt_deinit(ctx_motapp *motapp);
+    void picwrt_save_norm(ctx_dev *cam, char *file, unsigned char *image
+        , int ftype, struct timespec *ts1);
+    void picwrt_save_roi(ctx_dev *cam, char *file, unsigned char *image
+        , struct timespec *ts1);
+    void picwrt_process(ctx_dev *cam);
+    void picwrt_flush(ctx_dev *cam);
+
+#endif /* _INCLUDE_PIC_WRITER_HPP_ */
@@ -25,6 +25,7 @@
 #include "event.hpp"
 #include "exif.hpp"
 #include "draw.hpp"
+#include "webu_stream.hpp"
 
 #ifdef HAVE_WEBP
     #include <webp/encode.h>
@@ -39,13 +40,9 @@
  * It must be called after WebPEncode() and the result
  * can then be written out to webp a file
  */
-static void pic_webp_exif(WebPMux* webp_mux, ctx_dev *cam,
-        const struct timespec *ts1, ctx_coord *box)
+static void pic_webp_exif(WebPMux* webp_mux, unsigned char *exif, unsigned exif_len)
 {
-    unsigned char *exif = NULL;
-    unsigned exif_len = exif_prepare(&exif, cam, ts1, box);
-
-    if(exif_len > 0) {
+    if ((exif != NULL) && (exif_len > 0)) {
         WebPData webp_exif;
         /* EXIF in WEBP does not need the EXIF marker signature (6 bytes) that are needed by jpeg */
         webp_exif.bytes = exif + 6;
@@ -56,7 +53,6 @@ static void pic_webp_exif(WebPMux* webp_mux, ctx_dev *cam,
             MOTPLS_LOG(ERR, TYPE_CORE, NO_ERRNO
                 , _("Unable to set set EXIF to webp chunk"));
         }
-        free(exif);
     }
 }
 #endif /* HAVE_WEBP */
@@ -65,7 +61,7 @@ static void pic_webp_exif(WebPMux* webp_mux, ctx_dev *cam,
 
 /** Save image as webp to file */
 static void pic_save_webp(FILE *fp, unsigned char *image, int width, int height,
-        int quality, ctx_dev *cam, struct timespec *ts1, ctx_coord *box)
+        int quality, unsigned char *exif, unsigned exif_len)
 {
     #ifdef HAVE_WEBP
         /* Create a config present and check for compatible library version */
@@ -112,7 +108,7 @@ static void pic_save_webp(FILE *fp, unsigned char *image, int width, int height,
 
         /* Create a mux from the prepared image data */
         WebPMux* webp_mux = WebPMuxCreate(&webp_bitstream, 1);
-        pic_webp_exif(webp_mux, cam, ts1, box);
+        pic_webp_exif(webp_mux, exif, exif_len);
 
         /* Add Exif data to the webp image data */
         WebPData webp_output;
@@ -146,16 +142,15 @@ static void pic_save_webp(FILE *fp, unsigned char *image, int width, int height,
         (void)width;
         (void)height;
         (void) quality;
-        (void)cam;
-        (void)ts1;
-        (void)box;
+        (void)exif;
+        (void)exif_len;
     #endif /* HAVE_WEBP */
 }
 
 
 /** Save image as yuv420p jpeg to file */
 static void pic_save_yuv420p(FILE *fp, unsigned char *image, int width, int height,
-        int quality, ctx_dev *cam, struct timespec *ts1, ctx_coord *box)
+        int quality, unsigned char *exif, unsigned exif_len)
 {
 
     int sz, image_size;
@@ -163,7 +158,7 @@ static void pic_save_yuv420p(FILE *fp, unsigned char *image, int width, int heig
     image_size = (width * height * 3)/2;
     unsigned char *buf =(unsigned char*) mymalloc(image_size);
 
-    sz = jpgutl_put_yuv420p(buf, image_size, image, width, height, quality, cam ,ts1, box);
+    sz = jpgutl_put_yuv420p(buf, image_size, image, width, height, quality, exif, exif_len);
     fwrite(buf, sz, 1, fp);
 
     free(buf);
@@ -172,7 +167,7 @@ static void pic_save_yuv420p(FILE *fp, unsigned char *image, int width, int heig
 
 /** Save image as grey jpeg to file */
 static void pic_save_grey(FILE *picture, unsigned char *image, int width, int height,
-        int quality, ctx_dev *cam, struct timespec *ts1, ctx_coord *box)
+        int quality, unsigned char *exif, unsigned exif_len)
 {
 
     int sz, image_size;
@@ -181,7 +176,7 @@ static void pic_save_grey(FILE *picture, unsigned char *image, int width, int he
 
     unsigned char *buf =(unsigned char*) mymalloc(image_size);
 
-    sz = jpgutl_put_grey(buf, image_size, image, width, height, quality, cam ,ts1, box);
+    sz = jpgutl_put_grey(buf, image_size, image, width, height, quality, exif, exif_len);
     fwrite(buf, sz, 1, picture);
 
     free(buf);
@@ -253,123 +248,364 @@ static void pic_save_ppm(FILE *picture, unsigned char *image, int width, int hei
 }
 
 
+/* Allocate the jpeg cache for the camera */
+void pic_cache_init(ctx_dev *cam)
+{
+    int indx;
+
+    for (indx = 0; indx < PIC_CACHE_MAX; indx++) {
+        cam->pic_cache.items[indx].image = NULL;
+        cam->pic_cache.items[indx].jpeg_data = NULL;
+        cam->pic_cache.items[indx].jpeg_size = 0;
+        cam->pic_cache.items[indx].jpeg_alloc = 0;
+    }
+    cam->pic_cache.item_cnt = 0;
+}
+
+/* Free the jpeg cache for the camera */
+void pic_cache_deinit(ctx_dev *cam)
+{
+    int indx;
+
+    for (indx = 0; indx < PIC_CACHE_MAX; indx++) {
+        myfree(&cam->pic_cache.items[indx].jpeg_data);
+        cam->pic_cache.items[indx].jpeg_alloc = 0;
+    }
+    cam->pic_cache.item_cnt = 0;
+}
+
+/* Discard the jpeg images of the prior frame.  The buffers are kept for reuse */
+void pic_cache_reset(ctx_dev *cam)
+{
+    cam->pic_cache.item_cnt = 0;
+}
+
+/* Find the jpeg compressed from the image on the current frame */
+ctx_pic_cache_item *pic_cache_find(ctx_dev *cam, unsigned char *image
+        , int width, int height, int quality, bool grey)
+{
+    int indx;
+    ctx_pic_cache_item *item;
+
+    for (indx = 0; indx < cam->pic_cache.item_cnt; indx++) {
+        item = &cam->pic_cache.items[indx];
+        if ((item->image == image) && (item->width == width) &&
+            (item->height == height) && (item->quality == quality) &&
+            (item->grey == grey)) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+/* Remove the image from the cache when its contents change during the frame */
+void pic_cache_drop(ctx_dev *cam, unsigned char *image)
+{
+    int indx;
+
+    for (indx = 0; indx < cam->pic_cache.item_cnt; indx++) {
+        if (cam->pic_cache.items[indx].image == image) {
+            cam->pic_cache.items[indx].image = NULL;
+        }
+    }
+}
+
+/* Get the jpeg for the image on the current frame, compressing it if needed */
+ctx_pic_cache_item *pic_cache_get(ctx_dev *cam, unsigned char *image
+        , int width, int height, int quality, bool grey)
+{
+    ctx_pic_cache_item *item;
+    int jpeg_alloc;
+
+    item = pic_cache_find(cam, image, width, height, quality, grey);
+    if (item != NULL) {
+        return item;
+    }
+
+    /* When full, the last item is replaced rather than compressing every time */
+    if (cam->pic_cache.item_cnt < PIC_CACHE_MAX) {
+        item = &cam->pic_cache.items[cam->pic_cache.item_cnt];
+        cam->pic_cache.item_cnt++;
+    } else {
+        item = &cam->pic_cache.items[PIC_CACHE_MAX - 1];
+    }
+
+    jpeg_alloc = (width * height * 3) / 2;
+    if (item->jpeg_alloc < jpeg_alloc) {
+        myfree(&item->jpeg_data);
+        item->jpeg_data = (unsigned char*)mymalloc(jpeg_alloc);
+        item->jpeg_alloc = jpeg_alloc;
+    }
+
+    item->image = image;
+    item->width = width;
+    item->height = height;
+    item->quality = quality;
+    item->grey = grey;
+    if (grey) {
+        item->jpeg_size = jpgutl_put_grey(item->jpeg_data, item->jpeg_alloc
+            , image, width, height, quality, NULL, 0);
+    } else {
+        item->jpeg_size = jpgutl_put_yuv420p(item->jpeg_data, item->jpeg_alloc
+            , image, width, height, quality, NULL, 0);
+    }
+
+    if (item->jpeg_size <= 0) {
+        /* Do not keep the failed image around to be found again */
+        item->image = NULL;
+        return NULL;
+    }
+
+    return item;
+}
+
+/* Get the jpeg for a picture when a stream has or will compress the same image */
+ctx_pic_cache_item *pic_cache_save(ctx_dev *cam, unsigned char *image
+        , int width, int height, int ftype)
+{
+    ctx_pic_cache_item *item;
+    bool grey;
+
+    if ((ftype == FTYPE_IMAGE_ROI) ||
+        (cam->conf->picture_type == "ppm") ||
+        (cam->conf->picture_type == "webp")) {
+        return NULL;
+    }
+    grey = (cam->conf->picture_type == "grey");
+
+    item = pic_cache_find(cam, image, width, height
+        , cam->conf->picture_quality, grey);
+    if ((item == NULL) &&
+        webu_stream_wanted(cam, image, width, height
+            , cam->conf->picture_quality, grey)) {
+        item = pic_cache_get(cam, image, width, height
+            , cam->conf->picture_quality, grey);
+    }
+
+    return item;
+}
+
 /** Put picture into memory as jpg */
 int pic_put_memory(ctx_dev *cam, unsigned char* dest_image, int image_size
         , unsigned char *image, int quality, int width, int height)
 {
     struct timespec ts1;
+    ctx_pic_cache_item *item;
+    unsigned char *exif = NULL;
+    unsigned exif_len;
+    int retcd;
 
-    clock_gettime(CLOCK_REALTIME, &ts1);
-    if (!cam->conf->stream_grey) {
-        return jpgutl_put_yuv420p(dest_image, image_size, image,
-                                width, height, quality, cam ,&ts1, NULL);
-    } else {
-        return jpgutl_put_grey(dest_image, image_size, image,
-                                width, height, quality, cam,&ts1, NULL);
+    item = pic_cache_get(cam, image, width, height, quality, cam->conf->stream_grey);
+    if (item == NULL) {
+        return -1;
     }
 
-    return 0;
+    clock_gettime(CLOCK_REALTIME, &ts1);
+    exif_len = exif_prepare(&exif, cam, &ts1, NULL);
+
+    retcd = jpgutl_insert_exif(dest_image, image_size
+        , item->jpeg_data, item->jpeg_size, exif, exif_len);
+
+    free(exif);
+
+    return retcd;
 }
 
 /* Write the picture to a file */
-static void pic_write(ctx_dev *cam, FILE *picture, unsigned char *image, int quality, int ftype)
+static void pic_write(FILE *picture, unsigned char *image
+        , int width, int height, const std::string &picture_type, int quality
+        , int ftype, unsigned char *exif, unsigned exif_len)
+{
+    if (ftype == FTYPE_IMAGE_ROI) {
+        pic_save_grey(picture, image, width, height, quality, exif, exif_len);
+    } else if (picture_type == "ppm") {
+        pic_save_ppm(picture, image, width, height);
+    } else if (picture_type == "webp") {
+        pic_save_webp(picture, image, width, height, quality, exif, exif_len);
+    } else if (picture_type == "grey") {
+        pic_save_grey(picture, image, width, height, quality, exif, exif_len);
+    } else {
+        pic_save_yuv420p(picture, image, width, height, quality, exif, exif_len);
+    }
+}
+
+/* Get the dimensions of the image that is saved for the file type */
+void pic_save_size(ctx_dev *cam, int ftype, int *width, int *height)
 {
-    int width, height;
     int passthrough;
 
     passthrough = mycheck_passthrough(cam);
     if (((ftype == FTYPE_IMAGE) || (ftype == FTYPE_IMAGE_SNAPSHOT)) &&
          (cam->imgs.size_high > 0) && (!passthrough)) {
-        width = cam->imgs.width_high;
-        height = cam->imgs.height_high;
+        *width = cam->imgs.width_high;
+        *height = cam->imgs.height_high;
     } else {
-        width = cam->imgs.width;
-        height = cam->imgs.height;
+        *width = cam->imgs.width;
+        *height = cam->imgs.height;
     }
+}
 
-    if (cam->conf->picture_type == "ppm") {
-        pic_save_ppm(picture, image, width, height);
-    } else if (cam->conf->picture_type == "webp") {
-        pic_save_webp(picture, image, width, height, quality, cam
-            , &(cam->current_image->imgts), &(cam->current_image->location));
-    } else if (cam->conf->picture_type == "grey") {
-        pic_save_grey(picture, image, width, height, quality, cam
-            , &(cam->current_image->imgts), &(cam->current_image->location));
-    } else {
-        pic_save_yuv420p(picture, image, width, height, quality, cam
-            , &(cam->current_image->imgts), &(cam->current_image->location));
+/* Prepare the EXIF data for the picture unless the picture type does not use it */
+unsigned pic_save_exif(ctx_dev *cam, unsigned char **exif, int ftype
+        , struct timespec *ts1, ctx_coord *box)
+{
+    *exif = NULL;
+    if ((ftype != FTYPE_IMAGE_ROI) && (cam->conf->picture_type == "ppm")) {
+        return 0;
     }
+    return exif_prepare(exif, cam, ts1, box);
 }
 
-/* Saves image to a file in format requested */
-void pic_save_norm(ctx_dev *cam, char *file, unsigned char *image, int ftype)
+/* Copy the region of interest out of the image.  Returns NULL if too small */
+unsigned char *pic_save_roi_img(ctx_dev *cam, unsigned char *image, ctx_coord *bx)
+{
+    int indxh;
+    unsigned char *img;
+
+    if ((bx->width <64) || (bx->height <64)) {
+        return NULL;
+    }
+
+    img =(unsigned char*) mymalloc(bx->width * bx->height);
+
+    for (indxh=bx->miny; indxh< bx->miny + bx->height; indxh++){
+        memcpy(img+((indxh - bx->miny)* bx->width), image+(indxh*cam->imgs.width) + bx->minx, bx->width);
+    }
+
+    return img;
+}
+
+/* Open the picture file reporting any errors.  Access errors to the target
+ * directory are fatal for the camera so they are returned in denied and the
+ * camera thread finishes the camera.
+ */
+static FILE *pic_open_file(char *file, int ftype, bool *denied)
 {
     FILE *picture;
 
+    *denied = false;
     picture = myfopen(file, "wbe");
     if (!picture) {
         /* Report to syslog - suggest solution if the problem is access rights to target dir. */
-        if (errno ==  EACCES) {
+        if ((errno ==  EACCES) && (ftype != FTYPE_IMAGE_ROI)) {
             MOTPLS_LOG(ERR, TYPE_ALL, SHOW_ERRNO
                 ,_("Can't write picture to file %s - check access rights to target directory\n"
                 "Thread is going to finish due to this fatal error"), file);
-            cam->finish_dev = true;
-            cam->restart_dev = false;
-            return;
+            *denied = true;
         } else {
             /* If target dir is temporarily unavailable we may survive. */
             MOTPLS_LOG(ERR, TYPE_ALL, SHOW_ERRNO
                 ,_("Can't write picture to file %s"), file);
-            return;
         }
     }
 
-    pic_write(cam, picture, image, cam->conf->picture_quality, ftype);
+    return picture;
+}
+
+/* Saves the prepared image and EXIF data to a file in format requested.
+ * Only the arguments are used so it can run on the writer threads.
+ */
+void pic_save_file(char *file, unsigned char *image, int width, int height
+        , const std::string &picture_type, int quality, int ftype
+        , unsigned char *exif, unsigned exif_len, bool *denied)
+{
+    FILE *picture;
+
+    picture = pic_open_file(file, ftype, denied);
+    if (picture == NULL) {
+        return;
+    }
+
+    pic_write(picture, image, width, height
+        , picture_type, quality, ftype, exif, exif_len);
 
     myfclose(picture);
 }
 
-/* Saves image to a file in format requested */
-void pic_save_roi(ctx_dev *cam, char *file, unsigned char *image)
+/* Saves a jpeg that was already compressed along with the EXIF data to a file */
+void pic_save_jpeg(char *file, unsigned char *jpeg_data, int jpeg_size
+        , int ftype, unsigned char *exif, unsigned exif_len, bool *denied)
 {
     FILE *picture;
-    int image_size, sz, indxh;
-    ctx_coord *bx;
-    unsigned char *buf, *img;
+    unsigned char *buf;
+    int buf_size, sz;
 
-    bx = &cam->current_image->location;
-
-    if ((bx->width <64) || (bx->height <64)) {
+    picture = pic_open_file(file, ftype, denied);
+    if (picture == NULL) {
         return;
     }
 
-    picture = myfopen(file, "wbe");
-    if (!picture) {
-        MOTPLS_LOG(ERR, TYPE_ALL, SHOW_ERRNO
-            ,_("Can't write picture to file %s"), file);
-        return;
+    buf_size = jpeg_size + (int)exif_len + 4;
+    buf =(unsigned char*) mymalloc(buf_size);
+
+    sz = jpgutl_insert_exif(buf, buf_size, jpeg_data, jpeg_size, exif, exif_len);
+    if (sz > 0) {
+        fwrite(buf, sz, 1, picture);
+    } else {
+        MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
+            ,_("Unable to add EXIF data to picture %s"), file);
     }
 
-    image_size = bx->width * bx->height;
+    free(buf);
+
+    myfclose(picture);
+}
 
-    buf =(unsigned char*) mymalloc(image_size);
-    img =(unsigned char*) mymalloc(image_size);
+/* Saves image to a file in format requested */
+void pic_save_norm(ctx_dev *cam, char *file, unsigned char *image, int ftype)
+{
+    int width, height;
+    unsigned char *exif;
+    unsigned exif_len;
+    ctx_pic_cache_item *item;
+    bool denied;
 
-    for (indxh=bx->miny; indxh< bx->miny + bx->height; indxh++){
-        memcpy(img+((indxh - bx->miny)* bx->width), image+(indxh*cam->imgs.width) + bx->minx, bx->width);
+    pic_save_size(cam, ftype, &width, &height);
+
+    exif_len = pic_save_exif(cam, &exif, ftype
+        , &cam->current_image->imgts, &cam->current_image->location);
+
+    item = pic_cache_save(cam, image, width, height, ftype);
+    if (item != NULL) {
+        pic_save_jpeg(file, item->jpeg_data, item->jpeg_size
+            , ftype, exif, exif_len, &denied);
+    } else {
+        pic_save_file(file, image, width, height
+            , cam->conf->picture_type, cam->conf->picture_quality
+            , ftype, exif, exif_len, &denied);
+    }
+    if (denied) {
+        cam->finish_dev = true;
+        cam->restart_dev = false;
     }
 
-    sz = jpgutl_put_grey(buf, image_size, img
-        , bx->width, bx->height
-        ,cam->conf->picture_quality, cam
-        ,&(cam->current_image->imgts), bx);
+    free(exif);
+}
 
-    fwrite(buf, sz, 1, picture);
+/* Saves image to a file in format requested */
+void pic_save_roi(ctx_dev *cam, char *file, unsigned char *image)
+{
+    ctx_coord *bx;
+    unsigned char *img, *exif;
+    unsigned exif_len;
+    bool denied;
 
-    free(buf);
-    free(img);
+    bx = &cam->current_image->location;
 
-    myfclose(picture);
+    img = pic_save_roi_img(cam, image, bx);
+    if (img == NULL) {
+        return;
+    }
+
+    exif_len = pic_save_exif(cam, &exif, FTYPE_IMAGE_ROI
+        , &cam->current_image->imgts, bx);
+
+    pic_save_file(file, img, bx->width, bx->height
+        , cam->conf->picture_type, cam->conf->picture_quality
+        , FTYPE_IMAGE_ROI, exif, exif_len, &denied);
+
+    free(exif);
+    free(img);
 }
 
 /** Get the pgm file used as fixed mask */
@@ -486,11 +722,11 @@ static void pic_write_mask(ctx_dev *cam, const char *file)
 
     /* Write pgm-header. */
     fprintf(picture, "P5\n");
-    fprintf(picture, "%d %d\n", cam->conf->width, cam->conf->height);
+    fprintf(picture, "%d %d\n", cam->imgs.width, cam->imgs.height);
     fprintf(picture, "%d\n", 255);
 
     /* Write pgm image data at once. */
-    if ((int)fwrite(cam->imgs.image_motion.image_norm, cam->conf->width, cam->conf->height, picture) != cam->conf->height) {
+    if ((int)fwrite(cam->imgs.image_motion.image_norm, cam->imgs.width, cam->imgs.height, picture) != cam->imgs.height) {
         MOTPLS_LOG(ERR, TYPE_ALL, SHOW_ERRNO
             ,_("Failed writing default mask as pgm file"));
         return;
@@ -503,24 +739,138 @@ static void pic_write_mask(ctx_dev *cam, const char *file)
         "re-run motion to enable mask feature"), cam->conf->mask_file.c_str());
 }
 
+/* Average each 2x2 block of the source plane into one pixel of the destination */
+static void pic_scale_plane(unsigned char *src, int width_src
+        , unsigned char *dst, int width_dst, int height_dst)
+{
+    int x, y;
+    unsigned char *row0, *row1;
+
+    for (y = 0; y < height_dst; y++) {
+        row0 = src + (y * 2 * width_src);
+        row1 = row0 + width_src;
+        for (x = 0; x < width_dst; x++) {
+            dst[x] = (unsigned char)((row0[x * 2] + row0[(x * 2) + 1] +
+                row1[x * 2] + row1[(x * 2) + 1] + 2) >> 2);
+        }
+        dst += width_dst;
+    }
+}
+
+/*
+ * Scale the yuv420p image to half size with a box filter.  The destination
+ * width and height are rounded down to even values so the chroma planes
+ * remain half of the luma plane.
+ */
 void pic_scale_img(int width_src, int height_src, unsigned char *img_src, unsigned char *img_dst)
 {
+    int width_dst, height_dst;
+    unsigned char *src_u, *src_v, *dst_u, *dst_v;
 
-    int i = 0, x, y;
-    for (y = 0; y < height_src; y+=2)
-        for (x = 0; x < width_src; x+=2)
-            img_dst[i++] = img_src[y * width_src + x];
+    width_dst = (width_src / 2) & ~1;
+    height_dst = (height_src / 2) & ~1;
 
-    for (y = 0; y < height_src / 2; y+=2)
-       for (x = 0; x < width_src; x += 4)
-       {
-          img_dst[i++] = img_src[(width_src * height_src) + (y * width_src) + x];
-          img_dst[i++] = img_src[(width_src * height_src) + (y * width_src) + (x + 1)];
-       }
+    src_u = img_src + (width_src * height_src);
+    src_v = src_u + ((width_src / 2) * (height_src / 2));
+    dst_u = img_dst + (width_dst * height_dst);
+    dst_v = dst_u + ((width_dst / 2) * (height_dst / 2));
+
+    pic_scale_plane(img_src, width_src, img_dst, width_dst, height_dst);
+    pic_scale_plane(src_u, width_src / 2, dst_u, width_dst / 2, height_dst / 2);
+    pic_scale_plane(src_v, width_src / 2, dst_v, width_dst / 2, height_dst / 2);
 
     return;
 }
 
+/* Allocate the scaled images for the camera */
+void pic_scale_init(ctx_dev *cam)
+{
+    int indx, width, height;
+
+    width = cam->imgs.width;
+    height = cam->imgs.height;
+
+    cam->pic_scale.src = NULL;
+    cam->pic_scale.level_cnt = 0;
+    cam->pic_scale.level_max = 0;
+    for (indx = 0; indx < PIC_SCALE_MAX; indx++) {
+        width = (width / 2) & ~1;
+        height = (height / 2) & ~1;
+        cam->pic_scale.width[indx] = width;
+        cam->pic_scale.height[indx] = height;
+        cam->pic_scale.image[indx] = NULL;
+        if ((width >= 16) && (height >= 16)) {
+            /* The jpeg compression may read up to a block past the end of the last row */
+            cam->pic_scale.image[indx] =(unsigned char*)
+                mymalloc(((width * height * 3) / 2) + 64);
+            cam->pic_scale.level_max = indx + 1;
+        }
+    }
+}
+
+/* Free the scaled images for the camera */
+void pic_scale_deinit(ctx_dev *cam)
+{
+    int indx;
+
+    for (indx = 0; indx < PIC_SCALE_MAX; indx++) {
+        myfree(&cam->pic_scale.image[indx]);
+    }
+    cam->pic_scale.src = NULL;
+    cam->pic_scale.level_cnt = 0;
+    cam->pic_scale.level_max = 0;
+}
+
+/* Discard the scaled images of the prior frame */
+void pic_scale_reset(ctx_dev *cam)
+{
+    cam->pic_scale.src = NULL;
+    cam->pic_scale.level_cnt = 0;
+}
+
+/*
+ * Get the image scaled down by 2^level.  Each level is built once per frame
+ * from the level above it.  When the requested level is too small, the
+ * smallest level is returned and when there are no levels, the image itself.
+ */
+unsigned char *pic_scale_get(ctx_dev *cam, unsigned char *image, int level
+        , int *width, int *height)
+{
+    int indx;
+
+    if (level > cam->pic_scale.level_max) {
+        level = cam->pic_scale.level_max;
+    }
+    if (level <= 0) {
+        *width = cam->imgs.width;
+        *height = cam->imgs.height;
+        return image;
+    }
+
+    if (cam->pic_scale.src != image) {
+        cam->pic_scale.src = image;
+        cam->pic_scale.level_cnt = 0;
+    }
+
+    for (indx = cam->pic_scale.level_cnt; indx < level; indx++) {
+        if (indx == 0) {
+            pic_scale_img(cam->imgs.width, cam->imgs.height
+                , image, cam->pic_scale.image[0]);
+        } else {
+            pic_scale_img(cam->pic_scale.width[indx - 1], cam->pic_scale.height[indx - 1]
+                , cam->pic_scale.image[indx - 1], cam->pic_scale.image[indx]);
+        }
+        /* Any jpeg of the level was compressed from a different image */
+        pic_cache_drop(cam, cam->pic_scale.image[indx]);
+        cam->pic_scale.level_cnt = indx + 1;
+    }
+
+    *width = cam->pic_scale.width[level - 1];
+    *height = cam->pic_scale.height[level - 1];
+
+    return cam->pic_scale.image[level - 1];
+}
+
 void pic_save_preview(ctx_dev *cam, ctx_image_data *img)
 {
     unsigned char *image_norm, *image_high;
@@ -21,13 +21,39 @@
 #define _INCLUDE_PICTURE_HPP_
 
     struct ctx_dev;
+    struct ctx_coord;
+    struct ctx_pic_cache_item;
 
     int pic_put_memory(struct ctx_dev *cam, unsigned char* dest_image
         , int image_size, unsigned char *image, int quality, int width, int height);
     void pic_save_norm(struct ctx_dev *cam, char *file, unsigned char *image, int ftype);
     void pic_save_roi(struct ctx_dev *cam, char *file, unsigned char *image);
+    void pic_save_size(struct ctx_dev *cam, int ftype, int *width, int *height);
+    unsigned pic_save_exif(struct ctx_dev *cam, unsigned char **exif, int ftype
+        , struct timespec *ts1, struct ctx_coord *box);
+    unsigned char *pic_save_roi_img(struct ctx_dev *cam, unsigned char *image, struct ctx_coord *bx);
+    void pic_save_file(char *file, unsigned char *image, int width, int height
+        , const std::string &picture_type, int quality, int ftype
+        , unsigned char *exif, unsigned exif_len, bool *denied);
+    void pic_save_jpeg(char *file, unsigned char *jpeg_data, int jpeg_size
+        , int ftype, unsigned char *exif, unsigned exif_len, bool *denied);
+    void pic_cache_init(struct ctx_dev *cam);
+    void pic_cache_deinit(struct ctx_dev *cam);
+    void pic_cache_reset(struct ctx_dev *cam);
+    void pic_cache_drop(struct ctx_dev *cam, unsigned char *image);
+    struct ctx_pic_cache_item *pic_cache_save(struct ctx_dev *cam, unsigned char *image
+        , int width, int height, int ftype);
+    struct ctx_pic_cache_item *pic_cache_find(struct ctx_dev *cam, unsigned char *image
+        , int width, int height, int quality, bool grey);
+    struct ctx_pic_cache_item *pic_cache_get(struct ctx_dev *cam, unsigned char *image
+        , int width, int height, int quality, bool grey);
     unsigned char *pic_load_pgm(FILE *picture, int width, int height);
     void pic_scale_img(int width_src, int height_src, unsigned char *img_src, unsigned char *img_dst);
+    void pic_scale_init(struct ctx_dev *cam);
+    void pic_scale_deinit(struct ctx_dev *cam);
+    void pic_scale_reset(struct ctx_dev *cam);
+    unsigned char *pic_scale_get(struct ctx_dev *cam, unsigned char *image, int level
+        , int *width, int *height);
     void pic_save_preview(struct ctx_dev *cam, struct ctx_image_data *img);
     void pic_init_privacy(struct ctx_dev *cam);
     void pic_init_mask(struct ctx_dev *cam);
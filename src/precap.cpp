@@ -0,0 +1,433 @@
+/*
+ *    This file is part of MotionPlus.
+ *
+ *    MotionPlus is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    MotionPlus is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with MotionPlus.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *    Copyright 2020-2023 MotionMrDave@gmail.com
+ *
+ */
+
+/*
+ * precap.cpp
+ *   Compressed storage for the image ring when pre_capture_compress is set.
+ *   Only a few uncompressed image sets are allocated and they are attached
+ *   to the ring items as needed.  The image of the current frame is always
+ *   uncompressed.  When the next frame starts, the prior image is handed to
+ *   a thread for the camera that compresses it as a jpeg and then returns
+ *   the uncompressed set.  The jpeg is only decompressed when the ring is
+ *   processed for an event.
+ */
+
+#include "motionplus.hpp"
+#include "conf.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+#include "jpegutils.hpp"
+#include "precap.hpp"
+
+/* Get a free uncompressed set.  Waits for the thread when all are in use */
+static int precap_raw_get(ctx_precap *precap)
+{
+    int indx;
+    bool waited;
+
+    /* The mutex is held by the caller */
+    waited = false;
+    while (true) {
+        for (indx = 0; indx < PRECAP_RAW_CNT; indx++) {
+            if (precap->raw_used[indx] == false) {
+                precap->raw_used[indx] = true;
+                return indx;
+            }
+        }
+        if (waited == false) {
+            precap->stall_cnt++;
+            waited = true;
+        }
+        pthread_cond_wait(&precap->cond_done, &precap->mutex);
+    }
+}
+
+/* Attach the uncompressed set to the ring item */
+static void precap_attach(ctx_precap *precap, int indx, int raw_indx)
+{
+    precap->items[indx].raw_indx = raw_indx;
+    precap->cam->imgs.image_ring[indx].image_norm = precap->raw_norm[raw_indx];
+    precap->cam->imgs.image_ring[indx].image_high = precap->raw_high[raw_indx];
+}
+
+/* Remove the uncompressed set from the ring item and make it available */
+static void precap_detach(ctx_precap *precap, int indx)
+{
+    if (precap->items[indx].raw_indx != -1) {
+        precap->raw_used[precap->items[indx].raw_indx] = false;
+        precap->items[indx].raw_indx = -1;
+    }
+    precap->cam->imgs.image_ring[indx].image_norm = NULL;
+    precap->cam->imgs.image_ring[indx].image_high = NULL;
+}
+
+/* Copy the jpeg from the work buffer to the ring item.  The buffer of the
+ * item is only grown so it settles at the size of the largest jpeg it held.
+ */
+static void precap_keep(unsigned char **jpeg, int *jpeg_alloc
+        , unsigned char *work, int jpeg_size)
+{
+    if (jpeg_size <= 0) {
+        return;
+    }
+    if (*jpeg_alloc < jpeg_size) {
+        *jpeg = (unsigned char*)myrealloc(*jpeg, jpeg_size, "precap_keep");
+        *jpeg_alloc = jpeg_size;
+    }
+    memcpy(*jpeg, work, jpeg_size);
+}
+
+/* Compression thread for the camera */
+static void *precap_handler(void *arg)
+{
+    ctx_precap *precap = (ctx_precap *)arg;
+    ctx_dev *cam = precap->cam;
+    ctx_precap_item *item;
+    int indx, raw_indx, size_norm, size_high;
+
+    mythreadname_set("pc", cam->threadnr, cam->conf->device_name.c_str());
+
+    pthread_mutex_lock(&precap->mutex);
+    while (true) {
+        while ((precap->queue.empty()) && (precap->closing == false)) {
+            pthread_cond_wait(&precap->cond_work, &precap->mutex);
+        }
+        if (precap->closing) {
+            break;
+        }
+        indx = precap->queue.front();
+        precap->queue.pop_front();
+        item = &precap->items[indx];
+        /* The camera thread took the image back before it was compressed */
+        if (item->state != PRECAP_QUEUED) {
+            continue;
+        }
+        precap->active = indx;
+        raw_indx = item->raw_indx;
+        pthread_mutex_unlock(&precap->mutex);
+
+        size_norm = jpgutl_put_yuv420p(precap->work_norm, precap->work_alloc_norm
+            , precap->raw_norm[raw_indx], cam->imgs.width, cam->imgs.height
+            , precap->quality, NULL, 0);
+        size_high = 0;
+        if (precap->raw_high[raw_indx] != NULL) {
+            size_high = jpgutl_put_yuv420p(precap->work_high, precap->work_alloc_high
+                , precap->raw_high[raw_indx], cam->imgs.width_high, cam->imgs.height_high
+                , precap->quality, NULL, 0);
+        }
+
+        /* The camera thread waits while the item is active so the
+         * jpeg buffers of the item can be changed without the lock.
+         */
+        precap_keep(&item->jpeg_norm, &item->jpeg_norm_alloc
+            , precap->work_norm, size_norm);
+        precap_keep(&item->jpeg_high, &item->jpeg_high_alloc
+            , precap->work_high, size_high);
+
+        pthread_mutex_lock(&precap->mutex);
+        precap->active = -1;
+        if (item->state == PRECAP_QUEUED) {
+            item->jpeg_norm_size = size_norm;
+            item->jpeg_high_size = size_high;
+            precap_detach(precap, indx);
+            item->state = PRECAP_PACKED;
+            precap->pack_cnt++;
+        }
+        pthread_cond_broadcast(&precap->cond_done);
+    }
+    pthread_mutex_unlock(&precap->mutex);
+
+    precap->thread_running = false;
+
+    pthread_exit(NULL);
+}
+
+/* Decompress the jpeg into the image or use grey when it is not valid */
+static void precap_unpack(unsigned char *jpeg, int jpeg_size
+        , int width, int height, unsigned char *img)
+{
+    if ((jpeg_size <= 0) ||
+        (jpgutl_decode_jpeg(jpeg, jpeg_size, width, height, img) != 0)) {
+        memset(img, 0x80, (width * height * 3) / 2);
+    }
+}
+
+/* Allocate the compressed ring and start the compression thread */
+void precap_init(ctx_dev *cam)
+{
+    ctx_precap *precap;
+    pthread_attr_t thread_attr;
+    int indx, retcd;
+
+    cam->precap = NULL;
+
+    if (cam->conf->pre_capture_compress == 0) {
+        return;
+    }
+
+    precap = new ctx_precap;
+    precap->cam = cam;
+    precap->quality = cam->conf->pre_capture_compress;
+    precap->ring_size = cam->imgs.ring_size;
+    precap->active = -1;
+    precap->closing = false;
+    precap->pack_cnt = 0;
+    precap->unpack_cnt = 0;
+    precap->stall_cnt = 0;
+
+    /* Only the work buffers of the thread are sized for the worst case.
+     * A jpeg of noisy images at a high quality can be larger than the
+     * uncompressed image so they have twice its size.
+     */
+    precap->work_alloc_norm = (cam->imgs.size_norm * 2) + 2048;
+    precap->work_norm =(unsigned char*)mymalloc(precap->work_alloc_norm);
+    precap->work_alloc_high = 0;
+    precap->work_high = NULL;
+    if (cam->imgs.size_high > 0) {
+        precap->work_alloc_high = (cam->imgs.size_high * 2) + 2048;
+        precap->work_high =(unsigned char*)mymalloc(precap->work_alloc_high);
+    }
+
+    precap->items = new ctx_precap_item[precap->ring_size];
+    for (indx = 0; indx < precap->ring_size; indx++) {
+        precap->items[indx].state = PRECAP_EMPTY;
+        precap->items[indx].raw_indx = -1;
+        precap->items[indx].jpeg_norm = NULL;
+        precap->items[indx].jpeg_norm_size = 0;
+        precap->items[indx].jpeg_norm_alloc = 0;
+        precap->items[indx].jpeg_high = NULL;
+        precap->items[indx].jpeg_high_size = 0;
+        precap->items[indx].jpeg_high_alloc = 0;
+        cam->imgs.image_ring[indx].image_norm = NULL;
+        cam->imgs.image_ring[indx].image_high = NULL;
+    }
+
+    for (indx = 0; indx < PRECAP_RAW_CNT; indx++) {
+        precap->raw_norm[indx] =(unsigned char*)mymalloc(cam->imgs.size_norm);
+        memset(precap->raw_norm[indx], 0x80, cam->imgs.size_norm);
+        precap->raw_high[indx] = NULL;
+        if (cam->imgs.size_high > 0) {
+            precap->raw_high[indx] =(unsigned char*)mymalloc(cam->imgs.size_high);
+            memset(precap->raw_high[indx], 0x80, cam->imgs.size_high);
+        }
+        precap->raw_used[indx] = false;
+    }
+
+    pthread_mutex_init(&precap->mutex, NULL);
+    pthread_cond_init(&precap->cond_work, NULL);
+    pthread_cond_init(&precap->cond_done, NULL);
+
+    /* The first item of the ring is the current image */
+    precap->raw_used[0] = true;
+    precap_attach(precap, cam->imgs.ring_in, 0);
+    precap->items[cam->imgs.ring_in].state = PRECAP_RAW;
+
+    cam->precap = precap;
+
+    precap->thread_running = true;
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    retcd = pthread_create(&precap->thread_id, &thread_attr, &precap_handler, precap);
+    pthread_attr_destroy(&thread_attr);
+    if (retcd != 0) {
+        MOTPLS_LOG(ERR, TYPE_ALL, SHOW_ERRNO
+            ,_("Error starting pre capture compression thread.  Images are kept uncompressed"));
+        precap->thread_running = false;
+        precap_deinit(cam);
+        return;
+    }
+
+    MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO
+        ,_("Compressing %d pre capture images at quality %d")
+        , precap->ring_size, precap->quality);
+}
+
+/* Stop the compression thread and free the compressed ring */
+void precap_deinit(ctx_dev *cam)
+{
+    ctx_precap *precap = cam->precap;
+    int indx, waitcnt;
+
+    if (precap == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&precap->mutex);
+        precap->closing = true;
+        pthread_cond_broadcast(&precap->cond_work);
+    pthread_mutex_unlock(&precap->mutex);
+
+    waitcnt = 0;
+    while ((precap->thread_running) && (waitcnt < 1000)) {
+        SLEEP(0,1000000)
+        waitcnt++;
+    }
+
+    /* The ring no longer has any images attached */
+    for (indx = 0; indx < precap->ring_size; indx++) {
+        cam->imgs.image_ring[indx].image_norm = NULL;
+        cam->imgs.image_ring[indx].image_high = NULL;
+    }
+    cam->precap = NULL;
+
+    if (waitcnt == 1000) {
+        /* The thread still references the buffers so they can not be freed */
+        MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
+            ,_("Graceful shutdown of pre capture compression thread failed"));
+        return;
+    }
+
+    MOTPLS_LOG(INF, TYPE_ALL, NO_ERRNO
+        ,_("Pre capture images: %llu compressed, %llu restored, %llu waits")
+        , (unsigned long long)precap->pack_cnt
+        , (unsigned long long)precap->unpack_cnt
+        , (unsigned long long)precap->stall_cnt);
+
+    for (indx = 0; indx < precap->ring_size; indx++) {
+        myfree(&precap->items[indx].jpeg_norm);
+        myfree(&precap->items[indx].jpeg_high);
+    }
+    delete [] precap->items;
+    myfree(&precap->work_norm);
+    myfree(&precap->work_high);
+
+    for (indx = 0; indx < PRECAP_RAW_CNT; indx++) {
+        myfree(&precap->raw_norm[indx]);
+        myfree(&precap->raw_high[indx]);
+    }
+
+    pthread_cond_destroy(&precap->cond_done);
+    pthread_cond_destroy(&precap->cond_work);
+    pthread_mutex_destroy(&precap->mutex);
+
+    delete precap;
+}
+
+/*
+ * Called when the ring moves to the next image.  The prior image is queued
+ * for compression unless it was already saved and the new current image gets
+ * an uncompressed set to capture into.
+ */
+void precap_next(ctx_dev *cam, int indx_prev)
+{
+    ctx_precap *precap = cam->precap;
+    ctx_precap_item *item;
+    int indx;
+
+    if (precap == NULL) {
+        return;
+    }
+
+    indx = cam->imgs.ring_in;
+
+    pthread_mutex_lock(&precap->mutex);
+        item = &precap->items[indx_prev];
+        if (item->state == PRECAP_RAW) {
+            if (cam->imgs.image_ring[indx_prev].flags & IMAGE_SAVED) {
+                precap_detach(precap, indx_prev);
+                item->state = PRECAP_EMPTY;
+            } else {
+                item->state = PRECAP_QUEUED;
+                precap->queue.push_back(indx_prev);
+                pthread_cond_broadcast(&precap->cond_work);
+            }
+        }
+
+        while (precap->active == indx) {
+            pthread_cond_wait(&precap->cond_done, &precap->mutex);
+        }
+        item = &precap->items[indx];
+        if ((item->state == PRECAP_EMPTY) || (item->state == PRECAP_PACKED)) {
+            precap_attach(precap, indx, precap_raw_get(precap));
+        }
+        item->state = PRECAP_RAW;
+    pthread_mutex_unlock(&precap->mutex);
+}
+
+/* Make the uncompressed image of the ring item available for processing */
+void precap_load(ctx_dev *cam, int indx)
+{
+    ctx_precap *precap = cam->precap;
+    ctx_precap_item *item;
+    bool packed;
+
+    if (precap == NULL) {
+        return;
+    }
+
+    item = &precap->items[indx];
+
+    pthread_mutex_lock(&precap->mutex);
+        while (precap->active == indx) {
+            pthread_cond_wait(&precap->cond_done, &precap->mutex);
+        }
+        if (item->state == PRECAP_QUEUED) {
+            /* Still uncompressed so it is taken back from the thread */
+            item->state = PRECAP_RAW;
+            pthread_mutex_unlock(&precap->mutex);
+            return;
+        } else if (item->state == PRECAP_RAW) {
+            pthread_mutex_unlock(&precap->mutex);
+            return;
+        }
+        packed = (item->state == PRECAP_PACKED);
+        precap_attach(precap, indx, precap_raw_get(precap));
+    pthread_mutex_unlock(&precap->mutex);
+
+    /* Only the camera thread changes a packed item so the lock is not needed */
+    if (packed) {
+        precap_unpack(item->jpeg_norm, item->jpeg_norm_size
+            , cam->imgs.width, cam->imgs.height
+            , cam->imgs.image_ring[indx].image_norm);
+        if (cam->imgs.image_ring[indx].image_high != NULL) {
+            precap_unpack(item->jpeg_high, item->jpeg_high_size
+                , cam->imgs.width_high, cam->imgs.height_high
+                , cam->imgs.image_ring[indx].image_high);
+        }
+        precap->unpack_cnt++;
+    } else {
+        memset(cam->imgs.image_ring[indx].image_norm, 0x80, cam->imgs.size_norm);
+        if (cam->imgs.image_ring[indx].image_high != NULL) {
+            memset(cam->imgs.image_ring[indx].image_high, 0x80, cam->imgs.size_high);
+        }
+    }
+
+    pthread_mutex_lock(&precap->mutex);
+        item->state = PRECAP_RAW;
+    pthread_mutex_unlock(&precap->mutex);
+}
+
+/* Release the uncompressed image of a ring item that has been saved */
+void precap_done(ctx_dev *cam, int indx)
+{
+    ctx_precap *precap = cam->precap;
+
+    if ((precap == NULL) || (indx == cam->imgs.ring_in)) {
+        return;
+    }
+
+    pthread_mutex_lock(&precap->mutex);
+        if (precap->items[indx].state == PRECAP_RAW) {
+            precap_detach(precap, indx);
+            precap->items[indx].state = PRECAP_EMPTY;
+            pthread_cond_broadcast(&precap->cond_done);
+        }
+    pthread_mutex_unlock(&precap->mutex);
+}
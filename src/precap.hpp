@@ -0,0 +1,77 @@
+/*
+ *    This file is part of MotionPlus.
+ *
+ *    MotionPlus is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    MotionPlus is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with MotionPlus.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *    Copyright 2020-2023 MotionMrDave@gmail.com
+ *
+*/
+#ifndef _INCLUDE_PRECAP_HPP_
+#define _INCLUDE_PRECAP_HPP_
+
+    #define PRECAP_RAW_CNT    4     /* Uncompressed image sets shared by the ring */
+
+    enum PRECAP_STATE {
+        PRECAP_EMPTY,       /* No image is held */
+        PRECAP_RAW,         /* Uncompressed image is attached to the ring item */
+        PRECAP_QUEUED,      /* Uncompressed image is attached and waiting to be compressed */
+        PRECAP_PACKED       /* Only the compressed image is held */
+    };
+
+    /* Compressed images for one item of the image ring */
+    struct ctx_precap_item {
+        enum PRECAP_STATE   state;
+        int                 raw_indx;       /* Uncompressed set attached to the item or -1 */
+        unsigned char       *jpeg_norm;
+        int                 jpeg_norm_size;
+        int                 jpeg_norm_alloc;    /* Grown to the largest jpeg held by the item */
+        unsigned char       *jpeg_high;
+        int                 jpeg_high_size;
+        int                 jpeg_high_alloc;
+    };
+
+    struct ctx_precap {
+        ctx_dev                 *cam;
+        int                     quality;
+        int                     ring_size;
+        ctx_precap_item         *items;
+        unsigned char           *raw_norm[PRECAP_RAW_CNT];
+        unsigned char           *raw_high[PRECAP_RAW_CNT];
+        bool                    raw_used[PRECAP_RAW_CNT];
+        unsigned char           *work_norm;     /* Jpeg of the thread before it is kept by the item */
+        unsigned char           *work_high;
+        int                     work_alloc_norm;
+        int                     work_alloc_high;
+
+        std::list<int>          queue;          /* Ring items waiting to be compressed */
+        int                     active;         /* Ring item being compressed or -1 */
+        pthread_mutex_t         mutex;
+        pthread_cond_t          cond_work;      /* Signaled when items are queued or on shutdown */
+        pthread_cond_t          cond_done;      /* Signaled when an item is compressed */
+        pthread_t               thread_id;
+        volatile bool           thread_running;
+        volatile bool           closing;
+
+        uint64_t                pack_cnt;
+        uint64_t                unpack_cnt;
+        uint64_t                stall_cnt;      /* Times the camera thread waited for a free set */
+    };
+
+    void precap_init(ctx_dev *cam);
+    void precap_deinit(ctx_dev *cam);
+    void precap_next(ctx_dev *cam, int indx_prev);
+    void precap_load(ctx_dev *cam, int indx);
+    void precap_done(ctx_dev *cam, int indx);
+
+#endif /* _INCLUDE_PRECAP_HPP_ */
@@ -195,8 +195,7 @@ void rotate_init(ctx_dev *cam)
         MOTPLS_LOG(WRN, TYPE_ALL, NO_ERRNO
             ,_("Config option \"rotate\" not a multiple of 90: %d")
             ,cam->conf->rotate);
-        cam->conf->rotate = 0;     /* Disable rotation. */
-        cam->rotate_data->degrees = 0; /* Force return below. */
+        cam->rotate_data->degrees = 0; /* Disable rotation and force return below. */
     } else {
         cam->rotate_data->degrees = cam->conf->rotate % 360; /* Range: 0..359 */
     }
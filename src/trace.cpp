@@ -0,0 +1,222 @@
+/*
+ *    This file is part of MotionPlus.
+ *
+ *    MotionPlus is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    MotionPlus is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with MotionPlus.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *    Copyright 2020-2023 MotionMrDave@gmail.com
+ *
+*/
+
+/*
+ * trace.cpp
+ *   Keeps the timing and detection values of the most recent frames of each
+ *   camera in a fixed ring so the behavior leading up to a problem can be
+ *   examined afterwards.  The camera thread is the only writer and nothing is
+ *   locked.  Readers copy the ring and discard any records that the camera
+ *   overwrote while the copy was made.
+ */
+
+#include "motionplus.hpp"
+#include "conf.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+#include "trace.hpp"
+
+static int64_t trace_ns(struct timespec *ts)
+{
+    return ((int64_t)ts->tv_sec * 1000000000L) + ts->tv_nsec;
+}
+
+static ctx_trace_rec *trace_rec(ctx_trace *trace)
+{
+    return &trace->recs[trace->frame_nbr.load(std::memory_order_relaxed) & (TRACE_RING_SIZE - 1)];
+}
+
+/* Allocate the ring.  It is kept when the camera restarts */
+void trace_init(ctx_dev *cam)
+{
+    if (cam->trace != NULL) {
+        return;
+    }
+    cam->trace = new ctx_trace;
+    memset(cam->trace->recs, 0, sizeof(cam->trace->recs));
+    cam->trace->frame_nbr = 0;
+    clock_gettime(CLOCK_MONOTONIC, &cam->trace->ts_mark);
+}
+
+/* Free the ring.  Only called once the camera thread has ended */
+void trace_deinit(ctx_dev *cam)
+{
+    if (cam->trace == NULL) {
+        return;
+    }
+    delete cam->trace;
+    cam->trace = NULL;
+}
+
+/* Begin the record of a new frame */
+void trace_start(ctx_dev *cam)
+{
+    ctx_trace_rec *rec;
+
+    if (cam->trace == NULL) {
+        return;
+    }
+    rec = trace_rec(cam->trace);
+    memset(rec, 0, sizeof(ctx_trace_rec));
+    clock_gettime(CLOCK_MONOTONIC, &cam->trace->ts_mark);
+    rec->frame_nbr = cam->trace->frame_nbr.load(std::memory_order_relaxed);
+    rec->ts_start = trace_ns(&cam->trace->ts_mark);
+}
+
+/* Charge the time since the previous mark to the stage */
+void trace_mark(ctx_dev *cam, enum TRACE_STAGE stage)
+{
+    ctx_trace_rec *rec;
+    struct timespec ts_now;
+    int64_t elapsed;
+
+    if (cam->trace == NULL) {
+        return;
+    }
+    rec = trace_rec(cam->trace);
+    clock_gettime(CLOCK_MONOTONIC, &ts_now);
+    elapsed = (trace_ns(&ts_now) - trace_ns(&cam->trace->ts_mark)) / 1000;
+    if (elapsed > 0) {
+        rec->stage_us[stage] += (uint32_t)elapsed;
+    }
+    cam->trace->ts_mark = ts_now;
+
+    if ((stage == TRACE_DETECTION) && (cam->current_image != NULL)) {
+        rec->diffs = cam->current_image->diffs;
+    }
+}
+
+void trace_flag(ctx_dev *cam, uint16_t flag)
+{
+    if (cam->trace == NULL) {
+        return;
+    }
+    trace_rec(cam->trace)->flags |= flag;
+}
+
+/* Complete the record and make it visible to readers */
+void trace_end(ctx_dev *cam)
+{
+    ctx_trace_rec *rec;
+
+    if (cam->trace == NULL) {
+        return;
+    }
+    rec = trace_rec(cam->trace);
+    rec->threshold = cam->threshold;
+    rec->noise = cam->noise;
+    rec->event_nr = cam->event_nr;
+    rec->ring_in = (int16_t)cam->imgs.ring_in;
+    rec->ring_out = (int16_t)cam->imgs.ring_out;
+    if (cam->detecting_motion) {
+        rec->flags |= TRACE_FLAG_MOTION;
+    }
+    if (cam->lost_connection) {
+        rec->flags |= TRACE_FLAG_LOST;
+    }
+    cam->trace->frame_nbr.fetch_add(1, std::memory_order_release);
+}
+
+/* Copy the ring into buf as a header followed by the records oldest first */
+void trace_dump(ctx_dev *cam, std::string &buf)
+{
+    ctx_trace *trace = cam->trace;
+    ctx_trace_hdr hdr;
+    uint64_t frame_beg, frame_end, frame_chk, indx;
+    size_t hdr_sz;
+
+    buf.clear();
+    if (trace == NULL) {
+        return;
+    }
+
+    frame_end = trace->frame_nbr.load(std::memory_order_acquire);
+    if (frame_end > TRACE_RING_SIZE) {
+        frame_beg = frame_end - TRACE_RING_SIZE;
+    } else {
+        frame_beg = 0;
+    }
+
+    hdr_sz = sizeof(ctx_trace_hdr);
+    buf.resize(hdr_sz + (size_t)(frame_end - frame_beg) * sizeof(ctx_trace_rec));
+    for (indx = frame_beg; indx < frame_end; indx++) {
+        memcpy(&buf[hdr_sz + (size_t)(indx - frame_beg) * sizeof(ctx_trace_rec)]
+            , &trace->recs[indx & (TRACE_RING_SIZE - 1)], sizeof(ctx_trace_rec));
+    }
+
+    /* The record in progress when the copy ended and all before it
+     * that share its slot may have been changed during the copy.
+     */
+    frame_chk = trace->frame_nbr.load(std::memory_order_acquire) + 1;
+    if (frame_chk > (frame_beg + TRACE_RING_SIZE)) {
+        indx = frame_chk - TRACE_RING_SIZE - frame_beg;
+        if (indx > (frame_end - frame_beg)) {
+            indx = frame_end - frame_beg;
+        }
+        buf.erase(hdr_sz, (size_t)indx * sizeof(ctx_trace_rec));
+        frame_beg += indx;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = TRACE_MAGIC;
+    hdr.version = TRACE_VERSION;
+    hdr.rec_size = sizeof(ctx_trace_rec);
+    hdr.device_id = cam->device_id;
+    hdr.rec_cnt = (uint32_t)(frame_end - frame_beg);
+    hdr.frame_nbr = frame_end;
+    memcpy(&buf[0], &hdr, hdr_sz);
+}
+
+/* Write the ring to a file in the target directory */
+void trace_write(ctx_dev *cam)
+{
+    std::string buf, fname;
+    FILE *fp;
+    struct tm tm_now;
+    time_t tm_sec;
+    char tmstr[32];
+
+    trace_dump(cam, buf);
+    if (buf.length() == 0) {
+        return;
+    }
+
+    tm_sec = time(NULL);
+    localtime_r(&tm_sec, &tm_now);
+    strftime(tmstr, sizeof(tmstr), "%Y%m%d%H%M%S", &tm_now);
+    fname = cam->conf->target_dir + "/trace_" +
+        std::to_string(cam->device_id) + "_" + tmstr + ".bin";
+
+    fp = myfopen(fname.c_str(), "we");
+    if (fp == NULL) {
+        MOTPLS_LOG(ERR, TYPE_ALL, SHOW_ERRNO
+            ,_("Unable to open trace file %s"), fname.c_str());
+        return;
+    }
+    if (fwrite(buf.data(), 1, buf.length(), fp) != buf.length()) {
+        MOTPLS_LOG(ERR, TYPE_ALL, SHOW_ERRNO
+            ,_("Unable to write trace file %s"), fname.c_str());
+    } else {
+        MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO
+            ,_("Trace of camera %d written to %s")
+            , cam->device_id, fname.c_str());
+    }
+    myfclose(fp);
+}
@@ -0,0 +1,88 @@
+/*
+ *    This file is part of MotionPlus.
+ *
+ *    MotionPlus is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    MotionPlus is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with MotionPlus.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *    Copyright 2020-2023 MotionMrDave@gmail.com
+ *
+*/
+#ifndef _INCLUDE_TRACE_HPP_
+#define _INCLUDE_TRACE_HPP_
+
+    #include <atomic>
+
+    #define TRACE_RING_SIZE   1024          /* Frames kept for each camera.  Must be a power of 2 */
+    #define TRACE_MAGIC       0x5254504dU   /* "MPTR" at the start of a dump */
+    #define TRACE_VERSION     1
+
+    /* Flags of a frame record */
+    #define TRACE_FLAG_MOTION       0x01    /* Motion was being detected */
+    #define TRACE_FLAG_LIGHTSWITCH  0x02    /* Lightswitch reset the reference frame */
+    #define TRACE_FLAG_LOST         0x04    /* Connection to the camera was lost */
+    #define TRACE_FLAG_SKIP         0x08    /* Detection was skipped (lightswitch or ptz wait) */
+
+    /* Sections of the camera loop that are timed */
+    enum TRACE_STAGE {
+        TRACE_PREPARE,      /* init, prepare, resetimages and retry */
+        TRACE_CAPTURE,
+        TRACE_DETECTION,
+        TRACE_TUNING,
+        TRACE_OVERLAY,
+        TRACE_ACTIONS,      /* segment and actions */
+        TRACE_OUTPUT,       /* setupmode, snapshot, timelapse, pictures and loopback */
+        TRACE_TIMING,       /* parmsupdate and frametiming including the sleep */
+        TRACE_STAGES
+    };
+
+    /* One frame.  Written as is to the dump so only fixed size types are used */
+    struct ctx_trace_rec {
+        uint64_t    frame_nbr;                  /* Frames traced since the camera started */
+        int64_t     ts_start;                   /* CLOCK_MONOTONIC nanoseconds at the loop start */
+        uint32_t    stage_us[TRACE_STAGES];     /* Microseconds spent in each stage */
+        int32_t     diffs;                      /* Diffs from the detection before tuning */
+        int32_t     threshold;
+        int32_t     noise;
+        int32_t     event_nr;
+        int16_t     ring_in;
+        int16_t     ring_out;
+        uint16_t    flags;
+        uint16_t    reserved;
+    };
+
+    /* Start of a dump.  Followed by rec_cnt records with the oldest first */
+    struct ctx_trace_hdr {
+        uint32_t    magic;
+        uint16_t    version;
+        uint16_t    rec_size;
+        int32_t     device_id;
+        uint32_t    rec_cnt;
+        uint64_t    frame_nbr;                  /* Frames traced including those no longer held */
+    };
+
+    struct ctx_trace {
+        ctx_trace_rec           recs[TRACE_RING_SIZE];
+        std::atomic<uint64_t>   frame_nbr;      /* Records completed.  Next record is at frame_nbr */
+        struct timespec         ts_mark;        /* Time of the last stage mark */
+    };
+
+    void trace_init(ctx_dev *cam);
+    void trace_deinit(ctx_dev *cam);
+    void trace_start(ctx_dev *cam);
+    void trace_mark(ctx_dev *cam, enum TRACE_STAGE stage);
+    void trace_flag(ctx_dev *cam, uint16_t flag);
+    void trace_end(ctx_dev *cam);
+    void trace_dump(ctx_dev *cam, std::string &buf);
+    void trace_write(ctx_dev *cam);
+
+#endif /* _INCLUDE_TRACE_HPP_ */
@@ -25,9 +25,16 @@
 #if (defined(HAVE_V4L2)) && (!defined(BSD))
 
 #include <dirent.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <linux/videodev2.h>
 
+/* Private event of v4l2loopback reporting the number of readers of the device */
+#ifndef V4L2_EVENT_PRI_CLIENT_USAGE
+    #define V4L2_EVENT_PRI_CLIENT_USAGE  (V4L2_EVENT_PRIVATE_START + 0x08E00000 + 1)
+#endif
+
 typedef struct capent {const char *cap; unsigned int code;} capentT;
     capentT cap_list[] ={
         {"V4L2_CAP_VIDEO_CAPTURE"        ,0x00000001 },
@@ -226,15 +233,410 @@ int vlp_startpipe(const char *dev_name, int width, int height)
     return dev;
 }
 
+/* Map the output buffers of the device so frames are queued instead of written */
+static bool vlp_mmap_init(ctx_vlp *vlp)
+{
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer buf;
+    int indx, flags;
+
+    memset(&req, 0, sizeof(req));
+    req.count = VLP_BUFFERS;
+    req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(vlp->fd, VIDIOC_REQBUFS, &req) == -1) {
+        MOTPLS_LOG(NTC, TYPE_VIDEO, SHOW_ERRNO
+            ,_("Streaming not available for %s pictures, using write"), vlp->label);
+        return false;
+    }
+
+    /* One buffer cannot be filled while the readers use the other */
+    if (req.count < 2) {
+        MOTPLS_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+            ,_("Insufficient buffers for %s pictures, using write"), vlp->label);
+        req.count = 0;
+        ioctl(vlp->fd, VIDIOC_REQBUFS, &req);
+        return false;
+    }
+    if (req.count > VLP_BUFFERS) {
+        req.count = VLP_BUFFERS;
+    }
+
+    for (indx = 0; indx < (int)req.count; indx++) {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = (unsigned int)indx;
+        if (ioctl(vlp->fd, VIDIOC_QUERYBUF, &buf) == -1) {
+            MOTPLS_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "ioctl (VIDIOC_QUERYBUF)");
+            break;
+        }
+        if ((int)buf.length < vlp->size) {
+            MOTPLS_LOG(ERR, TYPE_VIDEO, NO_ERRNO
+                ,_("Buffer size %u smaller than the image size %d")
+                , buf.length, vlp->size);
+            break;
+        }
+        vlp->bufs[indx].start = (unsigned char *)mmap(NULL, buf.length
+            , PROT_READ | PROT_WRITE, MAP_SHARED, vlp->fd, buf.m.offset);
+        if (vlp->bufs[indx].start == MAP_FAILED) {
+            MOTPLS_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, _("Unable to map buffer"));
+            vlp->bufs[indx].start = NULL;
+            break;
+        }
+        vlp->bufs[indx].length = buf.length;
+        vlp->buf_cnt++;
+        vlp->free_bufs.push_back(indx);
+    }
+
+    if (vlp->buf_cnt != (int)req.count) {
+        for (indx = 0; indx < vlp->buf_cnt; indx++) {
+            munmap(vlp->bufs[indx].start, vlp->bufs[indx].length);
+            vlp->bufs[indx].start = NULL;
+        }
+        vlp->buf_cnt = 0;
+        vlp->free_bufs.clear();
+        req.count = 0;
+        ioctl(vlp->fd, VIDIOC_REQBUFS, &req);
+        MOTPLS_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+            ,_("Streaming not available for %s pictures, using write"), vlp->label);
+        return false;
+    }
+
+    /* Completed buffers are collected by the helper thread without waiting */
+    flags = fcntl(vlp->fd, F_GETFL);
+    if ((flags == -1) || (fcntl(vlp->fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        MOTPLS_LOG(WRN, TYPE_VIDEO, SHOW_ERRNO
+            ,_("Unable to set the loopback device to non-blocking"));
+    }
+
+    MOTPLS_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+        ,_("Streaming %s pictures with %d buffers"), vlp->label, vlp->buf_cnt);
+
+    return true;
+}
+
+/* Ask the driver to report when readers open and close the device */
+static void vlp_events_init(ctx_vlp *vlp)
+{
+    struct v4l2_event_subscription sub;
+
+    memset(&sub, 0, sizeof(sub));
+    sub.type = V4L2_EVENT_PRI_CLIENT_USAGE;
+    sub.flags = V4L2_EVENT_SUB_FL_SEND_INITIAL;
+    if (ioctl(vlp->fd, VIDIOC_SUBSCRIBE_EVENT, &sub) == -1) {
+        MOTPLS_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+            ,_("Reader count not reported for %s pictures, sending all images")
+            , vlp->label);
+    }
+    /* Until the driver tells otherwise, assume someone is reading */
+    vlp->readers = -1;
+}
+
+/* Update the reader count from the events queued by the driver */
+static void vlp_events_check(ctx_vlp *vlp)
+{
+    struct pollfd pfd;
+    struct v4l2_event evt;
+    uint32_t cnt;
+
+    pfd.fd = vlp->fd;
+    pfd.events = POLLPRI;
+    pfd.revents = 0;
+    if ((poll(&pfd, 1, 0) <= 0) || ((pfd.revents & POLLPRI) == 0)) {
+        return;
+    }
+
+    memset(&evt, 0, sizeof(evt));
+    while (ioctl(vlp->fd, VIDIOC_DQEVENT, &evt) == 0) {
+        if (evt.type == V4L2_EVENT_PRI_CLIENT_USAGE) {
+            memcpy(&cnt, evt.u.data, sizeof(cnt));
+            if ((vlp->readers <= 0) && (cnt > 0)) {
+                MOTPLS_LOG(INF, TYPE_VIDEO, NO_ERRNO
+                    ,_("Sending %s pictures to %u readers"), vlp->label, cnt);
+            } else if ((vlp->readers != 0) && (cnt == 0)) {
+                MOTPLS_LOG(INF, TYPE_VIDEO, NO_ERRNO
+                    ,_("No readers of %s pictures"), vlp->label);
+            }
+            vlp->readers = (int)cnt;
+        }
+        memset(&evt, 0, sizeof(evt));
+    }
+}
+
+/* Return the buffers the driver has finished with to the free list.
+ * The device is non-blocking so the mutex is held across VIDIOC_DQBUF
+ * to keep it ordered with the VIDIOC_QBUF of the camera thread.
+ */
+static void vlp_reclaim(ctx_vlp *vlp)
+{
+    struct v4l2_buffer buf;
+
+    pthread_mutex_lock(&vlp->mutex);
+        while (vlp->queued_cnt > 0) {
+            memset(&buf, 0, sizeof(buf));
+            buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+            buf.memory = V4L2_MEMORY_MMAP;
+            if (ioctl(vlp->fd, VIDIOC_DQBUF, &buf) == -1) {
+                break;
+            }
+            vlp->free_bufs.push_back((int)buf.index);
+            vlp->queued_cnt--;
+        }
+    pthread_mutex_unlock(&vlp->mutex);
+}
+
+/* Release the buffers, close the device and free the context */
+static void vlp_release(ctx_vlp *vlp)
+{
+    enum v4l2_buf_type type;
+    int indx;
+
+    if (vlp->streaming) {
+        type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        if (ioctl(vlp->fd, VIDIOC_STREAMOFF, &type) == -1) {
+            MOTPLS_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "ioctl (VIDIOC_STREAMOFF)");
+        }
+    }
+    for (indx = 0; indx < vlp->buf_cnt; indx++) {
+        munmap(vlp->bufs[indx].start, vlp->bufs[indx].length);
+    }
+    close(vlp->fd);
+
+    pthread_cond_destroy(&vlp->cond_work);
+    pthread_mutex_destroy(&vlp->mutex);
+
+    delete vlp;
+}
+
+/* Wait on the condition for at most the number of milliseconds */
+static void vlp_timedwait(ctx_vlp *vlp, int msec)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long)msec * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&vlp->cond_work, &vlp->mutex, &ts);
+}
+
+static void *vlp_handler(void *arg)
+{
+    ctx_vlp *vlp = (ctx_vlp *)arg;
+    ctx_dev *cam = vlp->cam;
+    bool orphaned;
+
+    mythreadname_set("lb", cam->threadnr, cam->conf->device_name.c_str());
+
+    pthread_mutex_lock(&vlp->mutex);
+    while (vlp->closing == false) {
+        /* Look for finished buffers often while the driver holds some */
+        if (vlp->queued_cnt > 0) {
+            vlp_timedwait(vlp, 5);
+        } else {
+            vlp_timedwait(vlp, 250);
+        }
+        pthread_mutex_unlock(&vlp->mutex);
+
+        vlp_events_check(vlp);
+        if (vlp->use_mmap) {
+            vlp_reclaim(vlp);
+        }
+
+        pthread_mutex_lock(&vlp->mutex);
+    }
+    vlp->thread_running = false;
+    orphaned = vlp->orphaned;
+    pthread_mutex_unlock(&vlp->mutex);
+
+    /* vlp_stop gave up waiting and left the device for the thread to release */
+    if (orphaned) {
+        vlp_release(vlp);
+    }
+
+    pthread_exit(NULL);
+}
+
+/* Open the device and start the thread that looks after it */
+static ctx_vlp *vlp_start(ctx_dev *cam, const char *dev_name, const char *label)
+{
+    ctx_vlp *vlp;
+    pthread_attr_t thread_attr;
+    int fd, retcd;
+
+    fd = vlp_startpipe(dev_name, cam->imgs.width, cam->imgs.height);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    vlp = new ctx_vlp;
+    vlp->cam = cam;
+    vlp->label = label;
+    vlp->fd = fd;
+    vlp->size = cam->imgs.size_norm;
+    vlp->streaming = false;
+    vlp->primed = false;
+    vlp->buf_cnt = 0;
+    vlp->queued_cnt = 0;
+    vlp->closing = false;
+    vlp->orphaned = false;
+    vlp->put_cnt = 0;
+    vlp->skip_cnt = 0;
+    vlp->drop_cnt = 0;
+    memset(vlp->bufs, 0, sizeof(vlp->bufs));
+
+    vlp->use_mmap = vlp_mmap_init(vlp);
+    vlp_events_init(vlp);
+
+    pthread_mutex_init(&vlp->mutex, NULL);
+    pthread_cond_init(&vlp->cond_work, NULL);
+
+    vlp->thread_running = true;
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    retcd = pthread_create(&vlp->thread_id, &thread_attr, &vlp_handler, vlp);
+    pthread_attr_destroy(&thread_attr);
+    if (retcd != 0) {
+        MOTPLS_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO
+            ,_("Error starting loopback thread for %s pictures"), vlp->label);
+        vlp->thread_running = false;
+    }
+
+    return vlp;
+}
+
+/* Stop the thread, release the buffers and close the device */
+static void vlp_stop(ctx_vlp *vlp)
+{
+    int waitcnt;
+    bool orphaned;
+
+    if (vlp == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&vlp->mutex);
+        vlp->closing = true;
+        pthread_cond_signal(&vlp->cond_work);
+    pthread_mutex_unlock(&vlp->mutex);
+
+    waitcnt = 0;
+    while ((vlp->thread_running) && (waitcnt < 1000)) {
+        SLEEP(0,1000000)
+        waitcnt++;
+    }
+
+    MOTPLS_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+        ,_("Closing loopback for %s pictures, %llu frames sent, %llu skipped, %llu dropped")
+        , vlp->label
+        , (unsigned long long)vlp->put_cnt
+        , (unsigned long long)vlp->skip_cnt
+        , (unsigned long long)vlp->drop_cnt);
+
+    if (waitcnt == 1000) {
+        /* Once orphaned the thread may free vlp as soon as the lock is released */
+        pthread_mutex_lock(&vlp->mutex);
+            orphaned = vlp->thread_running;
+            vlp->orphaned = orphaned;
+        pthread_mutex_unlock(&vlp->mutex);
+        if (orphaned) {
+            MOTPLS_LOG(ERR, TYPE_VIDEO, NO_ERRNO
+                ,_("Graceful shutdown of loopback thread failed.  Device is closed when it exits"));
+            return;
+        }
+    }
+
+    vlp_release(vlp);
+}
+
+/* Queue the image in a free mapped buffer */
+static int vlp_queue(ctx_vlp *vlp, unsigned char *image, int imgsize)
+{
+    struct v4l2_buffer buf;
+    enum v4l2_buf_type type;
+    int indx;
+
+    pthread_mutex_lock(&vlp->mutex);
+        if (vlp->free_bufs.empty()) {
+            vlp->drop_cnt++;
+            pthread_mutex_unlock(&vlp->mutex);
+            return 0;
+        }
+        indx = vlp->free_bufs.front();
+        vlp->free_bufs.pop_front();
+    pthread_mutex_unlock(&vlp->mutex);
+
+    /* The buffer is owned by the camera thread until it is queued */
+    if (imgsize > (int)vlp->bufs[indx].length) {
+        imgsize = (int)vlp->bufs[indx].length;
+    }
+    memcpy(vlp->bufs[indx].start, image, imgsize);
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = (unsigned int)indx;
+    buf.bytesused = (unsigned int)imgsize;
+    buf.field = V4L2_FIELD_NONE;
+    gettimeofday(&buf.timestamp, NULL);
+
+    pthread_mutex_lock(&vlp->mutex);
+        if (ioctl(vlp->fd, VIDIOC_QBUF, &buf) == -1) {
+            vlp->free_bufs.push_back(indx);
+            pthread_mutex_unlock(&vlp->mutex);
+            return -1;
+        }
+        vlp->queued_cnt++;
+
+        if (vlp->streaming == false) {
+            type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+            if (ioctl(vlp->fd, VIDIOC_STREAMON, &type) == -1) {
+                MOTPLS_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "ioctl (VIDIOC_STREAMON)");
+            }
+            vlp->streaming = true;
+        }
+        pthread_cond_signal(&vlp->cond_work);
+    pthread_mutex_unlock(&vlp->mutex);
+
+    return imgsize;
+}
+
 #endif /* HAVE_V4L2 && !BSD */
 
-int vlp_putpipe(int dev, unsigned char *image, int imgsize)
+int vlp_putpipe(ctx_vlp *vlp, unsigned char *image, int imgsize)
 {
 
     #if (defined(HAVE_V4L2)) && (!defined(BSD))
-        return (int)write(dev, image, imgsize);
+        int retcd;
+
+        if (vlp == NULL) {
+            return 0;
+        }
+
+        /* Nothing to do when no program has the device open.  The driver
+         * only offers the device for capture once a frame has been sent
+         * so frames are always sent until then.
+         */
+        if ((vlp->readers == 0) && (vlp->primed)) {
+            vlp->skip_cnt++;
+            return 0;
+        }
+
+        vlp->put_cnt++;
+        if (vlp->use_mmap) {
+            retcd = vlp_queue(vlp, image, imgsize);
+        } else {
+            retcd = (int)write(vlp->fd, image, imgsize);
+        }
+        if (retcd > 0) {
+            vlp->primed = true;
+        }
+        return retcd;
     #else
-        (void)dev;
+        (void)vlp;
         (void)image;
         (void)imgsize;
         return -1;
@@ -244,43 +646,46 @@ int vlp_putpipe(int dev, unsigned char *image, int imgsize)
 void vlp_init(ctx_dev *cam)
 {
 
+    cam->pipe = NULL;
+    cam->mpipe = NULL;
+
     #if defined(HAVE_V4L2) && !defined(BSD)
         /* open video loopback devices if enabled */
         if (cam->conf->video_pipe != "") {
             MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO
                 ,_("Opening video loopback device for normal pictures"));
 
-            /* vid_startpipe should get the output dimensions */
-            cam->pipe = vlp_startpipe(cam->conf->video_pipe.c_str(), cam->imgs.width, cam->imgs.height);
+            cam->pipe = vlp_start(cam, cam->conf->video_pipe.c_str(), "normal");
 
-            if (cam->pipe < 0) {
+            if (cam->pipe == NULL) {
                 MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
                     ,_("Failed to open video loopback for normal pictures"));
                 return;
             }
-        } else {
-            cam->pipe = -1;
         }
 
         if (cam->conf->video_pipe_motion != "") {
             MOTPLS_LOG(NTC, TYPE_ALL, NO_ERRNO
                 ,_("Opening video loopback device for motion pictures"));
 
-            /* vid_startpipe should get the output dimensions */
-            cam->mpipe = vlp_startpipe(cam->conf->video_pipe_motion.c_str(), cam->imgs.width, cam->imgs.height);
+            cam->mpipe = vlp_start(cam, cam->conf->video_pipe_motion.c_str(), "motion");
 
-            if (cam->mpipe < 0) {
+            if (cam->mpipe == NULL) {
                 MOTPLS_LOG(ERR, TYPE_ALL, NO_ERRNO
                     ,_("Failed to open video loopback for motion pictures"));
                 return;
             }
-        } else {
-            cam->mpipe = -1;
         }
-    #else
-        cam->mpipe = -1;
-        cam->pipe = -1;
     #endif /* HAVE_V4L2 && !BSD */
 }
 
+void vlp_deinit(ctx_dev *cam)
+{
 
+    #if defined(HAVE_V4L2) && !defined(BSD)
+        vlp_stop(cam->pipe);
+        vlp_stop(cam->mpipe);
+    #endif /* HAVE_V4L2 && !BSD */
+    cam->pipe = NULL;
+    cam->mpipe = NULL;
+}
@@ -19,7 +19,41 @@
 #ifndef _INCLUDE_VIDEO_LOOPBACK_HPP_
 #define _INCLUDE_VIDEO_LOOPBACK_HPP_
 
+    #define VLP_BUFFERS     4     /* Output buffers requested from the loopback device */
+
+    struct ctx_vlp_buf {
+        unsigned char           *start;
+        size_t                  length;
+    };
+
+    struct ctx_vlp {
+        ctx_dev                 *cam;
+        const char              *label;         /* Pictures sent to the device for the log messages */
+        int                     fd;
+        int                     size;
+        bool                    use_mmap;       /* Frames are queued in mapped buffers instead of written */
+        bool                    streaming;      /* VIDIOC_STREAMON has been issued */
+        bool                    primed;         /* A frame was sent so readers are able to open the device */
+        int                     buf_cnt;
+        ctx_vlp_buf             bufs[VLP_BUFFERS];
+        std::list<int>          free_bufs;      /* Buffers that may be filled by the camera thread */
+        int                     queued_cnt;     /* Buffers owned by the driver.  Protected by the mutex */
+        volatile int            readers;        /* Clients reading the device or -1 when unknown */
+
+        pthread_mutex_t         mutex;
+        pthread_cond_t          cond_work;      /* Signaled when a buffer is queued or on shutdown */
+        pthread_t               thread_id;
+        volatile bool           thread_running;
+        volatile bool           closing;
+        bool                    orphaned;       /* Stop timed out so the thread releases the device */
+
+        uint64_t                put_cnt;
+        uint64_t                skip_cnt;       /* Frames not sent because nobody was reading */
+        uint64_t                drop_cnt;       /* Frames not sent because no buffer was free */
+    };
+
     int vlp_startpipe(const char *dev_name, int width, int height);
-    int vlp_putpipe(int dev, unsigned char *image, int imgsize);
+    int vlp_putpipe(ctx_vlp *vlp, unsigned char *image, int imgsize);
     void vlp_init(ctx_dev *cam);
+    void vlp_deinit(ctx_dev *cam);
 #endif /* _INCLUDE_VIDEO_LOOPBACK_HPP_ */
@@ -909,8 +909,6 @@ static void v4l2_set_imgs(ctx_dev *cam)
     cam->imgs.height = cam->v4l2cam->height;
     cam->imgs.motionsize = cam->imgs.width * cam->imgs.height;
     cam->imgs.size_norm = (cam->imgs.motionsize * 3) / 2;
-    cam->conf->width = cam->v4l2cam->width;
-    cam->conf->height = cam->v4l2cam->height;
 }
 
 /* Capture the image into the buffer */
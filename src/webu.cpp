@@ -42,6 +42,7 @@ struct ctx_mhdstart {
     int                     mhd_opt_nbr;
     unsigned int            mhd_flags;
     int                     ipv6;
+    bool                    epoll;
     struct sockaddr_in      lpbk_ipv4;
     struct sockaddr_in6     lpbk_ipv6;
 };
@@ -68,10 +69,11 @@ static void webu_context_init(ctx_motapp *motapp, ctx_webui *webui)
     webui->resp_used     = 0;                           /* How many bytes used so far in resp_page*/
     webui->resp_image    = NULL;                        /* Buffer for sending the images */
     webui->stream_pos    = 0;                           /* Stream position of image being sent */
+    webui->stream_frame  = NULL;                        /* Shared frame being sent */
+    webui->stream_seq    = 0;
     webui->stream_fps    = 1;                           /* Stream rate */
     webui->resp_page     = "";                          /* The response being constructed */
     webui->post_info     = NULL;
-    webui->req_file      = NULL;
     webui->post_sz       = 0;
     webui->motapp        = motapp;                      /* The motion application context */
     webui->cam           = NULL;                        /* The context pointer for a single camera */
@@ -781,6 +783,14 @@ static mhdrslt webu_answer_get(ctx_webui *webui)
             retcd = webu_mhd_send(webui);
         }
 
+    } else if (webui->uri_cmd1 == "trace.bin") {
+
+        retcd = webu_file_trace(webui);
+        if (retcd == MHD_NO) {
+            webu_html_badreq(webui);
+            retcd = webu_mhd_send(webui);
+        }
+
     } else if (webui->uri_cmd1 == "config.json") {
 
         pthread_mutex_lock(&webui->motapp->mutex_post);
@@ -980,6 +990,13 @@ static void webu_mhd_deinit(void *cls, struct MHD_Connection *connection
             }
         pthread_mutex_unlock(&webui->cam->stream.mutex);
 
+    } else if (webui->cnct_type == WEBUI_CNCT_THUMB ) {
+        pthread_mutex_lock(&webui->cam->stream.mutex);
+            if (webui->cam->stream.thumb.cnct_count > 0) {
+                webui->cam->stream.thumb.cnct_count--;
+            }
+        pthread_mutex_unlock(&webui->cam->stream.mutex);
+
     } else if (webui->cnct_type == WEBUI_CNCT_MOTION ) {
         pthread_mutex_lock(&webui->cam->stream.mutex);
             if (webui->cam->stream.motion.cnct_count > 0) {
@@ -1004,6 +1021,10 @@ static void webu_mhd_deinit(void *cls, struct MHD_Connection *connection
     }
 
     if (webui != NULL) {
+        if (webui->motapp->webcontrol_pool) {
+            webu_stream_waiting_remove(webui);
+        }
+        webu_stream_frame_drop(webui);
         if (webui->cnct_method == WEBUI_METHOD_POST) {
             MHD_destroy_post_processor (webui->post_processor);
         }
@@ -1103,6 +1124,27 @@ static void webu_mhd_features_tls(ctx_mhdstart *mhdst)
     #endif
 }
 
+/* Validate that the MHD version installed can serve connections from a pool of threads */
+static void webu_mhd_features_pool(ctx_mhdstart *mhdst)
+{
+    mhdst->epoll = false;
+    #if MHD_VERSION < 0x00094400
+        if (mhdst->motapp->webcontrol_pool) {
+            MOTPLS_LOG(INF, TYPE_STREAM, NO_ERRNO ,_("libmicrohttpd libary too old thread pool disabled"));
+            mhdst->motapp->webcontrol_pool = false;
+        }
+    #else
+        mhdrslt retcd;
+        retcd = MHD_is_feature_supported (MHD_FEATURE_EPOLL);
+        if (retcd == MHD_YES) {
+            MOTPLS_LOG(DBG, TYPE_STREAM, NO_ERRNO ,_("epoll: available"));
+            mhdst->epoll = true;
+        } else {
+            MOTPLS_LOG(INF, TYPE_STREAM, NO_ERRNO ,_("epoll: disabled"));
+        }
+    #endif
+}
+
 /* Validate the features that MHD can support */
 static void webu_mhd_features(ctx_mhdstart *mhdst)
 {
@@ -1114,6 +1156,8 @@ static void webu_mhd_features(ctx_mhdstart *mhdst)
 
     webu_mhd_features_tls(mhdst);
 
+    webu_mhd_features_pool(mhdst);
+
 }
 /* Load a either the key or cert file for MHD*/
 static std::string webu_mhd_loadfile(std::string fname)
@@ -1260,6 +1304,18 @@ static void webu_mhd_opts_tls(ctx_mhdstart *mhdst)
 
 }
 
+/* Set the number of threads when the connections are served by a pool */
+static void webu_mhd_opts_pool(ctx_mhdstart *mhdst)
+{
+    if (mhdst->motapp->webcontrol_pool) {
+        mhdst->mhd_ops[mhdst->mhd_opt_nbr].option = MHD_OPTION_THREAD_POOL_SIZE;
+        mhdst->mhd_ops[mhdst->mhd_opt_nbr].value = (unsigned int)mhdst->motapp->conf->webcontrol_threads;
+        mhdst->mhd_ops[mhdst->mhd_opt_nbr].ptr_value = NULL;
+        mhdst->mhd_opt_nbr++;
+    }
+
+}
+
 /* Set all the MHD options based upon the configuration parameters*/
 static void webu_mhd_opts(ctx_mhdstart *mhdst)
 {
@@ -1277,6 +1333,8 @@ static void webu_mhd_opts(ctx_mhdstart *mhdst)
 
     webu_mhd_opts_tls(mhdst);
 
+    webu_mhd_opts_pool(mhdst);
+
     mhdst->mhd_ops[mhdst->mhd_opt_nbr].option = MHD_OPTION_END;
     mhdst->mhd_ops[mhdst->mhd_opt_nbr].value = 0;
     mhdst->mhd_ops[mhdst->mhd_opt_nbr].ptr_value = NULL;
@@ -1287,7 +1345,26 @@ static void webu_mhd_opts(ctx_mhdstart *mhdst)
 /* Set the mhd start up flags */
 static void webu_mhd_flags(ctx_mhdstart *mhdst)
 {
-    mhdst->mhd_flags = MHD_USE_THREAD_PER_CONNECTION;
+    if (mhdst->motapp->webcontrol_pool) {
+        /* Streams suspend their connection between images instead of sleeping */
+        #if MHD_VERSION >= 0x00095900
+            if (mhdst->epoll) {
+                mhdst->mhd_flags = MHD_USE_EPOLL_INTERNAL_THREAD;
+            } else {
+                mhdst->mhd_flags = MHD_USE_INTERNAL_POLLING_THREAD;
+            }
+            mhdst->mhd_flags = mhdst->mhd_flags | MHD_ALLOW_SUSPEND_RESUME;
+        #else
+            if (mhdst->epoll) {
+                mhdst->mhd_flags = MHD_USE_EPOLL_INTERNALLY;
+            } else {
+                mhdst->mhd_flags = MHD_USE_SELECT_INTERNALLY;
+            }
+            mhdst->mhd_flags = mhdst->mhd_flags | MHD_USE_SUSPEND_RESUME;
+        #endif
+    } else {
+        mhdst->mhd_flags = MHD_USE_THREAD_PER_CONNECTION;
+    }
 
     if (mhdst->ipv6) {
         mhdst->mhd_flags = mhdst->mhd_flags | MHD_USE_DUAL_STACK;
@@ -1349,6 +1426,7 @@ static void webu_init_webcontrol(ctx_motapp *motapp)
     mhdst.tls_key  = webu_mhd_loadfile(motapp->conf->webcontrol_key);
     mhdst.motapp = motapp;
     mhdst.ipv6 = motapp->conf->webcontrol_ipv6;
+    motapp->webcontrol_pool = (motapp->conf->webcontrol_threads > 0);
 
     /* Set the rand number for webcontrol digest if needed */
     srand((unsigned int)time(NULL));
@@ -1372,10 +1450,17 @@ static void webu_init_webcontrol(ctx_motapp *motapp)
     free(mhdst.mhd_ops);
     if (motapp->webcontrol_daemon == NULL) {
         MOTPLS_LOG(NTC, TYPE_STREAM, NO_ERRNO ,_("Unable to start MHD"));
+        motapp->webcontrol_pool = false;
     } else {
         MOTPLS_LOG(NTC, TYPE_STREAM, NO_ERRNO
             ,_("Started webcontrol on port %d")
             ,motapp->conf->webcontrol_port);
+        if (motapp->webcontrol_pool) {
+            MOTPLS_LOG(NTC, TYPE_STREAM, NO_ERRNO
+                ,_("Serving connections with %d threads")
+                ,motapp->conf->webcontrol_threads);
+            webu_stream_wake_start(motapp);
+        }
     }
 
     return;
@@ -1387,6 +1472,9 @@ void webu_deinit(ctx_motapp *motapp)
 
     if (motapp->webcontrol_daemon != NULL) {
         motapp->webcontrol_finish = true;
+        if (motapp->webcontrol_pool) {
+            webu_stream_wake_stop(motapp);
+        }
         MHD_stop_daemon (motapp->webcontrol_daemon);
     }
 
@@ -41,6 +41,7 @@
         WEBUI_CNCT_SOURCE      = 4,
         WEBUI_CNCT_SECONDARY   = 5,
         WEBUI_CNCT_FILE        = 6,
+        WEBUI_CNCT_THUMB       = 7,
         WEBUI_CNCT_UNKNOWN     = 99
     };
 
@@ -87,13 +88,15 @@
         ctx_key                     *post_info;     /* Structure of the entries provided from the post data */
         struct MHD_PostProcessor    *post_processor; /* Processor for handling Post method connections */
 
-        FILE                        *req_file;      /* requested file*/
 
         enum WEBUI_METHOD           cnct_method;    /* Connection method.  Get or Post */
 
         uint64_t                    stream_pos;     /* Stream position of sent image */
+        ctx_stream_frame            *stream_frame;  /* Frame being sent to the client */
+        uint64_t                    stream_seq;     /* Sequence number of stream_frame */
         int                         stream_fps;     /* Stream rate per second */
         struct timespec             time_last;      /* Keep track of processing time for stream thread*/
+        struct timespec             time_wake;      /* When a suspended stream connection is resumed */
         int                         mhd_first;      /* Boolean for whether it is the first connection*/
         struct MHD_Connection       *connection;    /* The MHD connection value from the client */
         ctx_motapp                  *motapp;        /* The motionplus context pointer */
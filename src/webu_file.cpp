@@ -25,32 +25,175 @@
 #include "webu.hpp"
 #include "webu_file.hpp"
 #include "dbse.hpp"
+#include "trace.hpp"
 
 
-/* Callback for the file reader response*/
-static ssize_t webu_file_reader (void *cls, uint64_t pos, char *buf, size_t max)
+/* Content type of the movie from the file extension */
+static const char *webu_file_type(std::string &full_nm)
 {
-    ctx_webui *webui =(ctx_webui *)cls;
+    size_t pos;
+    std::string ext;
 
-    (void)fseek (webui->req_file, pos, SEEK_SET);
-    return fread (buf, 1, max, webui->req_file);
+    pos = full_nm.find_last_of('.');
+    if (pos == std::string::npos) {
+        return "application/octet-stream";
+    }
+    ext = full_nm.substr(pos + 1);
+
+    if (ext == "mp4") {
+        return "video/mp4";
+    } else if (ext == "mkv") {
+        return "video/x-matroska";
+    } else if (ext == "webm") {
+        return "video/webm";
+    } else if (ext == "mov") {
+        return "video/quicktime";
+    } else if (ext == "flv") {
+        return "video/x-flv";
+    } else if (ext == "avi") {
+        return "video/x-msvideo";
+    } else if (ext == "ogg") {
+        return "video/ogg";
+    } else if (ext == "mpg") {
+        return "video/mpeg";
+    } else if (ext == "jpg") {
+        return "image/jpeg";
+    }
+    return "application/octet-stream";
+}
+
+/* Parse a single byte range header of the request.
+ * Return 0 when the whole file is to be sent, 1 when the range is
+ * valid and -1 when it can not be satisfied.  Multiple ranges
+ * are answered with the whole file.
+*/
+static int webu_file_range(ctx_webui *webui, uint64_t file_sz
+    , uint64_t &rng_st, uint64_t &rng_en)
+{
+    const char *hdr;
+    char *endptr;
+    std::string rng;
+    size_t pos;
+
+    hdr = MHD_lookup_connection_value(webui->connection
+        , MHD_HEADER_KIND, MHD_HTTP_HEADER_RANGE);
+    if (hdr == NULL) {
+        return 0;
+    }
+    rng = hdr;
+    if ((rng.compare(0, 6, "bytes=") != 0) ||
+        (rng.find(',') != std::string::npos)) {
+        return 0;
+    }
+    rng = rng.substr(6);
+    pos = rng.find('-');
+    if ((pos == std::string::npos) || (rng.length() < 2)) {
+        return 0;
+    }
+
+    if (pos == 0) {
+        /* Suffix range "-n" for the last n bytes */
+        rng_en = strtoull(rng.c_str() + 1, &endptr, 10);
+        if (*endptr != '\0') {
+            return 0;
+        }
+        if ((rng_en == 0) || (file_sz == 0)) {
+            return -1;
+        }
+        if (rng_en > file_sz) {
+            rng_en = file_sz;
+        }
+        rng_st = file_sz - rng_en;
+        rng_en = file_sz - 1;
+        return 1;
+    }
+
+    rng_st = strtoull(rng.c_str(), &endptr, 10);
+    if (endptr != (rng.c_str() + pos)) {
+        return 0;
+    }
+    if (rng_st >= file_sz) {
+        return -1;
+    }
+    if (pos == (rng.length() - 1)) {
+        rng_en = file_sz - 1;
+    } else {
+        rng_en = strtoull(rng.c_str() + pos + 1, &endptr, 10);
+        if (*endptr != '\0') {
+            return 0;
+        }
+        if (rng_en < rng_st) {
+            return 0;
+        }
+        if (rng_en >= file_sz) {
+            rng_en = file_sz - 1;
+        }
+    }
+
+    return 1;
+}
+
+/* Answer with the not found page */
+static mhdrslt webu_file_notfound(ctx_webui *webui)
+{
+    mhdrslt retcd;
+    struct MHD_Response *response;
+
+    MOTPLS_LOG(NTC, TYPE_STREAM, NO_ERRNO
+        ,"Security warning: Client IP %s requested file: %s"
+        ,webui->clientip.c_str(), webui->uri_cmd2.c_str());
+
+    webui->resp_page = "<html><head><title>Bad File</title>"
+        "</head><body>Bad File</body></html>";
+
+    response = MHD_create_response_from_buffer(webui->resp_page.length()
+        ,(void *)webui->resp_page.c_str(), MHD_RESPMEM_PERSISTENT);
+    if (response == NULL) {
+        return MHD_NO;
+    }
+    retcd = MHD_queue_response (webui->connection, MHD_HTTP_NOT_FOUND, response);
+    MHD_destroy_response (response);
+
+    return retcd;
 }
 
-/* Close the requested file */
-static void webu_file_free (void *cls)
+/* Answer a range which is beyond the end of the file */
+static mhdrslt webu_file_badrange(ctx_webui *webui, uint64_t file_sz)
 {
-    ctx_webui *webui =(ctx_webui *)cls;
-    myfclose(webui->req_file);
+    mhdrslt retcd;
+    struct MHD_Response *response;
+    std::string hdr;
+
+    response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+    if (response == NULL) {
+        return MHD_NO;
+    }
+    hdr = "bytes */" + std::to_string(file_sz);
+    MHD_add_response_header (response, MHD_HTTP_HEADER_CONTENT_RANGE, hdr.c_str());
+    #ifdef MHD_HTTP_RANGE_NOT_SATISFIABLE
+        retcd = MHD_queue_response (webui->connection
+            , MHD_HTTP_RANGE_NOT_SATISFIABLE, response);
+    #else
+        retcd = MHD_queue_response (webui->connection
+            , MHD_HTTP_REQUESTED_RANGE_NOT_SATISFIABLE, response);
+    #endif
+    MHD_destroy_response (response);
+
+    return retcd;
 }
 
-/* Entry point for answering file request*/
+/* Entry point for answering file request.
+ * The movie is located via the index of the database list and the
+ * open descriptor is handed to MHD which sends it with sendfile.
+*/
 mhdrslt webu_file_main(ctx_webui *webui)
 {
     mhdrslt retcd;
     struct stat statbuf;
     struct MHD_Response *response;
-    std::string full_nm;
-    int indx;
+    std::string full_nm, hdr;
+    int indx, fd, rngcd;
+    uint64_t file_sz, rng_st, rng_en;
     ctx_params *wact;
 
     /*If we have not fully started yet, simply return*/
@@ -58,10 +201,6 @@ mhdrslt webu_file_main(ctx_webui *webui)
         return MHD_NO;
     }
 
-    if (webui->cam->motapp->dbse->movie_cnt == 0) {
-        webui->cam->motapp->dbse_movies_getlist(webui->cam->device_id);
-    }
-
     wact = webui->motapp->webcontrol_actions;
     for (indx = 0; indx < wact->params_count; indx++) {
         if (mystreq(wact->params_array[indx].param_name,"movies")) {
@@ -74,46 +213,95 @@ mhdrslt webu_file_main(ctx_webui *webui)
         }
     }
 
-    full_nm = "";
-    for (indx=0; indx < webui->cam->motapp->dbse->movie_cnt; indx++) {
-        if (mystreq(webui->cam->motapp->dbse->movie_list[indx].movie_nm
-            , webui->uri_cmd2.c_str())) {
-            full_nm = webui->cam->motapp->dbse->movie_list[indx].full_nm;
-        }
+    full_nm = webui->cam->motapp->dbse_movies_fullnm(
+        webui->cam->device_id, webui->uri_cmd2);
+    if (full_nm == "") {
+        return webu_file_notfound(webui);
     }
 
-    if (stat(full_nm.c_str(), &statbuf) == 0) {
-        webui->req_file = myfopen(full_nm.c_str(), "rbe");
+    fd = open(full_nm.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return webu_file_notfound(webui);
+    }
+    if ((fstat(fd, &statbuf) != 0) || (S_ISREG(statbuf.st_mode) == 0)) {
+        close(fd);
+        return webu_file_notfound(webui);
+    }
+    file_sz = (uint64_t)statbuf.st_size;
+
+    rng_st = 0;
+    rng_en = 0;
+    rngcd = webu_file_range(webui, file_sz, rng_st, rng_en);
+    if (rngcd == -1) {
+        close(fd);
+        return webu_file_badrange(webui, file_sz);
+    } else if (rngcd == 0) {
+        rng_st = 0;
+        rng_en = file_sz;
     } else {
-        webui->req_file = NULL;
-        MOTPLS_LOG(NTC, TYPE_STREAM, NO_ERRNO
-            ,"Security warning: Client IP %s requested file: %s"
-            ,webui->clientip.c_str(), webui->uri_cmd2.c_str());
+        rng_en = rng_en + 1;
     }
 
-    if (webui->req_file == NULL) {
-        webui->resp_page = "<html><head><title>Bad File</title>"
-            "</head><body>Bad File</body></html>";
+    /* MHD owns the descriptor once the response is created */
+    #if MHD_VERSION >= 0x00094400
+        response = MHD_create_response_from_fd_at_offset64(
+            rng_en - rng_st, fd, rng_st);
+    #else
+        response = MHD_create_response_from_fd_at_offset(
+            (size_t)(rng_en - rng_st), fd, (off_t)rng_st);
+    #endif
+    if (response == NULL) {
+        close(fd);
+        return MHD_NO;
+    }
 
-        response = MHD_create_response_from_buffer(webui->resp_page.length()
-            ,(void *)webui->resp_page.c_str(), MHD_RESPMEM_PERSISTENT);
-        retcd = MHD_queue_response (webui->connection, MHD_HTTP_NOT_FOUND, response);
-        MHD_destroy_response (response);
+    MHD_add_response_header (response, MHD_HTTP_HEADER_ACCEPT_RANGES, "bytes");
+    MHD_add_response_header (response, MHD_HTTP_HEADER_CONTENT_TYPE
+        , webu_file_type(full_nm));
 
+    if (rngcd == 1) {
+        hdr = "bytes " + std::to_string(rng_st) + "-" +
+            std::to_string(rng_en - 1) + "/" + std::to_string(file_sz);
+        MHD_add_response_header (response, MHD_HTTP_HEADER_CONTENT_RANGE, hdr.c_str());
+        retcd = MHD_queue_response (webui->connection
+            , MHD_HTTP_PARTIAL_CONTENT, response);
     } else {
-        response = MHD_create_response_from_callback (
-            statbuf.st_size, 32 * 1024
-            , &webu_file_reader
-            , webui
-            , &webu_file_free);
-        if (response == NULL) {
-            myfclose(webui->req_file);
-            return MHD_NO;
-        }
         retcd = MHD_queue_response (webui->connection, MHD_HTTP_OK, response);
-        MHD_destroy_response (response);
     }
+    MHD_destroy_response (response);
 
     return retcd;
 }
 
+/* Send the frame trace ring of the camera as a binary download */
+mhdrslt webu_file_trace(ctx_webui *webui)
+{
+    mhdrslt retcd;
+    struct MHD_Response *response;
+    std::string buf, hdr;
+
+    if (webui->cam == NULL) {
+        return MHD_NO;
+    }
+
+    trace_dump(webui->cam, buf);
+    if (buf.length() == 0) {
+        return MHD_NO;
+    }
+
+    response = MHD_create_response_from_buffer(buf.length()
+        ,(void *)buf.data(), MHD_RESPMEM_MUST_COPY);
+    if (response == NULL) {
+        return MHD_NO;
+    }
+
+    hdr = "attachment; filename=\"trace_" +
+        std::to_string(webui->cam->device_id) + ".bin\"";
+    MHD_add_response_header (response, MHD_HTTP_HEADER_CONTENT_TYPE
+        , "application/octet-stream");
+    MHD_add_response_header (response, "Content-Disposition", hdr.c_str());
+    retcd = MHD_queue_response (webui->connection, MHD_HTTP_OK, response);
+    MHD_destroy_response (response);
+
+    return retcd;
+}
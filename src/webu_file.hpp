@@ -21,5 +21,6 @@
 #define _INCLUDE_WEBU_FILE_HPP_
 
     mhdrslt webu_file_main(ctx_webui *webui);
+    mhdrslt webu_file_trace(ctx_webui *webui);
 
 #endif /* _INCLUDE_WEBU_FILE_HPP_ */
@@ -1119,6 +1119,23 @@ static void webu_html_script_cams_one_click(ctx_webui *webui)
 
 }
 
+/* Create the cams_stream_name javascript function */
+static void webu_html_script_cams_stream_name(ctx_webui *webui)
+{
+    /* Use the smallest scaled stream that still fills the preview */
+    webui->resp_page +=
+        "    function cams_stream_name(camid) {\n"
+        "      var cfg = pData['configuration']['cam'+camid];\n"
+        "      var disp_width = window.innerWidth * cfg.stream_preview_scale.value / 100;\n"
+        "      if ((cfg.width.value / cfg.stream_thumbnail_scale.value) >= disp_width) {\n"
+        "        return 'thumbnail';\n"
+        "      } else if ((cfg.width.value / 2) >= disp_width) {\n"
+        "        return 'substream';\n"
+        "      }\n"
+        "      return 'stream';\n"
+        "    }\n\n";
+}
+
 /* Create the cams_all_click javascript function */
 static void webu_html_script_cams_all_click(ctx_webui *webui)
 {
@@ -1140,7 +1157,7 @@ static void webu_html_script_cams_all_click(ctx_webui *webui)
         "        if (pData['configuration']['cam'+camid].stream_preview_method.value == 'static') {\n"
         "          html_preview += \"<a><img id='pic\" + indx + \"' src=\"\n"
         "          html_preview += pData['cameras'][indx]['url'];\n"
-        "          html_preview += \"static/stream/t\" + new Date().getTime();\n"
+        "          html_preview += \"static/\" + cams_stream_name(camid) + \"/t\" + new Date().getTime();\n"
         "          html_preview += \" onclick='cams_one_click(\" + indx + \")' \";\n"
         "          html_preview += \" border=0 width=\";\n"
         "          html_preview += pData['configuration']['cam'+camid].stream_preview_scale.value;\n"
@@ -1151,7 +1168,7 @@ static void webu_html_script_cams_all_click(ctx_webui *webui)
         "        } else { \n"
         "          html_preview += \"<a><img id='pic\" + indx + \"' src=\"\n"
         "          html_preview += pData['cameras'][indx]['url'];\n"
-        "          html_preview += \"mjpg/stream\" ;\n"
+        "          html_preview += \"mjpg/\" + cams_stream_name(camid);\n"
         "          html_preview += \" onclick='cams_one_click(\" + indx + \")' \";\n"
         "          html_preview += \" border=0 width=\";\n"
         "          html_preview += pData['configuration']['cam'+camid].stream_preview_scale.value;\n"
@@ -1336,7 +1353,7 @@ static void webu_html_script_cams_all_fnc(ctx_webui *webui)
         "          if (pData['configuration']['cam'+camid].stream_preview_method.value == 'static') {\n"
         "            for (indx = 0; indx <= 3; indx++) {\n"
         "               if ((pic_url[indx] == '') && (camindx <= camcnt)) {\n"
-        "                 pic_url[indx] = pData['cameras'][camindx]['url'] + \"static/stream/t\" + new Date().getTime();\n"
+        "                 pic_url[indx] = pData['cameras'][camindx]['url'] + \"static/\" + cams_stream_name(camid) + \"/t\" + new Date().getTime();\n"
         "                 img[indx].onload = cams_img_onload(camindx, indx);\n"
         "                 img[indx].src = pic_url[indx];\n"
         "                 camindx++;\n"
@@ -1436,6 +1453,7 @@ static void webu_html_script(ctx_webui *webui)
 
     webu_html_script_cams_reset(webui);
 
+    webu_html_script_cams_stream_name(webui);
     webu_html_script_cams_all_click(webui);
     webu_html_script_cams_one_click(webui);
     webu_html_script_cams_scan_click(webui);
@@ -24,6 +24,7 @@
 #include "webu.hpp"
 #include "webu_json.hpp"
 #include "dbse.hpp"
+#include "pic_writer.hpp"
 
 static void webu_json_config_item(ctx_webui *webui, ctx_config *conf, int indx_parm)
 {
@@ -167,7 +168,8 @@ static void webu_json_config_cam_parms(ctx_webui *webui)
     for (indx_cam=0; indx_cam<webui->motapp->cam_cnt; indx_cam++) {
         webui->resp_page += ",\"cam" +
             std::to_string(webui->motapp->cam_list[indx_cam]->device_id) + "\": ";
-        webu_json_config_parms(webui, webui->motapp->cam_list[indx_cam]->conf);
+        webu_json_config_parms(webui
+            , conf_snapshot_latest(webui->motapp->cam_list[indx_cam]));
     }
     webui->resp_page += "}";
 
@@ -249,13 +251,96 @@ void webu_json_config(ctx_webui *webui)
 
 }
 
+/* Integer value of a parameter of the url or the default */
+static int webu_json_movies_arg(ctx_webui *webui, const char *arg_nm, int dflt)
+{
+    const char *arg_val;
+
+    arg_val = MHD_lookup_connection_value(webui->connection
+        , MHD_GET_ARGUMENT_KIND, arg_nm);
+    if ((arg_val == NULL) || (strlen(arg_val) == 0)) {
+        return dflt;
+    }
+    return atoi(arg_val);
+}
+
+/* First movie of the list on or after the date (list is ordered by date and time) */
+static int webu_json_movies_first(ctx_dbse_movies *movies, int movie_dtl)
+{
+    int indx_lo, indx_hi, indx_mid;
+
+    indx_lo = 0;
+    indx_hi = movies->movie_cnt;
+    while (indx_lo < indx_hi) {
+        indx_mid = indx_lo + (indx_hi - indx_lo) / 2;
+        if (movies->movie_list[indx_mid].movie_dtl < movie_dtl) {
+            indx_lo = indx_mid + 1;
+        } else {
+            indx_hi = indx_mid;
+        }
+    }
+    return indx_lo;
+}
+
+static void webu_json_movies_item(ctx_webui *webui, ctx_dbse_rec &db, int indx)
+{
+    char fmt[PATH_MAX];
+
+    if ((db.movie_sz/1000) < 1000) {
+        snprintf(fmt,PATH_MAX,"%'.1fKB"
+            ,((double)db.movie_sz/1000));
+    } else if ((db.movie_sz/1000000) < 1000) {
+        snprintf(fmt,PATH_MAX,"%'.1fMB"
+            ,((double)db.movie_sz/1000000));
+    } else {
+        snprintf(fmt,PATH_MAX,"%'.1fGB"
+            ,((double)db.movie_sz/1000000000));
+    }
+    webui->resp_page += "\""+ std::to_string(indx) + "\":";
+
+    webui->resp_page += "{\"name\": \"";
+    webui->resp_page += std::string(db.movie_nm) + "\"";
+
+    webui->resp_page += ",\"size\": \"";
+    webui->resp_page += std::string(fmt) + "\"";
+
+    webui->resp_page += ",\"date\": \"";
+    webui->resp_page += std::to_string(db.movie_dtl) + "\"";
+
+    if (db.movie_tmc != NULL) {
+        webui->resp_page += ",\"time\": \"";
+        webui->resp_page += std::string(db.movie_tmc) + "\"";
+    }
+
+    webui->resp_page += ",\"diff_avg\": \"";
+    webui->resp_page += std::to_string(db.diff_avg) + "\"";
+
+    webui->resp_page += ",\"sdev_min\": \"";
+    webui->resp_page += std::to_string(db.sdev_min) + "\"";
+
+    webui->resp_page += ",\"sdev_max\": \"";
+    webui->resp_page += std::to_string(db.sdev_max) + "\"";
+
+    webui->resp_page += ",\"sdev_avg\": \"";
+    webui->resp_page += std::to_string(db.sdev_avg) + "\"";
+
+    webui->resp_page += "}";
+    webui->resp_page += ",";
+}
+
+/* List of movies of the camera.  The url parameters date_from and
+ * date_to (yyyymmdd) select a range of dates while offset and limit
+ * select a page of the movies in the range.
+*/
 static void webu_json_movies_list(ctx_webui *webui)
 {
     int indx_mov, indx_cam, indx;
-    int movie_cnt, indx_req;
-    std::string response;
-    char fmt[PATH_MAX];
-    ctx_dbse_rec db;
+    int indx_req, indx_st, indx_en;
+    int limit, offset, date_from, date_to;
+    ctx_dbse *dbse;
+    ctx_dbse_movies *movies;
+    std::map<int, ctx_dbse_movies>::iterator it;
+    struct stat statbuf;
     ctx_params *wact;
 
     /* Get the indx we want */
@@ -269,7 +354,7 @@ static void webu_json_movies_list(ctx_webui *webui)
     webui->resp_page += "{\"count\" : 1";
     webui->resp_page += ",\""+ std::to_string(indx_req) + "\":";
 
-    if (webui->cam == NULL) {
+    if ((webui->cam == NULL) || (webui->motapp->dbse == NULL)) {
         webui->resp_page += "{\"count\" : 0} ";
         webui->resp_page += "}";
         return;
@@ -290,57 +375,61 @@ static void webu_json_movies_list(ctx_webui *webui)
         }
     }
 
-    webui->motapp->dbse_movies_getlist(webui->cam->device_id);
+    limit = webu_json_movies_arg(webui, "limit", 0);
+    offset = webu_json_movies_arg(webui, "offset", 0);
+    date_from = webu_json_movies_arg(webui, "date_from", 0);
+    date_to = webu_json_movies_arg(webui, "date_to", 0);
+    if (offset < 0) {
+        offset = 0;
+    }
+
+    webui->motapp->dbse_movies_load(webui->cam->device_id);
 
-    movie_cnt = webui->motapp->dbse->movie_cnt;
+    dbse = webui->motapp->dbse;
     webui->resp_page += "{";
     indx = 0;
-    for (indx_mov=0; indx_mov < movie_cnt; indx_mov++) {
-        db = webui->motapp->dbse->movie_list[indx_mov];
-        if (db.found == true) {
-            if ((db.movie_sz/1000) < 1000) {
-                snprintf(fmt,PATH_MAX,"%'.1fKB"
-                    ,((double)db.movie_sz/1000));
-            } else if ((db.movie_sz/1000000) < 1000) {
-                snprintf(fmt,PATH_MAX,"%'.1fMB"
-                    ,((double)db.movie_sz/1000000));
-            } else {
-                snprintf(fmt,PATH_MAX,"%'.1fGB"
-                    ,((double)db.movie_sz/1000000000));
+    pthread_mutex_lock(&dbse->mutex_dbse);
+        it = dbse->movies.find(webui->cam->device_id);
+        if (it == dbse->movies.end()) {
+            movies = NULL;
+            indx_st = 0;
+            indx_en = 0;
+        } else {
+            movies = &it->second;
+            indx_st = 0;
+            indx_en = movies->movie_cnt;
+            if (date_from > 0) {
+                indx_st = webu_json_movies_first(movies, date_from);
             }
-            webui->resp_page += "\""+ std::to_string(indx) + "\":";
-
-            webui->resp_page += "{\"name\": \"";
-            webui->resp_page += std::string(db.movie_nm) + "\"";
-
-            webui->resp_page += ",\"size\": \"";
-            webui->resp_page += std::string(fmt) + "\"";
-
-            webui->resp_page += ",\"date\": \"";
-            webui->resp_page += std::to_string(db.movie_dtl) + "\"";
-
-            if (db.movie_tmc != NULL) {
-                webui->resp_page += ",\"time\": \"";
-                webui->resp_page += std::string(db.movie_tmc) + "\"";
+            if (date_to > 0) {
+                indx_en = webu_json_movies_first(movies, date_to + 1);
             }
-
-            webui->resp_page += ",\"diff_avg\": \"";
-            webui->resp_page += std::to_string(db.diff_avg) + "\"";
-
-            webui->resp_page += ",\"sdev_min\": \"";
-            webui->resp_page += std::to_string(db.sdev_min) + "\"";
-
-            webui->resp_page += ",\"sdev_max\": \"";
-            webui->resp_page += std::to_string(db.sdev_max) + "\"";
-
-            webui->resp_page += ",\"sdev_avg\": \"";
-            webui->resp_page += std::to_string(db.sdev_avg) + "\"";
-
-            webui->resp_page += "}";
-            webui->resp_page += ",";
-            indx++;
         }
-    }
+        if (indx_en < indx_st) {
+            indx_en = indx_st;
+        }
+        if (offset > (indx_en - indx_st)) {
+            offset = indx_en - indx_st;
+        }
+        webui->resp_page += "\"total\" : " + std::to_string(indx_en - indx_st) + ",";
+        webui->resp_page += "\"offset\" : " + std::to_string(offset) + ",";
+
+        /* Files removed since the list was loaded are skipped until
+         * the cleanup deletes their records.
+        */
+        indx_mov = indx_st + offset;
+        while ((indx_mov < indx_en) && ((limit <= 0) || (indx < limit))) {
+            if ((movies->movie_list[indx_mov].found == true) &&
+                (stat(movies->movie_list[indx_mov].full_nm, &statbuf) != 0)) {
+                movies->movie_list[indx_mov].found = false;
+            }
+            if (movies->movie_list[indx_mov].found == true) {
+                webu_json_movies_item(webui, movies->movie_list[indx_mov], indx);
+                indx++;
+            }
+            indx_mov++;
+        }
+    pthread_mutex_unlock(&dbse->mutex_dbse);
     webui->resp_page += "\"count\" : " + std::to_string(indx);
     webui->resp_page += "}";
     webui->resp_page += "}";
@@ -414,6 +503,50 @@ static void webu_json_status_vars(ctx_webui *webui, int indx_cam)
 
 }
 
+static void webu_json_status_picwrt(ctx_webui *webui)
+{
+    ctx_picwrt *picwrt = webui->motapp->picwrt;
+
+    webui->resp_page += ",\"picture_writer\" : ";
+    if (picwrt == NULL) {
+        webui->resp_page += "{\"threads\":0}";
+        return;
+    }
+
+    pthread_mutex_lock(&picwrt->mutex);
+        webui->resp_page += "{\"threads\":" + std::to_string(picwrt->thread_cnt);
+        webui->resp_page += ",\"queue_max\":" + std::to_string(picwrt->queue_max);
+        webui->resp_page += ",\"queue_depth\":" + std::to_string(picwrt->queue_depth);
+        webui->resp_page += ",\"queue_peak\":" + std::to_string(picwrt->queue_peak);
+        webui->resp_page += ",\"queue_full\":" + std::to_string(picwrt->stall_cnt);
+        webui->resp_page += ",\"written\":" + std::to_string(picwrt->write_cnt);
+        webui->resp_page += "}";
+    pthread_mutex_unlock(&picwrt->mutex);
+}
+
+static void webu_json_status_dbse(ctx_webui *webui)
+{
+    ctx_dbse *dbse = webui->motapp->dbse;
+
+    webui->resp_page += ",\"database\" : ";
+    if ((dbse == NULL) || (dbse->thread_running == false)) {
+        webui->resp_page += "{\"threads\":0}";
+        return;
+    }
+
+    pthread_mutex_lock(&dbse->mutex_queue);
+        webui->resp_page += "{\"threads\":1";
+        webui->resp_page += ",\"queue_max\":" + std::to_string(dbse->queue_max);
+        webui->resp_page += ",\"queue_depth\":" + std::to_string(dbse->queue.size());
+        webui->resp_page += ",\"queue_peak\":" + std::to_string(dbse->queue_peak);
+        webui->resp_page += ",\"dropped\":" + std::to_string(dbse->drop_cnt);
+        webui->resp_page += ",\"written\":" + std::to_string(dbse->write_cnt);
+        webui->resp_page += ",\"batches\":" + std::to_string(dbse->batch_cnt);
+        webui->resp_page += ",\"cleaned\":" + std::to_string(dbse->clean_cnt);
+        webui->resp_page += "}";
+    pthread_mutex_unlock(&dbse->mutex_queue);
+}
+
 void webu_json_status(ctx_webui *webui)
 {
     int indx_cam;
@@ -431,6 +564,9 @@ void webu_json_status(ctx_webui *webui)
         }
     webui->resp_page += "}";
 
+    webu_json_status_picwrt(webui);
+    webu_json_status_dbse(webui);
+
     webui->resp_page += "}";
 
 }
@@ -452,6 +452,7 @@ static void webu_post_config(ctx_webui *webui)
     int indx, indx2;
     std::string tmpname;
     ctx_params *wact;
+    ctx_config *conf_new;
 
     wact = webui->motapp->webcontrol_actions;
     for (indx = 0; indx < wact->params_count; indx++) {
@@ -465,6 +466,7 @@ static void webu_post_config(ctx_webui *webui)
         }
     }
 
+    conf_new = NULL;
     for (indx = 0; indx < webui->post_sz; indx++) {
         if (mystrne(webui->post_info[indx].key_nm, "command") &&
             mystrne(webui->post_info[indx].key_nm, "camid")) {
@@ -498,15 +500,24 @@ static void webu_post_config(ctx_webui *webui)
                     webui->motapp->conf->conf_edit_set(
                         config_parms[indx2].parm_name
                         , webui->post_info[indx].key_val);
-                } else {
-                    webui->motapp->cam_list[webui->threadnbr]->conf
-                        ->conf_edit_set(config_parms[indx2].parm_name
+                    webui->motapp->parms_changed = true;
+                } else if (webui->threadnbr != -1) {
+                    /* Edits go to a copy that the camera loop takes as a whole */
+                    if (conf_new == NULL) {
+                        conf_new = new ctx_config(*conf_snapshot_latest(
+                            webui->motapp->cam_list[webui->threadnbr]));
+                    }
+                    conf_new->conf_edit_set(config_parms[indx2].parm_name
                         , webui->post_info[indx].key_val);
                 }
             }
         }
     }
 
+    if (conf_new != NULL) {
+        conf_snapshot_publish(webui->motapp->cam_list[webui->threadnbr], conf_new);
+    }
+
 }
 
 /* Process the ptz action */
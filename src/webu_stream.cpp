@@ -26,6 +26,122 @@
 #include "webu_stream.hpp"
 #include "alg_sec.hpp"
 
+/* Room kept in front of each jpeg for the multipart header */
+#define WEBU_STREAM_HDRSZ   80
+
+/* Get the stream data for the type of connection */
+static ctx_stream_data *webu_stream_data(ctx_webui *webui)
+{
+    if (webui->cnct_type == WEBUI_CNCT_FULL) {
+        return &webui->cam->stream.norm;
+    } else if (webui->cnct_type == WEBUI_CNCT_SUB) {
+        return &webui->cam->stream.sub;
+    } else if (webui->cnct_type == WEBUI_CNCT_THUMB) {
+        return &webui->cam->stream.thumb;
+    } else if (webui->cnct_type == WEBUI_CNCT_MOTION) {
+        return &webui->cam->stream.motion;
+    } else if (webui->cnct_type == WEBUI_CNCT_SOURCE) {
+        return &webui->cam->stream.source;
+    } else if (webui->cnct_type == WEBUI_CNCT_SECONDARY) {
+        return &webui->cam->stream.secondary;
+    } else {
+        return NULL;
+    }
+}
+
+/* Release a reference to a frame.  The stream mutex must be locked */
+static void webu_stream_frame_release(ctx_stream_data *strm, ctx_stream_frame *frame)
+{
+    if (frame == NULL) {
+        return;
+    }
+
+    frame->refcnt--;
+    if (frame->refcnt > 0) {
+        return;
+    }
+
+    if ((strm != NULL) && (strm->spare == NULL)) {
+        strm->spare = frame;
+    } else {
+        myfree(&frame->data);
+        delete frame;
+    }
+}
+
+/* Get a frame to compress the next image into.  The stream mutex must be locked */
+static ctx_stream_frame *webu_stream_frame_get(ctx_stream_data *strm, int jpeg_alloc)
+{
+    ctx_stream_frame *frame;
+    int alloc_size;
+
+    alloc_size = WEBU_STREAM_HDRSZ + jpeg_alloc + 2;
+
+    frame = strm->spare;
+    strm->spare = NULL;
+    if ((frame != NULL) && (frame->alloc_size < alloc_size)) {
+        myfree(&frame->data);
+        delete frame;
+        frame = NULL;
+    }
+    if (frame == NULL) {
+        frame = new ctx_stream_frame;
+        frame->data = (unsigned char*)mymalloc(alloc_size);
+        frame->alloc_size = alloc_size;
+    }
+    frame->refcnt = 1;
+    frame->part_ofs = 0;
+    frame->part_size = 0;
+    frame->jpeg_size = 0;
+
+    return frame;
+}
+
+/* Add the multipart header around the jpeg and make it the latest frame of
+ * the stream.  A failed compression is released instead and false returned.
+ * The stream mutex must be locked
+ */
+static bool webu_stream_frame_put(ctx_stream_data *strm, ctx_stream_frame *frame, long jpeg_size)
+{
+    char resp_head[WEBU_STREAM_HDRSZ];
+    int  header_len;
+
+    if (jpeg_size <= 0) {
+        webu_stream_frame_release(strm, frame);
+        return false;
+    }
+
+    header_len = snprintf(resp_head, WEBU_STREAM_HDRSZ
+        ,"--BoundaryString\r\n"
+        "Content-type: image/jpeg\r\n"
+        "Content-Length: %9ld\r\n\r\n"
+        ,jpeg_size);
+    frame->part_ofs = WEBU_STREAM_HDRSZ - header_len;
+    memcpy(frame->data + frame->part_ofs, resp_head, header_len);
+    /* Copy in the terminator after the jpg data at the end*/
+    memcpy(frame->data + WEBU_STREAM_HDRSZ + jpeg_size, "\r\n", 2);
+    frame->part_size = header_len + (int)jpeg_size + 2;
+    frame->jpeg_size = jpeg_size;
+
+    webu_stream_frame_release(strm, strm->frame);
+    strm->frame = frame;
+    strm->seq++;
+
+    return true;
+}
+
+/* Release the frames of a stream for shutdown */
+static void webu_stream_frame_free(ctx_stream_data *strm)
+{
+    webu_stream_frame_release(NULL, strm->frame);
+    strm->frame = NULL;
+    if (strm->spare != NULL) {
+        myfree(&strm->spare->data);
+        delete strm->spare;
+        strm->spare = NULL;
+    }
+}
+
 
 /* Allocate buffers if needed */
 static void webu_stream_mjpeg_checkbuffers(ctx_webui *webui)
@@ -77,46 +193,117 @@ static void webu_stream_mjpeg_delay(ctx_webui *webui)
             SLEEP(1,0);
         }
     }
-    clock_gettime(CLOCK_MONOTONIC, &webui->time_last);
 
 }
 
-static void webu_stream_mjpeg_getimg(ctx_webui *webui)
+/* Wait for the camera to publish a frame that has not been sent to the client */
+static void webu_stream_mjpeg_waitframe(ctx_webui *webui)
 {
-    long jpeg_size;
-    char resp_head[80];
-    int  header_len;
     ctx_stream_data *local_stream;
+    struct timespec ts;
+    int retcd;
 
-    if ((webui->motapp->webcontrol_finish) ||
-        (webui->cam->finish_dev)) {
-        webui->resp_used = 0;
+    local_stream = webu_stream_data(webui);
+    if (local_stream == NULL) {
         return;
     }
 
-    memset(webui->resp_image, '\0', webui->resp_size);
+    /* Wake at least once a second to notice a shutdown */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec++;
 
-    /* Assign to a local pointer the stream we want */
-    if (webui->cnct_type == WEBUI_CNCT_FULL) {
-        local_stream = &webui->cam->stream.norm;
+    retcd = 0;
+    pthread_mutex_lock(&webui->cam->stream.mutex);
+        webui->cam->stream.wait_cnt++;
+        while ((local_stream->seq == webui->stream_seq) && (retcd == 0) &&
+            (webui->cam->stream.closing == false) &&
+            (webui->motapp->webcontrol_finish == false) &&
+            (webui->cam->finish_dev == false)) {
+            retcd = pthread_cond_timedwait(&webui->cam->stream.cond_frame
+                , &webui->cam->stream.mutex, &ts);
+        }
+        webui->cam->stream.wait_cnt--;
+    pthread_mutex_unlock(&webui->cam->stream.mutex);
+}
 
-    } else if (webui->cnct_type == WEBUI_CNCT_SUB) {
-        local_stream = &webui->cam->stream.sub;
+/* Whether a frame has been published that the client has not been sent */
+static bool webu_stream_mjpeg_newframe(ctx_webui *webui)
+{
+    ctx_stream_data *local_stream;
 
-    } else if (webui->cnct_type == WEBUI_CNCT_MOTION) {
-        local_stream = &webui->cam->stream.motion;
+    local_stream = webu_stream_data(webui);
+    if (local_stream == NULL) {
+        return true;
+    }
 
-    } else if (webui->cnct_type == WEBUI_CNCT_SOURCE) {
-        local_stream = &webui->cam->stream.source;
+    return (local_stream->seq != webui->stream_seq);
+}
 
-    } else if (webui->cnct_type == WEBUI_CNCT_SECONDARY) {
-        local_stream = &webui->cam->stream.secondary;
+/* Nanoseconds until the next image of the stream is due */
+static long webu_stream_mjpeg_remaining(ctx_webui *webui)
+{
+    struct timespec time_curr;
+    long   stream_delay;
 
-    } else {
+    if (webui->stream_fps < 1) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &time_curr);
+    if ((time_curr.tv_sec - webui->time_last.tv_sec) > 1) {
+        return 0;
+    }
+    stream_delay = ((time_curr.tv_nsec - webui->time_last.tv_nsec)) +
+        ((time_curr.tv_sec - webui->time_last.tv_sec)*1000000000);
+
+    return (1000000000 / webui->stream_fps) - stream_delay;
+}
+
+/* Suspend the connection until the wake thread resumes it once the wait
+ * has passed and a new frame has been published
+ */
+static ssize_t webu_stream_mjpeg_wait(ctx_webui *webui, long wait_ns)
+{
+    if (wait_ns < 0) {
+        wait_ns = 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &webui->time_wake);
+    webui->time_wake.tv_nsec += wait_ns;
+    while (webui->time_wake.tv_nsec >= 1000000000L) {
+        webui->time_wake.tv_sec++;
+        webui->time_wake.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&webui->motapp->webcontrol_mutex);
+        if (webui->motapp->webcontrol_finish) {
+            pthread_mutex_unlock(&webui->motapp->webcontrol_mutex);
+            return -1;
+        }
+        MHD_suspend_connection(webui->connection);
+        webui->motapp->webcontrol_waiting.push_back(webui);
+    pthread_mutex_unlock(&webui->motapp->webcontrol_mutex);
+
+    return 0;
+}
+
+/* Take a reference to the latest frame of the stream */
+static void webu_stream_mjpeg_getimg(ctx_webui *webui)
+{
+    ctx_stream_data *local_stream;
+    ctx_stream_frame *frame_prev;
+
+    if ((webui->motapp->webcontrol_finish) ||
+        (webui->cam->finish_dev)) {
+        return;
+    }
+
+    /* Assign to a local pointer the stream we want */
+    local_stream = webu_stream_data(webui);
+    if (local_stream == NULL) {
         return;
     }
 
-    /* Copy jpg from the motion loop thread */
+    /* The frame is shared with the other clients rather than copied */
     pthread_mutex_lock(&webui->cam->stream.mutex);
         if ((!webui->cam->detecting_motion) &&
             (webui->motapp->cam_list[webui->threadnbr]->conf->stream_motion)) {
@@ -124,24 +311,14 @@ static void webu_stream_mjpeg_getimg(ctx_webui *webui)
         } else {
             webui->stream_fps = webui->motapp->cam_list[webui->threadnbr]->conf->stream_maxrate;
         }
-        if (local_stream->jpeg_data == NULL) {
-            pthread_mutex_unlock(&webui->cam->stream.mutex);
-            return;
+        frame_prev = webui->stream_frame;
+        webui->stream_frame = local_stream->frame;
+        webui->stream_seq = local_stream->seq;
+        if (webui->stream_frame != NULL) {
+            webui->stream_frame->refcnt++;
+            local_stream->consumed = true;
         }
-        jpeg_size = local_stream->jpeg_size;
-        header_len = snprintf(resp_head, 80
-            ,"--BoundaryString\r\n"
-            "Content-type: image/jpeg\r\n"
-            "Content-Length: %9ld\r\n\r\n"
-            ,jpeg_size);
-        memcpy(webui->resp_image, resp_head, header_len);
-        memcpy(webui->resp_image + header_len
-            ,local_stream->jpeg_data
-            ,jpeg_size);
-        /* Copy in the terminator after the jpg data at the end*/
-        memcpy(webui->resp_image + header_len + jpeg_size,"\r\n",2);
-        webui->resp_used = header_len + jpeg_size + 2;
-        local_stream->consumed = true;
+        webu_stream_frame_release(local_stream, frame_prev);
     pthread_mutex_unlock(&webui->cam->stream.mutex);
 
 }
@@ -157,7 +334,9 @@ static ssize_t webu_stream_mjpeg_response (void *cls, uint64_t pos, char *buf, s
      * to send based upon the stream position
      */
     ctx_webui *webui =(ctx_webui *)cls;
+    ctx_stream_frame *frame;
     size_t sent_bytes;
+    long wait_ns;
 
     (void)pos;  /*Remove compiler warning */
 
@@ -166,30 +345,42 @@ static ssize_t webu_stream_mjpeg_response (void *cls, uint64_t pos, char *buf, s
         return -1;
     }
 
-    if ((webui->stream_pos == 0) || (webui->resp_used == 0)) {
-
-        webu_stream_mjpeg_delay(webui);
+    if (webui->stream_pos == 0) {
 
-        webui->stream_pos = 0;
-        webui->resp_used = 0;
+        /* Respect the rate of the client then wait for a new frame */
+        if (webui->motapp->webcontrol_pool) {
+            wait_ns = webu_stream_mjpeg_remaining(webui);
+            if ((wait_ns > 0) || (webu_stream_mjpeg_newframe(webui) == false)) {
+                return webu_stream_mjpeg_wait(webui, wait_ns);
+            }
+        } else {
+            webu_stream_mjpeg_delay(webui);
+            webu_stream_mjpeg_waitframe(webui);
+        }
 
         webu_stream_mjpeg_getimg(webui);
 
-        if (webui->resp_used == 0) {
+        if (webui->stream_frame == NULL) {
+            if (webui->motapp->webcontrol_pool) {
+                return webu_stream_mjpeg_wait(webui, 0);
+            }
             return 0;
         }
+
+        clock_gettime(CLOCK_MONOTONIC, &webui->time_last);
     }
 
-    if ((webui->resp_used - webui->stream_pos) > max) {
+    frame = webui->stream_frame;
+    if ((frame->part_size - webui->stream_pos) > max) {
         sent_bytes = max;
     } else {
-        sent_bytes = webui->resp_used - webui->stream_pos;
+        sent_bytes = frame->part_size - webui->stream_pos;
     }
 
-    memcpy(buf, webui->resp_image + webui->stream_pos, sent_bytes);
+    memcpy(buf, frame->data + frame->part_ofs + webui->stream_pos, sent_bytes);
 
     webui->stream_pos = webui->stream_pos + sent_bytes;
-    if (webui->stream_pos >= webui->resp_used) {
+    if (webui->stream_pos >= (uint64_t)frame->part_size) {
         webui->stream_pos = 0;
     }
 
@@ -202,39 +393,27 @@ static void webu_stream_static_getimg(ctx_webui *webui)
 {
 
     ctx_stream_data *local_stream;
+    ctx_stream_frame *frame;
 
     webui->resp_used = 0;
     memset(webui->resp_image, '\0', webui->resp_size);
 
     /* Assign to a local pointer the stream we want */
-    if (webui->cnct_type == WEBUI_CNCT_FULL) {
-        local_stream = &webui->cam->stream.norm;
-
-    } else if (webui->cnct_type == WEBUI_CNCT_SUB) {
-        local_stream = &webui->cam->stream.sub;
-
-    } else if (webui->cnct_type == WEBUI_CNCT_MOTION) {
-        local_stream = &webui->cam->stream.motion;
-
-    } else if (webui->cnct_type == WEBUI_CNCT_SOURCE) {
-        local_stream = &webui->cam->stream.source;
-
-    } else if (webui->cnct_type == WEBUI_CNCT_SECONDARY) {
-        local_stream = &webui->cam->stream.secondary;
-
-    } else {
+    local_stream = webu_stream_data(webui);
+    if (local_stream == NULL) {
         return;
     }
 
     pthread_mutex_lock(&webui->cam->stream.mutex);
-        if (local_stream->jpeg_data == NULL) {
+        frame = local_stream->frame;
+        if (frame == NULL) {
             pthread_mutex_unlock(&webui->cam->stream.mutex);
             return;
         }
         memcpy(webui->resp_image
-            ,local_stream->jpeg_data
-            ,local_stream->jpeg_size);
-        webui->resp_used =local_stream->jpeg_size;
+            ,frame->data + WEBU_STREAM_HDRSZ
+            ,frame->jpeg_size);
+        webui->resp_used =frame->jpeg_size;
         local_stream->consumed = true;
     pthread_mutex_unlock(&webui->cam->stream.mutex);
 
@@ -280,6 +459,12 @@ static void webu_stream_cnct_count(ctx_webui *webui)
             cnct_count = webui->cam->stream.sub.cnct_count;
         pthread_mutex_unlock(&webui->cam->stream.mutex);
 
+    } else if (webui->cnct_type == WEBUI_CNCT_THUMB) {
+        pthread_mutex_lock(&webui->cam->stream.mutex);
+            webui->cam->stream.thumb.cnct_count++;
+            cnct_count = webui->cam->stream.thumb.cnct_count;
+        pthread_mutex_unlock(&webui->cam->stream.mutex);
+
     } else if (webui->cnct_type == WEBUI_CNCT_MOTION) {
         pthread_mutex_lock(&webui->cam->stream.mutex);
             webui->cam->stream.motion.cnct_count++;
@@ -306,9 +491,10 @@ static void webu_stream_cnct_count(ctx_webui *webui)
         pthread_mutex_unlock(&webui->cam->stream.mutex);
     }
 
-    if (cnct_count == 1) {
+    if ((cnct_count == 1) && (webui->uri_cmd1 == "static")) {
         /* This is the first connection so we need to wait half a sec
-         * so that the motion loop on the other thread can update image
+         * so that the motion loop on the other thread can update image.
+         * A stream instead waits until the first frame is published.
          */
         SLEEP(0,500000000L);
     }
@@ -324,6 +510,9 @@ static void webu_stream_type(ctx_webui *webui)
     } else if (webui->uri_cmd2 == "substream") {
         webui->cnct_type = WEBUI_CNCT_SUB;
 
+    } else if (webui->uri_cmd2 == "thumbnail") {
+        webui->cnct_type = WEBUI_CNCT_THUMB;
+
     } else if (webui->uri_cmd2 == "motion") {
         webui->cnct_type = WEBUI_CNCT_MOTION;
 
@@ -359,9 +548,9 @@ static mhdrslt webu_stream_mjpeg(ctx_webui *webui)
 
     webu_stream_cnct_count(webui);
 
-    webu_stream_mjpeg_checkbuffers(webui);
-
-    clock_gettime(CLOCK_MONOTONIC, &webui->time_last);
+    /* Send the first frame as soon as it is published */
+    webui->time_last.tv_sec = 0;
+    webui->time_last.tv_nsec = 0;
 
     response = MHD_create_response_from_callback (MHD_SIZE_UNKNOWN, 1024
         ,&webu_stream_mjpeg_response, webui, NULL);
@@ -462,39 +651,171 @@ mhdrslt webu_stream_main(ctx_webui *webui)
     return retcd;
 }
 
+/* Release the frame held by a closing connection */
+void webu_stream_frame_drop(ctx_webui *webui)
+{
+    ctx_stream_data *local_stream;
+
+    if (webui->stream_frame == NULL) {
+        return;
+    }
+
+    local_stream = webu_stream_data(webui);
+    pthread_mutex_lock(&webui->cam->stream.mutex);
+        webu_stream_frame_release(local_stream, webui->stream_frame);
+    pthread_mutex_unlock(&webui->cam->stream.mutex);
+    webui->stream_frame = NULL;
+}
+
+/* Resume the suspended stream connections when their next image is due */
+static void *webu_stream_wake_handler(void *arg)
+{
+    ctx_motapp *motapp = (ctx_motapp *)arg;
+    std::list<ctx_webui *>::iterator it;
+    struct timespec time_curr, ts;
+    long wait_ns, wake_ns;
+    bool finished;
+
+    mythreadname_set("ws", 0, NULL);
+
+    finished = false;
+    pthread_mutex_lock(&motapp->webcontrol_mutex);
+    while (finished == false) {
+        clock_gettime(CLOCK_MONOTONIC, &time_curr);
+        wait_ns = 100000000L;
+        it = motapp->webcontrol_waiting.begin();
+        while (it != motapp->webcontrol_waiting.end()) {
+            wake_ns = ((*it)->time_wake.tv_sec - time_curr.tv_sec) * 1000000000L +
+                ((*it)->time_wake.tv_nsec - time_curr.tv_nsec);
+            if ((motapp->webcontrol_finish) || ((*it)->cam->finish_dev) ||
+                ((wake_ns <= 0) && webu_stream_mjpeg_newframe(*it))) {
+                MHD_resume_connection((*it)->connection);
+                it = motapp->webcontrol_waiting.erase(it);
+            } else {
+                if ((wake_ns > 0) && (wake_ns < wait_ns)) {
+                    wait_ns = wake_ns;
+                }
+                it++;
+            }
+        }
+        finished = motapp->webcontrol_finish;
+
+        /* Sleep until the next client is due or a camera publishes a frame */
+        if (finished == false) {
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += wait_ns;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&motapp->webcontrol_cond, &motapp->webcontrol_mutex, &ts);
+        }
+    }
+    pthread_mutex_unlock(&motapp->webcontrol_mutex);
+
+    motapp->webcontrol_wake_running = false;
+
+    pthread_exit(NULL);
+}
+
+/* Start the thread that resumes the suspended stream connections */
+void webu_stream_wake_start(ctx_motapp *motapp)
+{
+    pthread_attr_t thread_attr;
+    pthread_t thread_id;
+    int retcd;
+
+    motapp->webcontrol_waiting.clear();
+    motapp->webcontrol_wake_running = true;
+
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    retcd = pthread_create(&thread_id, &thread_attr, &webu_stream_wake_handler, motapp);
+    pthread_attr_destroy(&thread_attr);
+    if (retcd != 0) {
+        MOTPLS_LOG(ERR, TYPE_STREAM, SHOW_ERRNO
+            ,_("Error starting stream wake thread"));
+        motapp->webcontrol_wake_running = false;
+    }
+}
+
+/* Resume all the connections and stop the wake thread.  webcontrol_finish must be set */
+void webu_stream_wake_stop(ctx_motapp *motapp)
+{
+    int waitcnt;
+
+    pthread_mutex_lock(&motapp->webcontrol_mutex);
+        pthread_cond_signal(&motapp->webcontrol_cond);
+    pthread_mutex_unlock(&motapp->webcontrol_mutex);
+
+    waitcnt = 0;
+    while ((motapp->webcontrol_wake_running) && (waitcnt < 1000)) {
+        SLEEP(0,1000000)
+        waitcnt++;
+    }
+    if (waitcnt == 1000) {
+        MOTPLS_LOG(ERR, TYPE_STREAM, NO_ERRNO
+            ,_("Graceful shutdown of stream wake thread failed"));
+    }
+}
+
+/* Forget a connection that is closing */
+void webu_stream_waiting_remove(ctx_webui *webui)
+{
+    pthread_mutex_lock(&webui->motapp->webcontrol_mutex);
+        webui->motapp->webcontrol_waiting.remove(webui);
+    pthread_mutex_unlock(&webui->motapp->webcontrol_mutex);
+}
+
 /* Initial the stream context items for the camera */
 void webu_stream_init(ctx_dev *cam)
 {
     /* NOTE:  This runs on the motion_loop thread. */
 
-    pthread_mutex_init(&cam->stream.mutex, NULL);
-
-    cam->imgs.image_substream = NULL;
+    /* A prior shutdown that timed out left them in use */
+    if (cam->stream.sync_init == false) {
+        pthread_mutex_init(&cam->stream.mutex, NULL);
+        pthread_cond_init(&cam->stream.cond_frame, NULL);
+        cam->stream.sync_init = true;
+    }
+    cam->stream.closing = false;
+    cam->stream.wait_cnt = 0;
 
-    cam->stream.norm.jpeg_size = 0;
-    cam->stream.norm.jpeg_data = NULL;
+    cam->stream.norm.frame = NULL;
+    cam->stream.norm.spare = NULL;
+    cam->stream.norm.seq = 0;
     cam->stream.norm.cnct_count = 0;
     cam->stream.norm.consumed = true;
 
-    cam->stream.sub.jpeg_size = 0;
-    cam->stream.sub.jpeg_data = NULL;
+    cam->stream.sub.frame = NULL;
+    cam->stream.sub.spare = NULL;
+    cam->stream.sub.seq = 0;
     cam->stream.sub.cnct_count = 0;
     cam->stream.sub.consumed = true;
 
-    cam->stream.motion.jpeg_size = 0;
-    cam->stream.motion.jpeg_data = NULL;
+    cam->stream.thumb.frame = NULL;
+    cam->stream.thumb.spare = NULL;
+    cam->stream.thumb.seq = 0;
+    cam->stream.thumb.cnct_count = 0;
+    cam->stream.thumb.consumed = true;
+
+    cam->stream.motion.frame = NULL;
+    cam->stream.motion.spare = NULL;
+    cam->stream.motion.seq = 0;
     cam->stream.motion.cnct_count = 0;
     cam->stream.motion.consumed = true;
 
-    cam->stream.source.jpeg_size = 0;
-    cam->stream.source.jpeg_data = NULL;
+    cam->stream.source.frame = NULL;
+    cam->stream.source.spare = NULL;
+    cam->stream.source.seq = 0;
     cam->stream.source.cnct_count = 0;
     cam->stream.source.consumed = true;
 
-    cam->stream.secondary.jpeg_size = 0;
-    cam->stream.secondary.jpeg_data = NULL;
+    cam->stream.secondary.frame = NULL;
+    cam->stream.secondary.spare = NULL;
+    cam->stream.secondary.seq = 0;
     cam->stream.secondary.cnct_count = 0;
-    cam->stream.source.consumed = true;
+    cam->stream.secondary.consumed = true;
 
 }
 
@@ -503,33 +824,107 @@ void webu_stream_deinit(ctx_dev *cam)
 {
     /* NOTE:  This runs on the motion_loop thread. */
 
+    int waitcnt, wait_cnt;
+
+    /* Wake the clients waiting for a frame and let them leave the wait */
+    pthread_mutex_lock(&cam->stream.mutex);
+        cam->stream.closing = true;
+        pthread_cond_broadcast(&cam->stream.cond_frame);
+    pthread_mutex_unlock(&cam->stream.mutex);
+
+    waitcnt = 0;
+    while (waitcnt < 2000) {
+        pthread_mutex_lock(&cam->stream.mutex);
+            wait_cnt = cam->stream.wait_cnt;
+        pthread_mutex_unlock(&cam->stream.mutex);
+        if (wait_cnt == 0) {
+            break;
+        }
+        SLEEP(0,1000000)
+        waitcnt++;
+    }
+
+    if (waitcnt == 2000) {
+        /* A client still references the mutex and the frames */
+        MOTPLS_LOG(ERR, TYPE_STREAM, NO_ERRNO
+            ,_("Graceful shutdown of stream clients failed"));
+        return;
+    }
+
     pthread_mutex_destroy(&cam->stream.mutex);
+    pthread_cond_destroy(&cam->stream.cond_frame);
+    cam->stream.sync_init = false;
 
-    myfree(&cam->imgs.image_substream);
-    myfree(&cam->stream.norm.jpeg_data);
-    myfree(&cam->stream.sub.jpeg_data);
-    myfree(&cam->stream.motion.jpeg_data);
-    myfree(&cam->stream.source.jpeg_data);
-    myfree(&cam->stream.secondary.jpeg_data);
+    webu_stream_frame_free(&cam->stream.norm);
+    webu_stream_frame_free(&cam->stream.sub);
+    webu_stream_frame_free(&cam->stream.thumb);
+    webu_stream_frame_free(&cam->stream.motion);
+    webu_stream_frame_free(&cam->stream.source);
+    webu_stream_frame_free(&cam->stream.secondary);
 
 }
 
+/* Take a frame to compress into when the stream wants a new image.
+ * The frame is held only by the motion loop until it is published so
+ * the compression is done without the stream mutex.
+ */
+static ctx_stream_frame *webu_stream_getimg_start(ctx_dev *cam, ctx_stream_data *strm)
+{
+    ctx_stream_frame *frame;
+
+    frame = NULL;
+    pthread_mutex_lock(&cam->stream.mutex);
+        if ((strm->cnct_count > 0) && strm->consumed) {
+            frame = webu_stream_frame_get(strm, cam->imgs.size_norm);
+        }
+    pthread_mutex_unlock(&cam->stream.mutex);
+
+    return frame;
+}
+
+/* Publish the compressed frame as the latest of the stream.  The stream
+ * keeps asking for images when nothing was published so it does not stall.
+ */
+static void webu_stream_getimg_finish(ctx_dev *cam, ctx_stream_data *strm
+    , ctx_stream_frame *frame, long jpeg_size)
+{
+    pthread_mutex_lock(&cam->stream.mutex);
+        if (webu_stream_frame_put(strm, frame, jpeg_size)) {
+            strm->consumed = false;
+        }
+    pthread_mutex_unlock(&cam->stream.mutex);
+}
+
+/* Compress an image for a stream */
+static void webu_stream_getimg_jpeg(ctx_dev *cam, ctx_stream_data *strm
+    , ctx_stream_frame *frame, unsigned char *image, int width, int height)
+{
+    long jpeg_size;
+
+    jpeg_size = pic_put_memory(cam
+        ,frame->data + WEBU_STREAM_HDRSZ
+        ,cam->imgs.size_norm
+        ,image
+        ,cam->conf->stream_quality
+        ,width
+        ,height);
+    webu_stream_getimg_finish(cam, strm, frame, jpeg_size);
+}
+
 /* Get a normal image from the motion loop and compress it*/
 static void webu_stream_getimg_norm(ctx_dev *cam, ctx_image_data *img_data)
 {
     /*This is on the motion_loop thread */
-    if (cam->stream.norm.jpeg_data == NULL) {
-        cam->stream.norm.jpeg_data =(unsigned char*)mymalloc(cam->imgs.size_norm);
+
+    ctx_stream_frame *frame;
+
+    if (img_data->image_norm == NULL) {
+        return;
     }
-    if (img_data->image_norm != NULL && cam->stream.norm.consumed) {
-        cam->stream.norm.jpeg_size = pic_put_memory(cam
-            ,cam->stream.norm.jpeg_data
-            ,cam->imgs.size_norm
-            ,img_data->image_norm
-            ,cam->conf->stream_quality
-            ,cam->imgs.width
-            ,cam->imgs.height);
-        cam->stream.norm.consumed = false;
+    frame = webu_stream_getimg_start(cam, &cam->stream.norm);
+    if (frame != NULL) {
+        webu_stream_getimg_jpeg(cam, &cam->stream.norm, frame
+            , img_data->image_norm, cam->imgs.width, cam->imgs.height);
     }
 
 }
@@ -539,42 +934,44 @@ static void webu_stream_getimg_sub(ctx_dev *cam, ctx_image_data *img_data)
 {
     /*This is on the motion_loop thread */
 
-    int subsize;
+    ctx_stream_frame *frame;
+    unsigned char *image;
+    int width, height;
 
-    if (cam->stream.sub.jpeg_data == NULL) {
-        cam->stream.sub.jpeg_data =(unsigned char*)mymalloc(cam->imgs.size_norm);
+    if (img_data->image_norm == NULL) {
+        return;
+    }
+    frame = webu_stream_getimg_start(cam, &cam->stream.sub);
+    if (frame != NULL) {
+        image = pic_scale_get(cam, img_data->image_norm, 1, &width, &height);
+        webu_stream_getimg_jpeg(cam, &cam->stream.sub, frame
+            , image, width, height);
     }
-    if (img_data->image_norm != NULL && cam->stream.sub.consumed) {
-        /* Resulting substream image must be multiple of 8 */
-        if (((cam->imgs.width  % 16) == 0)  &&
-            ((cam->imgs.height % 16) == 0)) {
 
-            subsize = ((cam->imgs.width / 2) * (cam->imgs.height / 2) * 3 / 2);
-            if (cam->imgs.image_substream == NULL) {
-                cam->imgs.image_substream =(unsigned char*)mymalloc(subsize);
-            }
-            pic_scale_img(cam->imgs.width
-                ,cam->imgs.height
-                ,img_data->image_norm
-                ,cam->imgs.image_substream);
-            cam->stream.sub.jpeg_size = pic_put_memory(cam
-                ,cam->stream.sub.jpeg_data
-                ,subsize
-                ,cam->imgs.image_substream
-                ,cam->conf->stream_quality
-                ,(cam->imgs.width / 2)
-                ,(cam->imgs.height / 2));
-        } else {
-            /* Substream was not multiple of 8 so send full image*/
-            cam->stream.sub.jpeg_size = pic_put_memory(cam
-                ,cam->stream.sub.jpeg_data
-                ,cam->imgs.size_norm
-                ,img_data->image_norm
-                ,cam->conf->stream_quality
-                ,cam->imgs.width
-                ,cam->imgs.height);
+}
+
+/* Get a thumbnail image from the motion loop and compress it*/
+static void webu_stream_getimg_thumb(ctx_dev *cam, ctx_image_data *img_data)
+{
+    /*This is on the motion_loop thread */
+
+    ctx_stream_frame *frame;
+    unsigned char *image;
+    int width, height, level;
+
+    if (img_data->image_norm == NULL) {
+        return;
+    }
+    frame = webu_stream_getimg_start(cam, &cam->stream.thumb);
+    if (frame != NULL) {
+        /* Convert the scale into the level of the scaled images */
+        level = 0;
+        while ((2 << level) <= cam->conf->stream_thumbnail_scale) {
+            level++;
         }
-        cam->stream.sub.consumed = false;
+        image = pic_scale_get(cam, img_data->image_norm, level, &width, &height);
+        webu_stream_getimg_jpeg(cam, &cam->stream.thumb, frame
+            , image, width, height);
     }
 
 }
@@ -584,18 +981,15 @@ static void webu_stream_getimg_motion(ctx_dev *cam)
 {
     /*This is on the motion_loop thread */
 
-    if (cam->stream.motion.jpeg_data == NULL) {
-        cam->stream.motion.jpeg_data =(unsigned char*)mymalloc(cam->imgs.size_norm);
+    ctx_stream_frame *frame;
+
+    if (cam->imgs.image_motion.image_norm == NULL) {
+        return;
     }
-    if (cam->imgs.image_motion.image_norm != NULL  && cam->stream.motion.consumed) {
-        cam->stream.motion.jpeg_size = pic_put_memory(cam
-            ,cam->stream.motion.jpeg_data
-            ,cam->imgs.size_norm
-            ,cam->imgs.image_motion.image_norm
-            ,cam->conf->stream_quality
-            ,cam->imgs.width
-            ,cam->imgs.height);
-        cam->stream.motion.consumed = false;
+    frame = webu_stream_getimg_start(cam, &cam->stream.motion);
+    if (frame != NULL) {
+        webu_stream_getimg_jpeg(cam, &cam->stream.motion, frame
+            , cam->imgs.image_motion.image_norm, cam->imgs.width, cam->imgs.height);
     }
 
 }
@@ -605,18 +999,15 @@ static void webu_stream_getimg_source(ctx_dev *cam)
 {
     /*This is on the motion_loop thread */
 
-    if (cam->stream.source.jpeg_data == NULL) {
-        cam->stream.source.jpeg_data =(unsigned char*)mymalloc(cam->imgs.size_norm);
+    ctx_stream_frame *frame;
+
+    if (cam->imgs.image_virgin == NULL) {
+        return;
     }
-    if (cam->imgs.image_virgin != NULL && cam->stream.source.consumed) {
-        cam->stream.source.jpeg_size = pic_put_memory(cam
-            ,cam->stream.source.jpeg_data
-            ,cam->imgs.size_norm
-            ,cam->imgs.image_virgin
-            ,cam->conf->stream_quality
-            ,cam->imgs.width
-            ,cam->imgs.height);
-        cam->stream.source.consumed = false;
+    frame = webu_stream_getimg_start(cam, &cam->stream.source);
+    if (frame != NULL) {
+        webu_stream_getimg_jpeg(cam, &cam->stream.source, frame
+            , cam->imgs.image_virgin, cam->imgs.width, cam->imgs.height);
     }
 
 }
@@ -626,31 +1017,100 @@ static void webu_stream_getimg_secondary(ctx_dev *cam)
 {
     /*This is on the motion_loop thread */
 
+    ctx_stream_frame *frame;
+    long jpeg_size;
+
     if (cam->imgs.size_secondary>0) {
+        pthread_mutex_lock(&cam->stream.mutex);
+            frame = webu_stream_frame_get(&cam->stream.secondary, cam->imgs.size_norm);
+        pthread_mutex_unlock(&cam->stream.mutex);
         pthread_mutex_lock(&cam->algsec->mutex);
-            if (cam->stream.secondary.jpeg_data == NULL) {
-                cam->stream.secondary.jpeg_data =(unsigned char*)mymalloc(cam->imgs.size_norm);
-            }
-            memcpy(cam->stream.secondary.jpeg_data,cam->imgs.image_secondary,cam->imgs.size_secondary);
-            cam->stream.secondary.jpeg_size = cam->imgs.size_secondary;
+            jpeg_size = cam->imgs.size_secondary;
+            memcpy(frame->data + WEBU_STREAM_HDRSZ,cam->imgs.image_secondary,jpeg_size);
         pthread_mutex_unlock(&cam->algsec->mutex);
+        pthread_mutex_lock(&cam->stream.mutex);
+            webu_stream_frame_put(&cam->stream.secondary, frame, jpeg_size);
+        pthread_mutex_unlock(&cam->stream.mutex);
     } else {
-        myfree(&cam->stream.secondary.jpeg_data);
+        pthread_mutex_lock(&cam->stream.mutex);
+            webu_stream_frame_release(&cam->stream.secondary, cam->stream.secondary.frame);
+            cam->stream.secondary.frame = NULL;
+        pthread_mutex_unlock(&cam->stream.mutex);
     }
 
 }
 
-/* Get image from the motion loop and compress it*/
+/* Indicate whether a stream will compress the image with these settings on this frame */
+bool webu_stream_wanted(ctx_dev *cam, unsigned char *image
+        , int width, int height, int quality, bool grey)
+{
+    bool wanted;
+
+    /*This is on the motion_loop thread */
+
+    if ((width != cam->imgs.width) || (height != cam->imgs.height) ||
+        (quality != cam->conf->stream_quality) ||
+        (grey != cam->conf->stream_grey)) {
+        return false;
+    }
+
+    wanted = false;
+    pthread_mutex_lock(&cam->stream.mutex);
+        if (image == cam->imgs.image_ring[cam->imgs.ring_in].image_norm) {
+            if ((cam->stream.norm.cnct_count > 0) && cam->stream.norm.consumed) {
+                wanted = true;
+            }
+            /* The scaled streams only use the full image when it is too small to scale */
+            if (cam->pic_scale.level_max == 0) {
+                if (((cam->stream.sub.cnct_count > 0) && cam->stream.sub.consumed) ||
+                    ((cam->stream.thumb.cnct_count > 0) && cam->stream.thumb.consumed)) {
+                    wanted = true;
+                }
+            }
+        } else if (image == cam->imgs.image_motion.image_norm) {
+            if ((cam->stream.motion.cnct_count > 0) && cam->stream.motion.consumed) {
+                wanted = true;
+            }
+        } else if (image == cam->imgs.image_virgin) {
+            if ((cam->stream.source.cnct_count > 0) && cam->stream.source.consumed) {
+                wanted = true;
+            }
+        }
+    pthread_mutex_unlock(&cam->stream.mutex);
+
+    return wanted;
+}
+
+/* Get image from the motion loop and compress it.  The stream mutex is
+ * only held to take and publish the frames, not during the compression.
+ */
 void webu_stream_getimg(ctx_dev *cam, ctx_image_data *img_data)
 {
+    bool secondary;
 
     /*This is on the motion_loop thread */
 
+    webu_stream_getimg_norm(cam, img_data);
+    webu_stream_getimg_sub(cam, img_data);
+    webu_stream_getimg_thumb(cam, img_data);
+    webu_stream_getimg_motion(cam);
+    webu_stream_getimg_source(cam);
+
     pthread_mutex_lock(&cam->stream.mutex);
-        if (cam->stream.norm.cnct_count > 0)        webu_stream_getimg_norm(cam, img_data);
-        if (cam->stream.sub.cnct_count > 0)         webu_stream_getimg_sub(cam, img_data);
-        if (cam->stream.motion.cnct_count > 0)      webu_stream_getimg_motion(cam);
-        if (cam->stream.source.cnct_count > 0)      webu_stream_getimg_source(cam);
-        if (cam->stream.secondary.cnct_count > 0)   webu_stream_getimg_secondary(cam);
+        secondary = (cam->stream.secondary.cnct_count > 0);
     pthread_mutex_unlock(&cam->stream.mutex);
+    if (secondary) {
+        webu_stream_getimg_secondary(cam);
+    }
+
+    pthread_mutex_lock(&cam->stream.mutex);
+        pthread_cond_broadcast(&cam->stream.cond_frame);
+    pthread_mutex_unlock(&cam->stream.mutex);
+
+    /* Let the pooled connections that wait for a frame be resumed */
+    if (cam->motapp->webcontrol_pool) {
+        pthread_mutex_lock(&cam->motapp->webcontrol_mutex);
+            pthread_cond_signal(&cam->motapp->webcontrol_cond);
+        pthread_mutex_unlock(&cam->motapp->webcontrol_mutex);
+    }
 }
@@ -23,7 +23,13 @@
     void webu_stream_init(ctx_dev *cam);
     void webu_stream_deinit(ctx_dev *cam);
     void webu_stream_getimg(ctx_dev *cam, ctx_image_data *img_data);
+    bool webu_stream_wanted(ctx_dev *cam, unsigned char *image
+        , int width, int height, int quality, bool grey);
 
     mhdrslt webu_stream_main(ctx_webui *webui);
+    void webu_stream_wake_start(ctx_motapp *motapp);
+    void webu_stream_wake_stop(ctx_motapp *motapp);
+    void webu_stream_waiting_remove(ctx_webui *webui);
+    void webu_stream_frame_drop(ctx_webui *webui);
 
 #endif /* _INCLUDE_WEBU_STREAM_HPP_ */